@@ -0,0 +1,109 @@
+#!/usr/bin/python3
+
+import argparse
+import json
+import struct as st
+import time
+
+from device import Device, max_payload
+
+default_targets = ["vout0", "iout0", "vout1", "iout1"]
+
+
+def percentiles(samples, ps=(50, 90, 99)):
+    ordered = sorted(samples)
+    result = {f"p{p}": ordered[min(len(ordered) - 1, len(ordered) * p // 100)] for p in ps}
+    result["max"] = ordered[-1]
+    return result
+
+
+def measure(name, iterations, xfer, payload_bytes):
+    """runs xfer iterations times, xfer returns the count of values it moved"""
+    latencies = []
+    values = 0
+    start = time.perf_counter()
+    for _ in range(iterations):
+        t0 = time.perf_counter()
+        values += xfer()
+        latencies.append((time.perf_counter() - t0) * 1e6)
+    elapsed = time.perf_counter() - start
+    return {
+        "op": name,
+        "iterations": iterations,
+        "latency_us": percentiles(latencies),
+        "ops_per_s": iterations / elapsed,
+        "values_per_s": values / elapsed,
+        "bytes_per_s": iterations * payload_bytes / elapsed,
+    }
+
+
+def run(dev, iterations, targets, set_target=None):
+    targets = [t for t in targets if t in dev.configs] or [next(iter(dev.configs))]
+    idxs = [dev.configs[t][0] for t in targets]
+    sizes = [dev.configs[t][1] for t in targets]
+    results = []
+
+    def single(req):
+        return lambda: (dev.cfg_xfer(req), 1)[1]
+
+    count_req = st.pack("B", 0)
+    results.append(measure("count", iterations, single(count_req), 2))
+
+    get_req = st.pack("=BH", 4, idxs[0])
+    results.append(measure("get", iterations, single(get_req), sizes[0]))
+
+    # as many copies of the targets as fit into one response
+    per_batch = max(1, (max_payload - 2) // max(1, sum(sizes))) * len(idxs)
+    batch = (idxs * per_batch)[:per_batch]
+    many_req = st.pack(f"=BHH{len(batch)}H", 8, 0, len(batch), *batch)
+    batch_bytes = sum(dev.configs[t][1] for t in (targets * per_batch)[:per_batch])
+
+    def get_many():
+        rx = dev.cfg_xfer(many_req)
+        return st.unpack_from("H", rx, 0)[0]
+    results.append(measure("get_many", iterations, get_many, batch_bytes))
+
+    schema_req = st.pack("=BH", 11, 0)
+    schema_chunk = len(dev.cfg_xfer(schema_req))
+    if schema_chunk:
+        results.append(measure("schema", iterations, single(schema_req), schema_chunk))
+
+    describe_req = st.pack("=BH", 10, 0)
+    describe_chunk = len(dev.cfg_xfer(describe_req))
+    results.append(measure("describe", iterations, single(describe_req), describe_chunk))
+
+    if set_target:
+        # writes back the current value, so the device ends up as it was
+        idx, size, _ = dev.configs[set_target]
+        set_req = st.pack("=BH", 5, idx) + dev.cfg_xfer(st.pack("=BH", 4, idx))
+        results.append(measure("set", iterations, single(set_req), size))
+
+    return results
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='measure latency and throughput of the config protocol')
+    parser.add_argument('--id_vendor', dest='id_vendor', type=int, default=0xffff, help='usb vendor id of the target device')
+    parser.add_argument('--id_product', dest='id_product', type=int, default=0x1234, help='usb product id of the target device')
+    parser.add_argument('--socket', type=str, default=None, help='run against the host simulator listening on this unix socket')
+    parser.add_argument('--iterations', type=int, default=1000, help='transfers per operation')
+    parser.add_argument('--targets', type=str, nargs='*', default=default_targets, help='the configs to read')
+    parser.add_argument('--set', dest='set_target', type=str, default=None, help='also measure writes by writing back the value of this config')
+    parser.add_argument('--out', type=str, default=None, help='store the results as json into this file instead of printing them')
+    args = parser.parse_args()
+
+    if args.socket:
+        dev = Device(socket_path=args.socket)
+    else:
+        dev = Device(idVendor=args.id_vendor, idProduct=args.id_product)
+
+    report = {
+        "transport": "socket" if args.socket else "usb",
+        "configs": len(dev.configs),
+        "results": run(dev, args.iterations, args.targets, args.set_target),
+    }
+    if args.out:
+        with open(args.out, "w") as f:
+            json.dump(report, f, indent=2)
+    else:
+        print(json.dumps(report, indent=2))
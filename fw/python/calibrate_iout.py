@@ -113,6 +113,8 @@ if __name__ == "__main__":
 
     if args.sample_file == None:
         dev.set_config(f"corr.iout{ch}", (0, 1))
+        dev.set_config(f"corr.iout{ch}.hi", (0, 0))
+        dev.set_config(f"corr.iout{ch}.pwl", (0,) + (0.,) * 16)
         xx, yy = gather_calib_data(dev, ch, args.start, args.stop, args.steps, args.oversample)
         np.savez(f"calib_samples_{ch}.npz", xx=xx, yy=yy)
     else:
@@ -0,0 +1,71 @@
+#!/usr/bin/python3
+
+import numpy as np
+import argparse
+import time
+
+from device import Device
+
+trigger_modes = ['manual', 'above', 'below', 'rising', 'falling', 'output_enable', 'output_disable']
+channel_names = ['u0', 'i0', 'u1', 'i1']
+states = ['idle', 'armed', 'triggered', 'done']
+
+
+def capture(dev, mode, channel, threshold, pre, timeout):
+    dev.set_config("capture.trigger", (trigger_modes.index(mode), channel, threshold))
+    dev.set_config("capture.pre", (pre,))
+    dev.set_config("capture.arm")
+    if mode == 'manual':
+        dev.set_config("capture.force")
+
+    start = time.time()
+    while True:
+        state, trigger_index, size = dev.get_config("capture.status")
+        if states[state] == 'done':
+            break
+        if time.time() - start > timeout:
+            raise TimeoutError(f"capture did not complete (state: {states[state]})")
+        time.sleep(.05)
+
+    timestamps = []
+    values = []
+    while len(timestamps) < size:
+        dev.set_config("capture.offset", (len(timestamps),))
+        chunk = dev.get_config("capture.data")
+        offset, count = chunk[0:2]
+        num_samples = (len(chunk) - 2) // 5
+        timestamps += chunk[2:2+count]
+        vals = chunk[2+num_samples:]
+        values += [vals[4*i:4*i+4] for i in range(count)]
+        if count == 0:
+            break
+
+    t = (np.array(timestamps, dtype=np.int64) - timestamps[trigger_index]) * 1e-6
+    return t, np.array(values)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='capture a triggered recording of the analog readings')
+    parser.add_argument('--id_vendor', dest='id_vendor', type=int, default=0xffff, help='usb vendor id of the target device')
+    parser.add_argument('--id_product', dest='id_product', type=int, default=0x1234, help='usb product id of the target device')
+    parser.add_argument('--mode', choices=trigger_modes, default='manual', help='the trigger condition')
+    parser.add_argument('--channel', type=int, default=0, help='the reading (0: u0, 1: i0, 2: u1, 3: i1) or output channel the trigger looks at')
+    parser.add_argument('--threshold', type=float, default=0., help='the trigger threshold')
+    parser.add_argument('--pre', type=int, default=128, help='how many samples to keep before the trigger')
+    parser.add_argument('--timeout', type=float, default=60., help='how long to wait for the trigger (in seconds)')
+    parser.add_argument('--out', type=str, default=None, help='store the capture into this .npz file instead of plotting it')
+
+    args = parser.parse_args()
+    dev = Device(idVendor=args.id_vendor, idProduct=args.id_product)
+
+    t, values = capture(dev, args.mode, args.channel, args.threshold, args.pre, args.timeout)
+
+    if args.out:
+        np.savez(args.out, t=t, values=values)
+    else:
+        import matplotlib.pyplot as plt
+        for i, name in enumerate(channel_names):
+            plt.plot(t, values[:, i], label=name)
+        plt.axvline(0, color='k', linestyle=':')
+        plt.legend()
+        plt.show()
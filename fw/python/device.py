@@ -4,12 +4,68 @@ import usb.core
 import usb.util
 import struct as st
 import collections
+import os
+import socket
 
 from contextlib import contextmanager
 
 
+max_payload = 512
+# the response size of a malformed request, the device dropped it along with the rest of the transfer
+rejected = 0xffff
+schema_cache_dir = os.path.join(os.path.expanduser("~"), ".cache", "psu_schema")
+
+
+def parse_config_records(rx, first_index=0):
+    """the (name, (index, size, format)) entries of the {u16 size, u8 len, name, u8 len, format} records in rx"""
+    entries = []
+    pos = 0
+    while pos < len(rx):
+        size, = st.unpack_from("H", rx, pos)
+        name = rx[pos + 3:pos + 3 + rx[pos + 2]].decode("utf-8")
+        pos += 3 + rx[pos + 2]
+        format = rx[pos + 1:pos + 1 + rx[pos]].decode("utf-8")
+        pos += 1 + rx[pos]
+        if size != st.calcsize(format):
+            print(f"warning: format ({format}) for {name} has size of {st.calcsize(format)} whereas the remote memory is of size {size}")
+        entries.append((name, (first_index + len(entries), size, format,)))
+    return entries
+
+
+class SocketTransport:
+    """the framing of the bulk endpoints over a stream socket, for the host build of the protocol engine"""
+
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+
+    def recv_exactly(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.sock.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError("the simulator closed the connection")
+            data += chunk
+        return data
+
+    def xfer(self, tx):
+        self.sock.sendall(tx)
+        l, = st.unpack("H", self.recv_exactly(2))
+        if l == rejected:
+            raise ValueError("the device rejected the request")
+        return self.recv_exactly(l)
+
+
 class Device:
-    def __init__(self, product_name=None, idVendor=None, idProduct=None):
+    def __init__(self, product_name=None, idVendor=None, idProduct=None, socket_path=None):
+        self.notify_in = None
+        self.notify_rx = b""
+        if socket_path:
+            self.dev = None
+            self.transport = SocketTransport(socket_path)
+            self.configs = self.fetch_configs()
+            return
+
         devs = usb.core.find(find_all=True)
         devs = [d for d in devs]
         if idVendor:
@@ -25,7 +81,10 @@ class Device:
         # self.dev.set_configuration()
         
         self.general_iface = self.interface("general interface")
-        self.cfg_out, self.cfg_in = self.general_iface.endpoints()
+        endpoints = self.general_iface.endpoints()
+        self.cfg_out, self.cfg_in = endpoints[:2]
+        self.notify_in = endpoints[2] if len(endpoints) > 2 else None
+        self.transport = None
         self.dev.set_interface_altsetting(self.general_iface, 0)
         self.configs = self.fetch_configs()
 
@@ -44,25 +103,55 @@ class Device:
             self.dev.set_interface_altsetting(iface, 0)
 
     def cfg_xfer(self, tx):
+        if self.transport:
+            return self.transport.xfer(tx)
         self.cfg_out.write(tx)
         i = self.cfg_in.read(256)
         l, = st.unpack_from("H", i, 0)
+        if l == rejected:
+            raise ValueError("the device rejected the request")
         rx = i[2:]
         while len(rx) < l:
             rx += self.cfg_in.read(256)
             
-        return rx
+        return bytes(rx)
+
+    def fetch_schema(self):
+        """the records of all configs from the schema blob, cached by its hash; None if the device can't serve it"""
+        header = st.Struct("=IHH")
+        try:
+            chunk = self.cfg_xfer(st.pack("=BH", 11, 0))
+        except ValueError:
+            return None
+        if len(chunk) < header.size:
+            return None
+        schema_hash, size, _ = header.unpack_from(chunk)
+        cache_file = os.path.join(schema_cache_dir, f"{schema_hash:08x}.bin")
+        if os.path.exists(cache_file):
+            with open(cache_file, "rb") as f:
+                records = f.read()
+            if len(records) == size:
+                return records
+        blob = chunk
+        while len(blob) < header.size + size:
+            blob += self.cfg_xfer(st.pack("=BH", 11, len(blob) // max_payload))
+        records = blob[header.size:header.size + size]
+        os.makedirs(schema_cache_dir, exist_ok=True)
+        with open(cache_file, "wb") as f:
+            f.write(records)
+        return records
 
     def fetch_configs(self):
+        records = self.fetch_schema()
+        if records is not None:
+            return collections.OrderedDict(parse_config_records(records))
         cfg = collections.OrderedDict()
         num_configs, = st.unpack("H", self.cfg_xfer(st.pack("B", 0)))
-        for i in range(num_configs):
-            size,  = st.unpack("H", self.cfg_xfer(st.pack("=BH", 1, i)))
-            name   = self.cfg_xfer(st.pack("=BH", 2, i)).tobytes().decode("utf-8")
-            format = self.cfg_xfer(st.pack("=BH", 3, i)).tobytes().decode("utf-8")
-            if size != st.calcsize(format):
-                print(f"warning: format ({format}) for {name} has size of {st.calcsize(format)} whereas the remote memory is of size {size}")
-            cfg[name] = (i, size, format,)
+        while len(cfg) < num_configs:
+            rx = self.cfg_xfer(st.pack("=BH", 10, len(cfg)))
+            if not rx:
+                raise ValueError(f"config {len(cfg)} does not fit into a response")
+            cfg.update(parse_config_records(rx, len(cfg)))
         return cfg
 
     def get_config(self, target):
@@ -81,3 +170,67 @@ class Device:
         if verbose:
             print(f"set {target} to {values}")
 
+    def get_configs(self, targets):
+        """the values of all targets, fetched with as few transfers as possible"""
+        targets = list(targets)
+        values = []
+        while len(values) < len(targets):
+            batch = targets[len(values):len(values) + (max_payload - 2) // 2]
+            idxs = [self.configs[t][0] for t in batch]
+            rx = self.cfg_xfer(st.pack(f"=BHH{len(idxs)}H", 8, 0, len(idxs), *idxs))
+            count, = st.unpack_from("H", rx, 0)
+            if count == 0:
+                raise ValueError(f"cannot get {batch[0]}")
+            pos = 2
+            for t in batch[:count]:
+                _, size, fmt = self.configs[t]
+                values.append(st.unpack_from(fmt, rx, pos))
+                pos += size
+        return values
+
+    def set_configs(self, values, verbose=False):
+        """set several configs at once, values maps the names to tuples of values"""
+        pending = [(self.configs[t][0], st.pack(self.configs[t][2], *v)) for t, v in dict(values).items()]
+        while pending:
+            payload = b""
+            count = 0
+            for idx, packed in pending:
+                if 2 + len(payload) + 2 + len(packed) > max_payload:
+                    break
+                payload += st.pack("H", idx) + packed
+                count += 1
+            done, = st.unpack("H", self.cfg_xfer(st.pack("=BHH", 9, 0, count) + payload))
+            if done == 0:
+                raise ValueError(f"cannot set config {pending[0][0]}")
+            pending = pending[done:]
+        if verbose:
+            print(f"set {values}")
+
+    def subscribe(self, target, min_interval=0.):
+        """let the device push changes of target, at most once per min_interval seconds"""
+        idx, _, _ = self.configs[target]
+        ok, = st.unpack("B", self.cfg_xfer(st.pack("=BHI", 6, idx, round(min_interval * 1e6))))
+        if not ok:
+            raise ValueError(f"cannot subscribe to {target}")
+
+    def unsubscribe(self, target=None):
+        idx = 0xffff if target is None else self.configs[target][0]
+        self.cfg_xfer(st.pack("=BH", 7, idx))
+
+    def notifications(self, timeout=100):
+        """the changes received so far as a list of (name, timestamp_us, values)"""
+        names = {idx: (name, fmt) for name, (idx, _, fmt) in self.configs.items()}
+        try:
+            self.notify_rx += self.notify_in.read(512, timeout=timeout).tobytes()
+        except usb.core.USBTimeoutError:
+            pass
+        changes = []
+        header = st.Struct("=HHI")
+        while len(self.notify_rx) >= header.size:
+            idx, size, timestamp_us = header.unpack_from(self.notify_rx)
+            if len(self.notify_rx) < header.size + size:
+                break
+            name, fmt = names[idx]
+            changes.append((name, timestamp_us, st.unpack(fmt, self.notify_rx[header.size:header.size + size])))
+            self.notify_rx = self.notify_rx[header.size + size:]
+        return changes
@@ -12,6 +12,7 @@ if __name__ == "__main__":
     parser.add_argument('--id_product', dest='id_product', type=int, default=0x1234, help='usb product id of the target device')
     parser.add_argument('--eval', dest='eval', type=str, default=None, help='code to mogrify the values')
     parser.add_argument('--x', dest='x', type=int, default=64, help='count of the samples (horizontal width)')
+    parser.add_argument('--poll', action='store_true', help='poll the values instead of subscribing to their changes')
     parser.add_argument('vals', metavar='Vals', default=["servo.state"], type=str, nargs='*', help='the variables to plot')
 
     args = parser.parse_args()
@@ -27,10 +28,22 @@ if __name__ == "__main__":
     ax = fig.add_subplot(111)
 
 
+    latest = {conf: dev.get_config(conf) for conf in args.vals}
+    if not args.poll:
+        dev.unsubscribe()
+        for conf in args.vals:
+            dev.subscribe(conf, .05)
+
     def fetch():
+        if args.poll:
+            for conf in args.vals:
+                latest[conf] = dev.get_config(conf)
+        else:
+            for name, _, values in dev.notifications(timeout=50):
+                latest[name] = values
         data = []
-        for i, conf in enumerate(args.vals):
-            data += [d for d in dev.get_config(conf)]
+        for conf in args.vals:
+            data += [d for d in latest[conf]]
         return data
 
     prev_data = fetch()
@@ -0,0 +1,63 @@
+#!/usr/bin/python3
+
+import argparse
+import time
+
+from device import Device
+
+triggers = ['immediate', 'button0', 'button1']
+states = ['idle', 'waiting_for_trigger', 'running']
+enable_flag = 1 << 31
+
+
+def load_steps(path):
+    """reads lines of 'duration_s, U, I, enable'"""
+    steps = []
+    with open(path) as f:
+        for line in f:
+            line = line.split('#')[0].strip()
+            if not line:
+                continue
+            duration, u, i, enable = [float(v) for v in line.split(',')]
+            steps.append((duration, u, i, enable != 0))
+    return steps
+
+
+def upload(dev, channel, steps):
+    for idx, (duration, u, i, enable) in enumerate(steps):
+        duration_us = round(duration * 1e6)
+        if duration_us >= enable_flag:
+            raise ValueError(f"step {idx} is too long")
+        if enable:
+            duration_us |= enable_flag
+        dev.set_config("seq.step", (channel, idx, duration_us, round(u * 1000), round(i * 1000)))
+    lengths = list(dev.get_config("seq.length"))
+    lengths[channel] = len(steps)
+    dev.set_config("seq.length", lengths)
+    if dev.get_config("seq.length")[channel] != len(steps):
+        raise RuntimeError("the sequence could not be stored (is it still running?)")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='upload and play an output sequence on the device')
+    parser.add_argument('--id_vendor', dest='id_vendor', type=int, default=0xffff, help='usb vendor id of the target device')
+    parser.add_argument('--id_product', dest='id_product', type=int, default=0x1234, help='usb product id of the target device')
+    parser.add_argument('--loops', type=int, default=1, help='how often to play the sequence (0: forever)')
+    parser.add_argument('--trigger', choices=triggers, default='immediate', help='what starts the playback')
+    parser.add_argument('--wait', action='store_true', help='wait until the sequence is done')
+    parser.add_argument('channel', type=int, choices=[0, 1], help='the output channel')
+    parser.add_argument('file', type=str, help='the sequence, one "duration_s, U, I, enable" step per line')
+
+    args = parser.parse_args()
+    dev = Device(idVendor=args.id_vendor, idProduct=args.id_product)
+
+    dev.set_config("seq.stop")
+    upload(dev, args.channel, load_steps(args.file))
+    dev.set_config("seq.run", (args.channel, triggers.index(args.trigger), args.loops))
+
+    while args.wait:
+        state, step, loop = dev.get_config("seq.status")[args.channel::2]
+        print(f"{states[state]}: step {step} loop {loop}")
+        if states[state] == 'idle':
+            break
+        time.sleep(.5)
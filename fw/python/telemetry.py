@@ -0,0 +1,115 @@
+#!/usr/bin/python3
+
+import argparse
+import time
+
+import numpy as np
+import usb.core
+
+from device import Device
+
+sync = 0x5aa5
+status_bits = ['enabled0', 'enabled1', 'tripped0', 'tripped1']
+frame_dtype = np.dtype([
+    ('sync', '<u2'),
+    ('status', '<u2'),
+    ('seq', '<u4'),
+    ('timestamp_us', '<u4'),
+    ('measured', '<i4', 4),   # u0, i0, u1, i1 in mV and mA
+    ('setpoints', '<i4', 4),
+])
+assert frame_dtype.itemsize == 44
+
+
+class FrameDecoder:
+    """turns the telemetry byte stream into arrays of frames and counts the frames lost on the way"""
+
+    def __init__(self):
+        self.pending = b""
+        self.last_seq = None
+        self.lost = 0
+
+    def resync(self):
+        """drops bytes up to the next position that looks like the start of a frame"""
+        marker = np.uint16(sync).tobytes()
+        pos = self.pending.find(marker, 1)
+        self.pending = self.pending[pos:] if pos >= 0 else b""
+
+    def feed(self, data):
+        self.pending += bytes(data)
+        chunks = []
+        while len(self.pending) >= frame_dtype.itemsize:
+            count = len(self.pending) // frame_dtype.itemsize
+            frames = np.frombuffer(self.pending, dtype=frame_dtype, count=count)
+            bad = np.flatnonzero(frames['sync'] != sync)
+            good = frames[:bad[0]] if len(bad) else frames
+            if len(good):
+                chunks.append(good.copy())
+            self.pending = self.pending[len(good) * frame_dtype.itemsize:]
+            if not len(bad):
+                break
+            self.resync()
+        if not chunks:
+            return np.empty(0, dtype=frame_dtype)
+        frames = np.concatenate(chunks)
+        seq = frames['seq'].astype(np.int64)
+        if self.last_seq is not None:
+            seq = np.concatenate(([self.last_seq], seq))
+        self.lost += int(np.sum((np.diff(seq) - 1) % (1 << 32)))
+        self.last_seq = int(frames['seq'][-1])
+        return frames
+
+
+class TelemetryStream:
+    def __init__(self, dev):
+        self.dev = dev
+        iface = dev.interface("telemetry interface")
+        self.ep = iface.endpoints()[0]
+        self.decoder = FrameDecoder()
+
+    def start(self, decimation=1):
+        self.dev.set_config("telem.decimation", (decimation,))
+
+    def stop(self):
+        self.dev.set_config("telem.decimation", (0,))
+
+    def read(self, timeout=100):
+        """the frames that arrived so far"""
+        try:
+            data = self.ep.read(512, timeout=timeout)
+        except usb.core.USBTimeoutError:
+            data = b""
+        return self.decoder.feed(data)
+
+    def record(self, duration):
+        chunks = []
+        end = time.time() + duration
+        while time.time() < end:
+            chunks.append(self.read())
+        return np.concatenate(chunks)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='record the telemetry stream')
+    parser.add_argument('--id_vendor', dest='id_vendor', type=int, default=0xffff, help='usb vendor id of the target device')
+    parser.add_argument('--id_product', dest='id_product', type=int, default=0x1234, help='usb product id of the target device')
+    parser.add_argument('--decimation', type=int, default=1, help='stream every n-th round through the adc schedule')
+    parser.add_argument('--duration', type=float, default=5., help='how long to record in seconds')
+    parser.add_argument('--out', type=str, default=None, help='store the frames into this .npy file')
+    args = parser.parse_args()
+
+    dev = Device(idVendor=args.id_vendor, idProduct=args.id_product)
+    stream = TelemetryStream(dev)
+    stream.start(args.decimation)
+    try:
+        frames = stream.record(args.duration)
+    finally:
+        stream.stop()
+
+    print(f"{len(frames)} frames, {stream.decoder.lost} lost")
+    if args.out:
+        np.save(args.out, frames)
+    elif len(frames):
+        u = frames['measured'][:, 0::2] / 1000
+        i = frames['measured'][:, 1::2] / 1000
+        print(f"U mean {u.mean(axis=0)} V, I mean {i.mean(axis=0)} A")
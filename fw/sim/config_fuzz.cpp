@@ -0,0 +1,209 @@
+#include "cranc/config/ApplicationConfig.h"
+#include "cranc/config/ConfigRegistry.h"
+
+#include "misc/ConfigProtocol.h"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * drives the config protocol engine with arbitrary packet sequences the way the usb transport does, through its
+ * PacketReceiver
+ * an input is a sequence of packets, each a u8 length followed by that many bytes (the last one may be cut short)
+ *
+ * built against libFuzzer (CONFIG_SIM_LIBFUZZER) this is a plain fuzz target, standalone it takes
+ *   config_fuzz <inputs or dirs>                         replays inputs, e.g. a crash or the corpus
+ *   config_fuzz --random <iterations> <inputs or dirs>   mutates the inputs randomly where libFuzzer isn't available
+ *   config_fuzz --throughput <iterations> <inputs or dirs> reports the cost per request of each input
+ */
+
+namespace {
+
+struct Limits {
+    float u0, i0, u1, i1;
+};
+
+// covers the sizes the engine treats differently: none, small, above the subscription limit and above max_payload
+cranc::ApplicationConfig<void> trigger {"fuzz.trigger"};
+cranc::ApplicationConfig<std::uint8_t> byte_cfg {"fuzz.byte", "B", 0};
+cranc::ApplicationConfig<float> float_cfg {"fuzz.float", "f", 0.f};
+cranc::ApplicationConfig<Limits> struct_cfg {"fuzz.limits", "4f", {0.f, 0.f, 0.f, 0.f}};
+cranc::ApplicationConfig<std::array<std::uint8_t, 100>> medium_cfg {"fuzz.medium", "100B"};
+cranc::ApplicationConfig<std::array<std::uint8_t, 600>> large_cfg {"fuzz.large", "600B"};
+
+config_protocol::Subscriptions subscriptions;
+
+void check(bool condition, char const* what) {
+    if (not condition) {
+        std::fprintf(stderr, "violated: %s\n", what);
+        std::abort();
+    }
+}
+
+// returns the number of requests executed
+std::size_t run(std::uint8_t const* data, std::size_t size) {
+    static bool frozen = false;
+    if (not frozen) {
+        check(cranc::freezeConfigs(), "the configs fit into the registry");
+        frozen = true;
+    }
+    config_protocol::Engine engine;
+    config_protocol::PacketReceiver receiver{engine, 64};
+    engine.subscriptions = &subscriptions;
+    subscriptions.unsubscribe(config_protocol::Subscriptions::no_index);
+
+    // every request takes at least one byte, executing more than were sent means the engine doesn't make progress
+    std::size_t executed = 0;
+    std::size_t pos = 0;
+    while (pos < size) {
+        std::size_t len = data[pos++];
+        len = std::min(len, size - pos);
+        std::span<const std::uint8_t> packet{data + pos, len};
+        pos += len;
+
+        receiver.received(packet);
+        for (auto response = receiver.next(); not response.empty(); response = receiver.next()) {
+            check(response.size() >= sizeof(std::uint16_t), "responses are framed");
+            check(response.size() <= sizeof(std::uint16_t) + config_protocol::max_payload, "responses fit the payload");
+            std::uint16_t framed;
+            std::memcpy(&framed, response.data(), sizeof(framed));
+            if (framed == config_protocol::rejected) {
+                check(response.size() == sizeof(framed), "rejections have no payload");
+                check(engine.state() == config_protocol::Engine::State::incomplete, "a rejection resynchronizes");
+                continue;
+            }
+            check(framed + sizeof(framed) == response.size(), "the frame size matches the response");
+            check(++executed <= size, "every request consumes input");
+        }
+        check(engine.execute().empty(), "incomplete requests are not executed");
+        subscriptions.poll(0, [](std::uint16_t index) -> std::span<std::uint8_t const> {
+            auto cfg = cranc::configAt(index);
+            return cfg ? cfg->getValue() : std::span<std::uint8_t const>{};
+        }, [](std::uint16_t, std::uint32_t, std::span<std::uint8_t const> value) {
+            check(value.size() <= 64, "subscribed values fit the table");
+            return true;
+        });
+    }
+    return executed;
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(std::uint8_t const* data, std::size_t size) {
+    run(data, size);
+    return 0;
+}
+
+#ifdef CONFIG_FUZZ_STANDALONE
+
+namespace {
+
+using Input = std::vector<std::uint8_t>;
+
+std::vector<std::pair<std::string, Input>> load_inputs(int argc, char** argv) {
+    std::vector<std::pair<std::string, Input>> inputs;
+    auto add = [&](std::filesystem::path const& p) {
+        std::ifstream f{p, std::ios::binary};
+        inputs.emplace_back(p.string(), Input{std::istreambuf_iterator<char>{f}, {}});
+    };
+    for (auto i = 0; i < argc; ++i) {
+        if (std::filesystem::is_directory(argv[i])) {
+            for (auto const& entry : std::filesystem::directory_iterator{argv[i]}) {
+                add(entry.path());
+            }
+        } else {
+            add(argv[i]);
+        }
+    }
+    return inputs;
+}
+
+void mutate(Input& input, Input const& other, std::mt19937& rng) {
+    auto pick = [&](std::size_t n) { return std::uniform_int_distribution<std::size_t>{0, n}(rng); };
+    switch (pick(3)) {
+    case 0:
+        if (not input.empty()) {
+            input[pick(input.size() - 1)] ^= 1 << pick(7);
+        }
+        break;
+    case 1:
+        if (not input.empty()) {
+            input[pick(input.size() - 1)] = pick(255);
+        }
+        break;
+    case 2:
+        input.insert(input.begin() + pick(input.size()), other.begin(), other.begin() + pick(other.size()));
+        break;
+    default:
+        input.resize(pick(input.size()));
+        break;
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string_view mode = argc > 1 ? argv[1] : "";
+    bool random = mode == "--random";
+    bool throughput = mode == "--throughput";
+    int first = (random or throughput) ? 3 : 1;
+    if (argc <= first) {
+        std::fprintf(stderr, "usage: %s [--random <iterations> | --throughput <iterations>] <inputs or dirs>\n", argv[0]);
+        return 1;
+    }
+    auto iterations = first == 3 ? std::strtoul(argv[2], nullptr, 0) : 1;
+    auto inputs = load_inputs(argc - first, argv + first);
+    if (inputs.empty()) {
+        std::fprintf(stderr, "no inputs\n");
+        return 1;
+    }
+
+    if (random) {
+        std::mt19937 rng{1};
+        for (auto i = 0UL; i < iterations; ++i) {
+            auto input = inputs[rng() % inputs.size()].second;
+            for (auto n = rng() % 8; n != 0; --n) {
+                mutate(input, inputs[rng() % inputs.size()].second, rng);
+            }
+            run(input.data(), input.size());
+        }
+        std::printf("%lu random inputs ok\n", iterations);
+        return 0;
+    }
+
+    std::size_t total_requests = 0;
+    std::chrono::nanoseconds total_time{};
+    for (auto const& [name, input] : inputs) {
+        std::size_t requests = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto i = 0UL; i < iterations; ++i) {
+            requests += run(input.data(), input.size());
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        total_requests += requests;
+        total_time += elapsed;
+        if (throughput) {
+            std::printf("%-40s %8zu requests %10.1f ns/request\n", name.c_str(), requests,
+                requests ? static_cast<double>(elapsed.count()) / requests : 0.);
+        }
+    }
+    if (throughput) {
+        std::printf("%-40s %8zu requests %10.1f ns/request\n", "total", total_requests,
+            total_requests ? static_cast<double>(total_time.count()) / total_requests : 0.);
+    } else {
+        std::printf("%zu inputs ok\n", inputs.size());
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "cranc/config/ApplicationConfig.h"
+#include "cranc/config/ConfigRegistry.h"
+
+#include "misc/ConfigProtocol.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+
+/*
+ * serves the config protocol on a unix socket with the framing of the bulk interface
+ * usage: config_sim <socket path> [extra configs]
+ */
+
+namespace {
+
+struct Limits {
+    float u0, i0, u1, i1;
+};
+
+cranc::ApplicationConfig<float> vout0 {"vout0", "f", 0.f};
+cranc::ApplicationConfig<float> iout0 {"iout0", "f", 0.f};
+cranc::ApplicationConfig<float> vout1 {"vout1", "f", 0.f};
+cranc::ApplicationConfig<float> iout1 {"iout1", "f", 0.f};
+cranc::ApplicationConfig<Limits> limits {"prot.limits", "4f", {0.f, 0.f, 0.f, 0.f}};
+cranc::ApplicationConfig<std::array<std::uint64_t, 3>> load {"system.load", "3Q"};
+cranc::ApplicationConfig<void> reset_cfg {"sim.reset"};
+
+// configs to scale the registry up for load tests
+std::deque<std::string> extra_names;
+std::deque<cranc::ApplicationConfig<std::uint32_t>> extra_configs;
+
+bool write_all(int fd, std::span<const std::uint8_t> data) {
+    while (not data.empty()) {
+        auto n = write(fd, data.data(), data.size());
+        if (n <= 0) {
+            return false;
+        }
+        data = data.subspan(n);
+    }
+    return true;
+}
+
+void serve(int fd) {
+    config_protocol::Engine engine;
+    // a read that doesn't fill the buffer ends a transfer, as a short packet does on usb
+    std::array<std::uint8_t, 512> buffer;
+    config_protocol::PacketReceiver receiver{engine, buffer.size()};
+    while (true) {
+        auto n = read(fd, buffer.data(), buffer.size());
+        if (n <= 0) {
+            return;
+        }
+        receiver.received({buffer.data(), static_cast<std::size_t>(n)});
+        for (auto response = receiver.next(); not response.empty(); response = receiver.next()) {
+            if (not write_all(fd, response)) {
+                return;
+            }
+        }
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <socket path> [extra configs]\n", argv[0]);
+        return 1;
+    }
+    auto extra = argc > 2 ? std::atoi(argv[2]) : 0;
+    for (auto i = 0; i < extra; ++i) {
+        extra_names.push_back("sim.extra" + std::to_string(i));
+        extra_configs.emplace_back(extra_names.back(), "I", static_cast<std::uint32_t>(i));
+    }
+    if (not cranc::freezeConfigs()) {
+        std::fprintf(stderr, "more than %zu configs, the lookups walk the list like the firmware would\n", cranc::maxConfigs);
+    }
+    std::fprintf(stderr, "serving %zu configs on %s\n", cranc::configCount(), argv[1]);
+
+    int srv = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+    unlink(argv[1]);
+    if (bind(srv, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 or listen(srv, 1) != 0) {
+        std::perror("socket");
+        return 1;
+    }
+    while (true) {
+        int fd = accept(srv, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        serve(fd);
+        close(fd);
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// the host build runs single threaded without interrupts, locking is a no-op
+
+#include <cstdint>
+
+inline std::uint32_t save_and_disable_interrupts() { return 0; }
+inline void restore_interrupts_from_disabled(std::uint32_t) {}
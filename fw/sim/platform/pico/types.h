@@ -0,0 +1,12 @@
+#pragma once
+
+// the bits of the sdk's types the usb descriptors use
+
+#include <cstdint>
+#include <cstddef>
+
+typedef unsigned int uint;
+
+#ifndef __packed
+#define __packed __attribute__((packed))
+#endif
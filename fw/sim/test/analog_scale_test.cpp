@@ -0,0 +1,117 @@
+#include "check.h"
+
+#include "util/AdcConversion.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+/*
+ * the settings analog_readings.cpp derives for the ADS1115, checked field by field against the register map and the
+ * full scale ranges of the datasheet for every channel, PGA code and data rate, and the fallback of the schedule
+ */
+
+namespace {
+
+using namespace adc;
+
+// the analog input each channel is wired to and its front end, volts per volt behind the divider or amps per volt
+// across the 5 mOhm shunt with a gain of 100
+constexpr std::array<std::uint8_t, num_channels> inputs {2, 3, 1, 0};
+constexpr std::array<double, num_channels> front_end_gains {104. / 13, 2, 104. / 13, 2};
+
+// the datasheet's full scale ranges, codes above 0b101 are the smallest range again
+constexpr std::array<double, 6> full_scale {6.144, 4.096, 2.048, 1.024, 0.512, 0.256};
+constexpr std::array<int, 8> samples_per_second {8, 16, 32, 64, 128, 250, 475, 860};
+
+bool close(double a, double b) {
+    return std::abs(a - b) <= std::abs(b) * 1e-6;
+}
+
+void scales() {
+    for (std::size_t channel = 0; channel < num_channels; ++channel) {
+        sim::check(close(channels[channel].gain, front_end_gains[channel]), "the front end gain of every channel");
+        for (std::uint8_t pga = 0; pga < 8; ++pga) {
+            auto range = full_scale[std::min<std::size_t>(pga, 5)];
+            auto scale = reading_to_value_scale(channel, pga);
+            sim::check(close(scale, range / 32767 * front_end_gains[channel]), "a count is the full scale range over 2^15 - 1");
+            sim::check(close(32767 * scale, range * front_end_gains[channel]), "the largest count is the full scale at the input");
+            sim::check(scale == reading_to_value_scale(channel, pga | 0b1000), "only three bits select the range");
+        }
+        sim::check(reading_to_value_scale(channel, 0b110) == reading_to_value_scale(channel, 0b101)
+                   and reading_to_value_scale(channel, 0b111) == reading_to_value_scale(channel, 0b101), "0b110 and 0b111 alias 0b101");
+    }
+    sim::check(close(32767 * reading_to_value_scale(0, default_pga), 49.152), "the output voltage spans 49 V by default");
+    sim::check(close(32767 * reading_to_value_scale(1, default_pga), 12.288), "the current 12 A");
+}
+
+void configs() {
+    for (std::size_t channel = 0; channel < num_channels; ++channel) {
+        for (std::uint8_t pga = 0; pga < 8; ++pga) {
+            for (std::uint8_t rate = 0; rate < 8; ++rate) {
+                auto config = conversion_config(channel, pga, rate);
+                bool ok = true;
+                ok &= sim::check(config[0] >> 7 == 1, "starts a conversion");
+                ok &= sim::check((config[0] >> 4 & 0b111) == (0b100 | inputs[channel]), "of the channel's input against ground");
+                ok &= sim::check((config[0] >> 1 & 0b111) == pga, "with the PGA code");
+                ok &= sim::check((config[0] & 1) == 1, "as a single shot");
+                ok &= sim::check(config[1] >> 5 == rate, "at the data rate code");
+                ok &= sim::check((config[1] & 0b11111) == 0b01100, "with a latching active high ready after each conversion");
+                ok &= sim::check(config == conversion_config(channel, pga | 0b11000, rate | 0b11000), "only three bits of each code count");
+                if (not ok) {
+                    std::fprintf(stderr, "  channel %zu pga %u rate %u\n", channel, pga, rate);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+void rates() {
+    using namespace std::literals::chrono_literals;
+    for (std::uint8_t rate = 0; rate < 8; ++rate) {
+        sim::check(data_rates[rate] == samples_per_second[rate], "the data rates of the datasheet");
+        auto conversion = std::chrono::duration<double>{1. / samples_per_second[rate]};
+        auto timeout = conversion_timeout(rate);
+        sim::check(timeout >= 2 * conversion and timeout >= 50ms, "the timeout is at least two conversions and 50 ms");
+        sim::check(timeout <= std::max<cranc::Duration>(50ms, 2 * std::chrono::duration_cast<cranc::Duration>(conversion) + 1ms),
+                   "and not much more");
+        sim::check(timeout == conversion_timeout(rate | 0b1000), "only three bits select the rate");
+    }
+    sim::check(conversion_timeout(0) == 250ms, "8 samples per second wait 250 ms");
+}
+
+void schedules() {
+    Schedule all{0, 1, 2, 3, schedule_end};
+    Schedule fallback = sampled_schedule(Schedule{schedule_end});
+    auto sampled = [](Schedule const& s) {
+        std::array<int, max_schedule_len> channels{};
+        std::size_t n = 0;
+        for (auto c : s) {
+            if (c >= num_channels) {
+                break;
+            }
+            channels[n++] = c;
+        }
+        return std::pair{channels, n};
+    };
+    sim::check(sampled(fallback) == sampled(all), "an empty schedule samples every channel in order");
+    sim::check(sampled(sampled_schedule(Schedule{4, 1, 2})) == sampled(all), "as does one that starts with a channel that doesn't exist");
+    Schedule once{3, 3, 0, schedule_end, 1};
+    sim::check(sampled_schedule(once) == once, "a valid schedule is kept");
+    sim::check(sampled(sampled_schedule(once)).second == 3, "and ends at the first entry that isn't a channel");
+    Schedule full;
+    full.fill(1);
+    sim::check(sampled(sampled_schedule(full)).second == max_schedule_len, "a schedule may use every entry");
+}
+
+}
+
+int main() {
+    scales();
+    configs();
+    rates();
+    schedules();
+    return sim::result("analog_scale");
+}
@@ -0,0 +1,96 @@
+#include "check.h"
+
+#include "capture.h"
+#include "util/TriggeredCapture.h"
+
+/*
+ * the trigger logic and ring buffer of the capture mode, fed the way capture.cpp feeds them
+ */
+
+namespace {
+
+constexpr std::size_t depth = 16;
+using Capture = TriggeredCapture<std::uint32_t, depth>;
+
+// pushes samples numbered from first until the capture is done, triggers when the sample numbered trigger_at arrives
+std::uint32_t run(Capture& c, std::uint32_t first, std::uint32_t trigger_at, std::uint32_t limit = 1000) {
+    for (auto n = first; n < first + limit; ++n) {
+        if (n == trigger_at) {
+            c.trigger();
+        }
+        c.push(n);
+        if (c.getState() == Capture::State::done) {
+            return n;
+        }
+    }
+    return 0;
+}
+
+void ring_buffer() {
+    Capture c;
+    c.push(1);
+    sim::check(c.getState() == Capture::State::idle and c.size() == 0, "an idle capture records nothing");
+
+    // pre trigger samples from before the ring wrapped several times
+    for (std::size_t pre : {std::size_t{0}, std::size_t{1}, std::size_t{5}, depth - 1}) {
+        c.arm(pre);
+        auto trigger_at = 100;
+        auto last = run(c, 0, trigger_at);
+        sim::check(last == trigger_at + depth - pre - 1, "stops after filling the post trigger part");
+        sim::check(c.size() == depth and c.trigger_index() == pre, "holds the whole buffer");
+        for (std::size_t i = 0; i < depth; ++i) {
+            if (not sim::check(c[i] == trigger_at - pre + i, "samples are in chronological order around the trigger")) {
+                break;
+            }
+        }
+        c.push(12345);
+        sim::check(c[depth - 1] == last, "a done capture ignores further samples");
+    }
+
+    // a trigger arriving before the pre trigger history is filled waits for it
+    c.arm(8);
+    sim::check(not c.ready(), "not ready before the history is filled");
+    auto last = run(c, 0, 2);
+    sim::check(c.trigger_index() == 8 and c[8] == 8 and last == 8 + depth - 8 - 1, "an early trigger is taken once ready");
+
+    c.arm(depth + 10);
+    sim::check(c.trigger_index() == depth - 1, "the pre trigger depth is limited");
+    run(c, 0, 50);
+    sim::check(c[depth - 1] == 50, "at least the trigger sample is recorded");
+
+    c.trigger();
+    c.stop();
+    sim::check(c.getState() == Capture::State::idle and c.size() == 0, "stop discards the capture");
+    c.trigger();
+    c.arm(2);
+    run(c, 0, 1000, 20);
+    sim::check(c.getState() == Capture::State::armed, "triggers before arming are dropped");
+}
+
+capture::Sample sample(float u0) {
+    return {0, {u0, 0, 0, 0}, {}};
+}
+
+void triggers() {
+    using capture::TriggerMode;
+    capture::Trigger above{TriggerMode::above, 0, 1.f};
+    capture::Trigger below{TriggerMode::below, 0, 1.f};
+    capture::Trigger rising{TriggerMode::rising_edge, 0, 1.f};
+    capture::Trigger falling{TriggerMode::falling_edge, 0, 1.f};
+    sim::check(above(sample(0), sample(1.5f)) and not above(sample(0), sample(1.f)), "above the level");
+    sim::check(below(sample(2), sample(.5f)) and not below(sample(0), sample(1.f)), "below the level");
+    sim::check(rising(sample(1.f), sample(1.5f)) and not rising(sample(1.2f), sample(1.5f)), "rising edges cross the level");
+    sim::check(falling(sample(1.f), sample(.5f)) and not falling(sample(.8f), sample(.5f)), "falling edges cross the level");
+    capture::Trigger out_of_range{TriggerMode::above, 4, -1.f};
+    sim::check(not out_of_range(sample(0), sample(0)), "channels past the sample never trigger");
+    capture::Trigger output{TriggerMode::output_enable, 0, 0.f};
+    sim::check(not output(sample(0), sample(5)), "the output modes are not sample based");
+}
+
+}
+
+int main() {
+    ring_buffer();
+    triggers();
+    return sim::result("capture");
+}
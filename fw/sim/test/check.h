@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <limits>
+#include <source_location>
+#include <string_view>
+
+/*
+ * the bits shared by the host tests of the firmware kernels
+ * a test reports every violated check and exits non zero if there was one, ctest only looks at the exit code
+ * tests that come with a benchmark run it when started with --bench
+ */
+
+namespace sim {
+
+inline int failures = 0;
+
+inline bool check(bool condition, char const* what, std::source_location where = std::source_location::current()) {
+    if (not condition) {
+        std::fprintf(stderr, "%s:%u: violated: %s\n", where.file_name(), static_cast<unsigned>(where.line()), what);
+        ++failures;
+    }
+    return condition;
+}
+
+inline bool bench_requested(int argc, char** argv) {
+    return argc > 1 and std::string_view{argv[1]} == "--bench";
+}
+
+inline int result(char const* name) {
+    std::printf("%s: %s\n", name, failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
+
+// nanoseconds per call of f, the best of several batches so the scheduler doesn't skew the result
+template<typename F>
+double measure_ns(std::size_t rounds, F&& f) {
+    constexpr int batches = 8;
+    double best = std::numeric_limits<double>::max();
+    for (auto b = 0; b < batches; ++b) {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t r = 0; r < rounds; ++r) {
+            f(r);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / rounds);
+    }
+    return best;
+}
+
+// keeps the compiler from dropping a benchmarked computation
+template<typename T>
+void keep(T const& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+}
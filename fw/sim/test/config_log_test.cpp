@@ -0,0 +1,354 @@
+#include "check.h"
+#include "nor_flash.h"
+
+#include "persistent_config/ConfigLog.h"
+
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * the config log of the persistent configs on a simulated NOR flash of the size of the CONFIG region: values survive a
+ * reboot, only changes are appended, a full bank is compacted into the other one, and a power loss at a random point of
+ * a save or erase leaves every value either as it was or as it was being saved
+ * the steps of a save run like from the main loop, with a reader and a setter of the values in between
+ * config_log_test --bench measures the boot, loading the log and finding every value, with up to 300 configs
+ */
+
+namespace {
+
+// as many entries as records of the smallest size fit into a bank, the firmware has far less configs
+constexpr std::size_t max_entries = 512;
+using Log = config::ConfigLog<sim::NorFlash, max_entries>;
+using Values = std::vector<std::vector<std::uint8_t>>;
+
+struct Configs {
+    std::vector<std::string> names;
+    std::vector<std::string> formats;
+    Values values;
+
+    Configs() = default;
+
+    explicit Configs(std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            auto size = 1 + i * 7 % 40;
+            names.push_back("log.config" + std::to_string(i));
+            formats.push_back(std::to_string(size) + "s");
+            values.emplace_back(size, static_cast<std::uint8_t>(i));
+        }
+    }
+
+    // configs with the shortest names and a byte each, as many as possible fit into a bank
+    static Configs small(std::size_t n) {
+        Configs configs;
+        for (std::size_t i = 0; i < n; ++i) {
+            configs.names.push_back("c" + std::to_string(i));
+            configs.formats.push_back("B");
+            configs.values.push_back({static_cast<std::uint8_t>(i)});
+        }
+        return configs;
+    }
+
+    // the source of a save
+    auto source() {
+        return [this](std::size_t i) -> std::optional<config::LogValue> {
+            if (i >= values.size()) {
+                return {};
+            }
+            return config::LogValue{names[i], formats[i], values[i]};
+        };
+    }
+
+    // what a boot finds in the flash, an empty value for a config without one
+    Values stored(sim::Nor& nor) const {
+        Log log{sim::NorFlash{&nor}};
+        log.load();
+        Values found(values.size());
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (auto v = log.find(names[i], formats[i])) {
+                found[i].assign(v->begin(), v->end());
+            }
+        }
+        return found;
+    }
+};
+
+template<typename L>
+void run_to_end(L& log, Configs& configs) {
+    auto steps = log.save(configs.source());
+    while (steps.advance()) {}
+}
+
+// runs the steps on a freshly booted log until they are done or the power fails
+template<typename F>
+void run(sim::Nor& nor, F&& steps_of) {
+    Log log{sim::NorFlash{&nor}};
+    log.load();
+    auto steps = steps_of(log);
+    while (nor.powered and steps.advance()) {}
+}
+
+void save(sim::Nor& nor, Configs& configs) {
+    run(nor, [&](Log& log) { return log.save(configs.source()); });
+}
+
+void change(Configs& configs, std::mt19937& rng, std::size_t n) {
+    for (; n > 0; --n) {
+        auto& v = configs.values[rng() % configs.values.size()];
+        v[rng() % v.size()] = rng();
+    }
+}
+
+void values() {
+    sim::Nor nor;
+    Configs configs{12};
+    sim::check(configs.stored(nor) == Values(12), "an erased flash holds no values");
+
+    save(nor, configs);
+    sim::check(configs.stored(nor) == configs.values, "the values survive a reboot");
+    auto programs = nor.programs;
+    auto erases = nor.erases;
+    save(nor, configs);
+    sim::check(nor.programs == programs, "unchanged values aren't written again");
+
+    configs.values[3][0] ^= 0xff;
+    save(nor, configs);
+    sim::check(nor.programs - programs <= 2 and nor.erases == erases, "a change is appended");
+    sim::check(configs.stored(nor) == configs.values, "and wins over the older record");
+
+    Log log{sim::NorFlash{&nor}};
+    log.load();
+    auto bank = log.bank;
+    std::mt19937 rng{1};
+    for (auto i = 0; i < 200 and nor.erases == erases; ++i) {
+        change(configs, rng, 1);
+        save(nor, configs);
+    }
+    log.load();
+    sim::check(nor.erases > erases and log.bank != bank, "a full bank is compacted into the other one");
+    sim::check(configs.stored(nor) == configs.values, "with the current values");
+
+    Configs other{3};
+    other.names = {"log.other0", configs.names[1], configs.names[2]};
+    other.formats[2] = "2s";
+    other.values[2].resize(2);
+    sim::check(other.stored(nor) == Values{{}, configs.values[1], {}}, "values are found by name and format");
+
+    run(nor, [](Log& log) { return log.erase(); });
+    sim::check(configs.stored(nor) == Values(12), "erasing drops every value");
+}
+
+// saves and erases from random points of a history of values, with the power failing in a random step of half of them
+void power_loss() {
+    std::mt19937 rng{47};
+    sim::Nor nor;
+    Configs configs{12};
+    // every value a config had in the flash, an interrupted erase may bring back an older one from the other bank
+    std::vector<std::set<std::vector<std::uint8_t>>> history(configs.values.size());
+    auto committed = configs.stored(nor);
+    std::size_t losses = 0;
+    bool ok = true;
+    for (auto round = 0; round < 2'000 and ok; ++round) {
+        bool erase = rng() % 50 == 0;
+        change(configs, rng, rng() % 4);
+        // how many steps the whole run takes, to lose the power somewhere in between
+        auto probe = nor;
+        if (erase) {
+            run(probe, [](Log& log) { return log.erase(); });
+        } else {
+            save(probe, configs);
+        }
+        auto total = probe.steps - nor.steps;
+        if (total > 0 and rng() % 2 == 0) {
+            nor.power_loss_in = rng() % total;
+            ++losses;
+        }
+        if (erase) {
+            run(nor, [](Log& log) { return log.erase(); });
+        } else {
+            save(nor, configs);
+        }
+        bool lost = not nor.powered;
+        nor.power_up();
+
+        auto found = configs.stored(nor);
+        for (std::size_t i = 0; i < found.size(); ++i) {
+            if (erase) {
+                ok &= sim::check(found[i].empty() or history[i].contains(found[i]), "an interrupted erase leaves no value that never was");
+            } else if (lost) {
+                ok &= sim::check(found[i] == committed[i] or found[i] == configs.values[i], "an interrupted save leaves the old or the new value");
+            } else {
+                ok &= sim::check(found[i] == configs.values[i], "a save stores every value");
+            }
+            if (not found[i].empty()) {
+                history[i].insert(found[i]);
+            }
+        }
+        if (erase and not lost) {
+            ok &= sim::check(found == Values(configs.values.size()), "an erase drops every value");
+        }
+        committed = found;
+    }
+    sim::check(losses > 500, "the power failed often enough");
+
+    // whatever the last loss left behind, the next save and erase work
+    save(nor, configs);
+    sim::check(configs.stored(nor) == configs.values, "the next save stores every value");
+    run(nor, [](Log& log) { return log.erase(); });
+    sim::check(configs.stored(nor) == Values(configs.values.size()), "the next erase drops every value");
+}
+
+// every step programs a page or erases a sector, a reader in between only finds complete values, and a value that
+// changes while its record is written is stored as it was when the record was started
+void steps() {
+    std::mt19937 rng{48};
+    sim::Nor nor;
+    Configs configs{12};
+    save(nor, configs);
+    Log log{sim::NorFlash{&nor}};
+    log.load();
+    auto erases = nor.erases;
+    std::size_t most = 0;
+    bool ok = true;
+    for (auto round = 0; round < 500 and ok; ++round) {
+        change(configs, rng, 1 + rng() % 3);
+        // what a reader may find: the stored values and every value the save may have started a record of
+        std::vector<std::set<std::vector<std::uint8_t>>> expected(configs.values.size());
+        auto stored = configs.stored(nor);
+        for (std::size_t i = 0; i < stored.size(); ++i) {
+            expected[i] = {stored[i], configs.values[i]};
+        }
+        auto steps = log.save(configs.source());
+        std::size_t n = 0;
+        while (ok) {
+            auto ops = nor.erases + nor.programs;
+            bool more = steps.advance();
+            ok &= sim::check(nor.erases + nor.programs - ops <= 1, "a step programs a page or erases a sector");
+            if (not more) {
+                break;
+            }
+            ++n;
+            for (std::size_t i = 0; i < configs.values.size(); ++i) {
+                if (auto v = log.find(configs.names[i], configs.formats[i])) {
+                    ok &= sim::check(expected[i].contains({v->begin(), v->end()}), "a reader between the steps finds complete values");
+                }
+            }
+            if (rng() % 4 == 0) {
+                auto i = rng() % configs.values.size();
+                configs.values[i][0] ^= 1 + rng() % 255;
+                expected[i].insert(configs.values[i]);
+            }
+        }
+        most = std::max(most, n);
+        auto found = configs.stored(nor);
+        for (std::size_t i = 0; i < found.size(); ++i) {
+            ok &= sim::check(expected[i].contains(found[i]), "a value changed during the save is stored as it was started or not at all");
+        }
+    }
+    sim::check(nor.erases > erases and most > 1, "appends and compactions are split into steps");
+
+    // the changes that came too late are picked up by the next save
+    save(nor, configs);
+    sim::check(configs.stored(nor) == configs.values, "the next save stores them");
+}
+
+// values the log has no room for are counted in dropped instead of vanishing silently
+void limits() {
+    sim::Nor nor;
+    config::ConfigLog<sim::NorFlash, 8> log{sim::NorFlash{&nor}};
+    log.load();
+    Configs configs{10};
+    run_to_end(log, configs);
+    sim::check(log.count == 8 and log.dropped == 2, "keys beyond the entries are dropped and counted");
+    sim::check(log.find(configs.names[7], configs.formats[7]) and not log.find(configs.names[8], configs.formats[8]), "in the order of the source");
+    auto erases = nor.erases;
+    configs.values[9][0] ^= 1;
+    configs.values[0][0] ^= 1;
+    run_to_end(log, configs);
+    sim::check(log.dropped == 2 and nor.erases == erases, "without compacting on every save");
+    log.load();
+    sim::check(log.count == 8 and log.dropped == 0, "the log holds no more than fits into the index");
+
+    sim::Nor many_nor;
+    auto many = Configs::small(300);
+    Log small_log{sim::NorFlash{&many_nor}};
+    small_log.load();
+    run_to_end(small_log, many);
+    sim::check(small_log.dropped == 0 and many.stored(many_nor) == many.values, "a few hundred configs fit into a bank");
+    auto more = Configs::small(max_entries);
+    run_to_end(small_log, more);
+    sim::check(small_log.dropped > 0 and small_log.count < max_entries, "the bank runs full before the index");
+    sim::check(many.stored(many_nor) == many.values, "and keeps what it held");
+
+    // twenty values of 500 bytes need more than a bank
+    sim::Nor big_nor;
+    Configs big;
+    for (auto i = 0; i < 20; ++i) {
+        big.names.push_back("log.big" + std::to_string(i));
+        big.formats.push_back("500s");
+        big.values.emplace_back(500, static_cast<std::uint8_t>(i));
+    }
+    auto first = big;
+    first.names.resize(5);
+    first.formats.resize(5);
+    first.values.resize(5);
+    run(big_nor, [&](Log& log) { return log.save(first.source()); });
+    Log big_log{sim::NorFlash{&big_nor}};
+    big_log.load();
+    run_to_end(big_log, big);
+    sim::check(big_log.dropped > 0 and big_log.dropped < 20, "values that don't fit into a bank are counted");
+    auto found = big.stored(big_nor);
+    sim::check(std::equal(found.begin(), found.begin() + 5, big.values.begin()), "and the bank before stays active");
+
+    // too large for a record at all
+    Configs huge{1};
+    huge.values[0].resize(config::ConfigLog<sim::NorFlash, 8>::max_value_size + 1);
+    run_to_end(log, huge);
+    sim::check(log.dropped == 1, "a value too large for a record is counted");
+}
+
+void bench() {
+    for (std::size_t n : {50, 150, 300}) {
+        sim::Nor nor;
+        auto configs = Configs::small(n);
+        run(nor, [&](Log& log) { return log.save(configs.source()); });
+        // half of the values changed once since the last compaction
+        for (std::size_t i = 0; i < n; i += 2) {
+            configs.values[i][0] ^= 0xff;
+        }
+        run(nor, [&](Log& log) { return log.save(configs.source()); });
+        std::size_t found = 0;
+        auto boot_ns = sim::measure_ns(20, [&](std::size_t) {
+            Log log{sim::NorFlash{&nor}};
+            log.load();
+            for (std::size_t i = 0; i < n; ++i) {
+                found += log.find(configs.names[i], configs.formats[i]).has_value();
+            }
+            sim::keep(log.count);
+        });
+        Log log{sim::NorFlash{&nor}};
+        auto load_ns = sim::measure_ns(20, [&](std::size_t) {
+            log.load();
+            sim::keep(log.count);
+        });
+        sim::check(found == 8 * 20 * n, "the boot finds every value");
+        std::printf("%3zu configs, %3zu records: boot %6.1f us of which %6.1f us loading the log\n",
+                    n, n + (n + 1) / 2, boot_ns / 1000, load_ns / 1000);
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    values();
+    power_loss();
+    steps();
+    limits();
+    if (sim::bench_requested(argc, argv)) {
+        bench();
+    }
+    return sim::result("config_log");
+}
@@ -0,0 +1,157 @@
+#include "check.h"
+#include "nor_flash.h"
+
+#include "persistent_config/ConfigLog.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+/*
+ * a save of the config log torn by a power loss at every step it takes, every byte programmed and every page erased,
+ * once while appending to a bank and once while compacting a full one
+ * the boot after it has to find every value, either as it was or as it was being saved, taking what the damaged log of
+ * the current bank lacks from the previous copy, and the next save has to store all of them again
+ * a bit flipped in a record or the header of the current bank is handled by the same fallback
+ */
+
+namespace {
+
+// as many entries as the firmware's log
+using Log = config::ConfigLog<sim::NorFlash, 32>;
+using Values = std::vector<std::vector<std::uint8_t>>;
+
+constexpr std::size_t count = 10;
+
+std::vector<std::string> const names = [] {
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < count; ++i) {
+        names.push_back("torn.config" + std::to_string(i));
+    }
+    return names;
+}();
+
+void save(sim::Nor& nor, Values const& values) {
+    Log log{sim::NorFlash{&nor}};
+    log.load();
+    auto steps = log.save([&](std::size_t i) -> std::optional<config::LogValue> {
+        if (i >= count) {
+            return {};
+        }
+        return config::LogValue{names[i], "B", values[i]};
+    });
+    while (nor.powered and steps.advance()) {}
+}
+
+// an empty value for a config the boot doesn't find
+Values stored(sim::Nor& nor) {
+    Log log{sim::NorFlash{&nor}};
+    log.load();
+    Values found(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (auto v = log.find(names[i], "B")) {
+            found[i].assign(v->begin(), v->end());
+        }
+    }
+    return found;
+}
+
+std::size_t bank_of(sim::Nor& nor) {
+    Log log{sim::NorFlash{&nor}};
+    log.load();
+    return log.bank;
+}
+
+void torn(char const* what, sim::Nor const& initial, Values const& before, Values const& after) {
+    auto probe = initial;
+    save(probe, after);
+    auto total = probe.steps - initial.steps;
+    for (std::size_t k = 0; k < total; ++k) {
+        auto nor = initial;
+        nor.power_loss_in = k;
+        save(nor, after);
+        nor.power_up();
+        auto found = stored(nor);
+        for (std::size_t i = 0; i < count; ++i) {
+            if (not sim::check(found[i] == before[i] or found[i] == after[i], "a torn save leaves every value old or new")) {
+                std::fprintf(stderr, "  %s, power lost in step %zu of %zu, value %zu\n", what, k, total, i);
+                return;
+            }
+        }
+        save(nor, after);
+        if (not sim::check(stored(nor) == after, "the next save stores every value")) {
+            std::fprintf(stderr, "  %s, power lost in step %zu of %zu\n", what, k, total);
+            return;
+        }
+    }
+    std::printf("%s: torn in each of %zu steps\n", what, total);
+}
+
+}
+
+int main() {
+    Values values(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        values[i].assign(4 + 7 * i, static_cast<std::uint8_t>(i));
+    }
+    sim::Nor nor;
+    save(nor, values);
+
+    auto changed = values;
+    changed[1][0] ^= 1;
+    changed[4][3] = 0x55;
+    changed[9].assign(changed[9].size(), 0xaa);
+    torn("append", nor, values, changed);
+
+    // appends until the next save compacts
+    auto full = nor;
+    auto bank = bank_of(full);
+    for (std::size_t n = 0;; ++n) {
+        auto next = values;
+        next[n % count][0] += 1;
+        auto probe = full;
+        save(probe, next);
+        if (bank_of(probe) != bank) {
+            break;
+        }
+        full = probe;
+        values = next;
+    }
+    changed = values;
+    changed[2][1] ^= 0xff;
+    changed[7][0] ^= 0x0f;
+    torn("compaction", full, values, changed);
+
+    // the previous bank holds the log before the compaction, the current one gets a newer value of each config
+    auto rot = full;
+    save(rot, changed);
+    auto newer = changed;
+    for (auto& v : newer) {
+        v[0] ^= 0x80;
+    }
+    save(rot, newer);
+    auto active = bank_of(rot);
+    auto bank_size = rot.memory.size() / 2;
+    auto flipped = rot;
+    flipped.memory[active * bank_size + sizeof(config::LogBankHeader) + sizeof(config::LogRecordHeader) + 3] ^= 0x04;
+    auto found = stored(flipped);
+    bool ok = true;
+    for (std::size_t i = 0; i < count; ++i) {
+        ok &= not found[i].empty() and (found[i] == newer[i] or found[i] == changed[i] or found[i] == values[i]);
+    }
+    sim::check(ok, "a flipped bit in a record takes the values from there on from the previous copy");
+
+    flipped = rot;
+    flipped.memory[active * bank_size + offsetof(config::LogBankHeader, sequence)] ^= 0x01;
+    sim::check(bank_of(flipped) != active, "a flipped bit in the bank header makes the previous copy current");
+    found = stored(flipped);
+    ok = true;
+    for (std::size_t i = 0; i < count; ++i) {
+        ok &= found[i] == values[i] or found[i] == changed[i];
+    }
+    sim::check(ok, "with the values it held");
+    save(flipped, newer);
+    sim::check(stored(flipped) == newer, "and the next save stores every value");
+
+    return sim::result("config_log_torn");
+}
@@ -0,0 +1,177 @@
+#include "check.h"
+
+#include "util/Correction.h"
+#include "util/ScaledNumber.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+/*
+ * the fixed point correction curves of the output path against double precision references
+ * correction_test --bench compares the cost of the fixed point path with a float horner evaluation; the host has an
+ * fpu, so the float numbers are a lower bound for the soft float on the rp2040
+ */
+
+namespace {
+
+constexpr double one = 1 << correction_frac_bits;
+
+// the output path of output.cpp: polynomial, table, scaled to pwm counts with 6 bits of dither resolution
+constexpr std::size_t order = 4;
+constexpr int dither_bits = 6;
+using PwmCountsPerUnit = FixedPoint<std::int32_t, correction_frac_bits>;
+using CorrectedValue = FixedPoint<std::int32_t, correction_frac_bits>;
+using PwmLevel = FixedPoint<std::uint32_t, dither_bits>;
+constexpr PwmLevel max_pwm_level{std::uint32_t{0xffff} << dither_bits};
+
+struct OutputPath {
+    FixedPolynomial<order> polynomial;
+    PiecewiseLinear<8> table;
+    PwmCountsPerUnit conversion;
+
+    PwmLevel operator()(float value) const {
+        CorrectedValue corrected = table(polynomial(to_correction_fixed(value)));
+        return std::min(saturate_cast<PwmLevel>(corrected * conversion), max_pwm_level);
+    }
+};
+
+double horner(std::array<double, order> const& c, double x) {
+    double v = c.back();
+    for (auto i = order - 1; i > 0; --i) {
+        v = v * x + c[i - 1];
+    }
+    return v;
+}
+
+bool near(double value, double expected, double tolerance) {
+    if (std::abs(value - expected) > tolerance) {
+        std::fprintf(stderr, "  got %.7f expected %.7f\n", value, expected);
+        return false;
+    }
+    return true;
+}
+
+void polynomial() {
+    // a calibration of the 0-30 V output: offset, gain and a slight bow
+    std::array<float, order> calibration{-.031f, 1.0213f, 4.1e-4f, -6.3e-6f};
+    FixedPolynomial<order> p;
+    p.set(calibration);
+    std::array<double, order> reference{};
+    std::copy(calibration.begin(), calibration.end(), reference.begin());
+    double worst = 0;
+    for (double x = 0; x <= 30; x += .001) {
+        worst = std::max(worst, std::abs(p(to_correction_fixed(x)) / one - horner(reference, to_correction_fixed(x) / one)));
+    }
+    // the coefficients are rounded to 2^-24, which dominates: the cubic term alone is off by up to 2^-25 * 30^3
+    sim::check(near(worst, 0, 1e-3), "a calibration curve within a millivolt");
+
+    // random curves with the output in range
+    std::mt19937 rng{34};
+    std::uniform_real_distribution<double> coefficient{-1, 1};
+    std::uniform_real_distribution<double> input{-8, 8};
+    for (auto n = 0; n < 2000; ++n) {
+        std::array<float, order> c;
+        for (auto i = 0U; i < order; ++i) {
+            c[i] = static_cast<float>(coefficient(rng) / (1 << (2 * i)));
+        }
+        p.set(c);
+        std::copy(c.begin(), c.end(), reference.begin());
+        auto x = to_correction_fixed(static_cast<float>(input(rng)));
+        if (not sim::check(near(p(x) / one, horner(reference, x / one), 8 / one), "random polynomials")) {
+            break;
+        }
+    }
+
+    std::array<float, 2> linear{2, -3};
+    p.set(linear);
+    sim::check(p(to_correction_fixed(1.5f)) == to_correction_fixed(-2.5f), "missing coefficients are zero");
+
+    // far out of range the result saturates instead of wrapping
+    std::array<float, order> steep{0, 100, 100, 100};
+    p.set(steep);
+    sim::check(p(to_correction_fixed(1000)) == std::numeric_limits<std::int32_t>::max(), "saturates high");
+    sim::check(p(to_correction_fixed(-1000)) == std::numeric_limits<std::int32_t>::min(), "saturates low");
+    std::array<float, order> huge{1e6f, 0, 0, 0};
+    p.set(huge);
+    sim::check(p.coefficients[0] == std::numeric_limits<std::int32_t>::max(), "coefficients saturate");
+}
+
+void table() {
+    PiecewiseLinear<8> t;
+    std::array<float, 3> x{0, 10, 20};
+    std::array<float, 3> y{.1f, 10, 21};
+    t.set(x, y, 1);
+    sim::check(t(to_correction_fixed(7)) == to_correction_fixed(7), "less than two points is the identity");
+
+    t.set(x, y, 3);
+    sim::check(t.count == 3, "all points taken");
+    for (auto i = 0U; i < 3; ++i) {
+        sim::check(t(to_correction_fixed(x[i])) == to_correction_fixed(y[i]), "passes through the points");
+    }
+    sim::check(near(t(to_correction_fixed(5)) / one, 5.05, 2 / one), "interpolates");
+    sim::check(near(t(to_correction_fixed(15)) / one, 15.5, 2 / one), "interpolates the second segment");
+    sim::check(near(t(to_correction_fixed(-2)) / one, .1 - 2 * .99, 2 / one), "extrapolates with the first segment");
+    sim::check(near(t(to_correction_fixed(25)) / one, 21 + 5 * 1.1, 2 / one), "extrapolates with the last segment");
+
+    std::array<float, 4> unsorted_x{0, 10, 5, 20};
+    std::array<float, 4> unsorted_y{0, 10, 5, 20};
+    t.set(unsorted_x, unsorted_y, 4);
+    sim::check(t.count == 2, "stops at the first point out of order");
+}
+
+void output_path() {
+    // vout at 20 kHz off a 125 MHz clock: 6250 counts at full scale, 26 V per full scale
+    OutputPath path;
+    std::array<float, order> calibration{.012f, .998f, 0, 0};
+    path.polynomial.set(calibration);
+    float conversion = 6250.f / 26;
+    path.conversion = PwmCountsPerUnit::from_float(conversion);
+    double worst = 0;
+    for (float v = 0; v <= 26; v += .01f) {
+        double expected = std::max((.012 + .998 * v) * conversion, 0.) * (1 << dither_bits);
+        worst = std::max(worst, std::abs(path(v).val - expected));
+    }
+    // the input, the horner steps and the scaling to pwm counts truncate, together less than two dither steps (.13 mV)
+    sim::check(worst < 2, "the pwm level within two dither steps of double precision");
+    sim::check(path(-5).val == 0, "negative levels are clamped to zero");
+    path.conversion = PwmCountsPerUnit::from_float(1e4f);
+    sim::check(path(100) == max_pwm_level, "levels are limited to the counter range");
+}
+
+void bench() {
+    std::array<float, order> c{-.031f, 1.0213f, 4.1e-4f, -6.3e-6f};
+    OutputPath path;
+    path.polynomial.set(c);
+    path.conversion = PwmCountsPerUnit::from_float(6250.f / 26);
+    float conversion = 6250.f / 26;
+    std::vector<float> inputs(1024);
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        inputs[i] = i * 30.f / inputs.size();
+    }
+    auto float_ns = sim::measure_ns(1'000'000, [&](std::size_t i) {
+        float x = inputs[i % inputs.size()];
+        float v = c.back();
+        for (auto k = order - 1; k > 0; --k) {
+            v = v * x + c[k - 1];
+        }
+        sim::keep(std::max(v * conversion, 0.f));
+    });
+    auto fixed_ns = sim::measure_ns(1'000'000, [&](std::size_t i) {
+        sim::keep(path(inputs[i % inputs.size()]).val);
+    });
+    std::printf("%-28s %6.2f ns/eval\n", "float horner", float_ns);
+    std::printf("%-28s %6.2f ns/eval\n", "fixed point output path", fixed_ns);
+}
+
+}
+
+int main(int argc, char** argv) {
+    polynomial();
+    table();
+    output_path();
+    if (sim::bench_requested(argc, argv)) {
+        bench();
+    }
+    return sim::result("correction");
+}
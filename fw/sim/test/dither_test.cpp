@@ -0,0 +1,73 @@
+#include "check.h"
+
+#include "util/Dither.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+/*
+ * the sigma delta sequences the dithered pwm feeds into the compare registers
+ */
+
+namespace {
+
+void sequences() {
+    for (std::uint8_t bits = 0; bits <= 6; ++bits) {
+        std::size_t len = std::size_t{1} << bits;
+        std::vector<std::uint16_t> seq(len);
+        for (std::uint32_t level = 0; level < (std::uint32_t{300} << bits); level += 7) {
+            sigma_delta_sequence(level, bits, seq);
+            std::uint32_t sum = 0;
+            for (auto v : seq) {
+                sum += v;
+            }
+            if (not sim::check(sum == level, "the sequence averages to the level exactly")) {
+                std::fprintf(stderr, "  bits %u level %u sum %u\n", bits, level, sum);
+                return;
+            }
+            // first order: every window of k periods holds the level times k, rounded down or up
+            for (std::size_t k = 1; k <= len; ++k) {
+                for (std::size_t start = 0; start + k <= len; ++start) {
+                    std::uint32_t window = 0;
+                    for (auto i = start; i < start + k; ++i) {
+                        window += seq[i];
+                    }
+                    std::uint64_t exact = std::uint64_t{level} * k;
+                    std::uint64_t lo = exact >> bits;
+                    std::uint64_t hi = (exact + len - 1) >> bits;
+                    if (not sim::check(window >= lo and window <= hi, "the +1 periods are spread evenly")) {
+                        std::fprintf(stderr, "  bits %u level %u window %zu at %zu\n", bits, level, k, start);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void limits() {
+    std::array<std::uint16_t, 64> seq{};
+    sigma_delta_sequence(0, 6, seq);
+    sim::check(std::all_of(seq.begin(), seq.end(), [](auto v) { return v == 0; }), "zero stays zero");
+
+    // the top level and anything above saturates at the 16 bit compare range
+    sigma_delta_sequence((std::uint32_t{0xffff} << 6) + 63, 6, seq);
+    sim::check(std::all_of(seq.begin(), seq.end(), [](auto v) { return v == 0xffff; }), "saturates at 0xffff");
+
+    // a single fractional count shows up in exactly one period
+    sigma_delta_sequence((std::uint32_t{1000} << 6) + 1, 6, seq);
+    sim::check(std::count(seq.begin(), seq.end(), 1001) == 1 and std::count(seq.begin(), seq.end(), 1000) == 63, "one lsb of dither");
+
+    std::array<std::uint16_t, 1> single{};
+    sigma_delta_sequence(1234, 0, single);
+    sim::check(single[0] == 1234, "no dither bits pass the level");
+}
+
+}
+
+int main() {
+    sequences();
+    limits();
+    return sim::result("dither");
+}
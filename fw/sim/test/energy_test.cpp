@@ -0,0 +1,101 @@
+#include "check.h"
+
+#include "energy.h"
+
+#include <cmath>
+#include <numbers>
+
+/*
+ * the charge and energy integration against synthetic waveforms with known integrals
+ */
+
+namespace {
+
+constexpr double pi = std::numbers::pi;
+
+// samples u(t) and i(t) every period_us for duration_s, starting at the timestamp start_us
+template<typename U, typename I>
+EnergyIntegrator integrate(U&& u, I&& i, double duration_s, std::uint32_t period_us, std::uint32_t start_us = 0) {
+    EnergyIntegrator e;
+    std::uint64_t samples = duration_s * 1e6 / period_us;
+    for (std::uint64_t n = 0; n <= samples; ++n) {
+        double t = n * period_us * 1e-6;
+        e.push(static_cast<std::uint32_t>(start_us + n * period_us),
+            millivolts{static_cast<std::int32_t>(std::lround(u(t) * 1e3))},
+            milliamps{static_cast<std::int32_t>(std::lround(i(t) * 1e3))});
+    }
+    return e;
+}
+
+bool near(double value, double expected, double tolerance) {
+    if (std::abs(value - expected) > tolerance) {
+        std::fprintf(stderr, "  got %.9f expected %.9f\n", value, expected);
+        return false;
+    }
+    return true;
+}
+
+void waveforms() {
+    // one hour of a constant load at the rate of a full adc schedule, across a wrap of the us timestamps
+    auto dc = integrate([](double) { return 12.; }, [](double) { return 1.5; }, 3600, 4651, 0xffffffff - 10'000'000);
+    double hours = dc.elapsed_us / 3600e6;
+    sim::check(near(hours, 1, 5e-6), "the elapsed time spans the wrap");
+    sim::check(near(dc.amp_hours(), 1.5 * hours, 1e-9), "charge of a constant load");
+    sim::check(near(dc.watt_hours(), 18 * hours, 1e-9), "energy of a constant load");
+    sim::check(near(dc.average_watts(), 18, 1e-9) and near(dc.peak_watts(), 18, 1e-9), "power of a constant load");
+
+    // a discharge with the voltage sagging linearly, the trapezoidal rule is exact for the charge
+    auto ramp = integrate([](double t) { return 4.2 - t / 3600 * 1.2; }, [](double t) { return 2 - t / 3600; }, 3600, 1000);
+    sim::check(near(ramp.amp_hours(), 1.5, 1e-6), "charge of a linear ramp");
+    // integral of (4.2 - 1.2 x)(2 - x) dx over [0, 1] = 8.4 - 4.2/2 - 2.4/2 + 1.2/3
+    sim::check(near(ramp.watt_hours(), 8.4 - 2.1 - 1.2 + .4, 1e-6), "energy of a linear ramp");
+    sim::check(near(ramp.peak_watts(), 8.4, 1e-9), "the peak is at the start");
+
+    // 50 Hz ripple on a dc current: full cycles cancel, the energy of u * i follows the dc part plus the cross term
+    auto ripple = integrate([](double) { return 5.; }, [](double t) { return 1 + .5 * std::sin(2 * pi * 50 * t); }, 60, 200);
+    sim::check(near(ripple.amp_hours(), 60. / 3600, 1e-6), "ripple cancels over full cycles");
+    sim::check(near(ripple.average_watts(), 5, 1e-3), "average power with ripple");
+    sim::check(near(ripple.peak_watts(), 7.5, 1e-3), "peak power with ripple");
+
+    // a sinusoidal voltage and current in phase deliver u * i / 2
+    auto ac = integrate([](double t) { return 10 * std::sin(2 * pi * 5 * t); }, [](double t) { return 2 * std::sin(2 * pi * 5 * t); }, 10, 500);
+    sim::check(near(ac.amp_hours(), 0, 1e-6), "ac charge");
+    sim::check(near(ac.average_watts(), 10, 1e-3), "ac power");
+
+    // a current sink makes charge and energy negative
+    auto sink = integrate([](double) { return 5.; }, [](double) { return -1.; }, 36, 1000);
+    sim::check(near(sink.amp_hours(), -.01, 1e-9) and near(sink.watt_hours(), -.05, 1e-9), "negative currents");
+}
+
+void gaps_and_limits() {
+    EnergyIntegrator e;
+    e.push(0, millivolts{1000}, milliamps{1000});
+    e.push(1000, millivolts{1000}, milliamps{1000});
+    e.push(1000 + EnergyIntegrator::max_gap_us + 1, millivolts{1000}, milliamps{1000});
+    e.push(2000 + EnergyIntegrator::max_gap_us + 1, millivolts{1000}, milliamps{1000});
+    sim::check(e.elapsed_us == 2000 and e.energy_mW_us == 2'000'000, "gaps are skipped, not integrated over");
+
+    e.reset();
+    sim::check(e.elapsed_us == 0 and e.charge_mA_us == 0 and e.energy_mW_us == 0, "reset clears the integrators");
+
+    // the accumulators saturate instead of wrapping
+    e.energy_mW_us = std::numeric_limits<std::int64_t>::max() - 10;
+    e.charge_mA_us = std::numeric_limits<std::int64_t>::min() + 10;
+    e.push(0, millivolts{-30'000}, milliamps{-10'000});
+    e.push(1000, millivolts{-30'000}, milliamps{-10'000});
+    sim::check(e.energy_mW_us == std::numeric_limits<std::int64_t>::max(), "the energy saturates");
+    sim::check(e.charge_mA_us == std::numeric_limits<std::int64_t>::min(), "the charge saturates");
+
+    // power saturates at the milliwatt range rather than wrapping
+    e.reset();
+    e.push(0, millivolts{2'000'000'000}, milliamps{2'000'000});
+    sim::check(e.peak_mW == std::numeric_limits<std::int32_t>::max(), "the power saturates");
+}
+
+}
+
+int main() {
+    waveforms();
+    gaps_and_limits();
+    return sim::result("energy");
+}
@@ -0,0 +1,204 @@
+#include "check.h"
+
+#include "util/Filters.h"
+
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+/*
+ * the filter kernels of the analog readings against floating point references
+ * filters_test --bench reports the cost per sample of each kernel
+ */
+
+namespace {
+
+constexpr double one = 1 << filter_frac_bits;
+
+void moving_average() {
+    MovingAverageFilter<64> f;
+    f.reset(8);
+    // averages over what was pushed so far until the window is filled
+    sim::check(*f.push(100) == 100 * one, "the first sample passes");
+    sim::check(*f.push(200) == 150 * one, "the average of a partial window");
+    for (auto i = 0; i < 8; ++i) {
+        f.push(-40);
+    }
+    sim::check(*f.push(-40) == -40 * one, "a filled window only holds the last samples");
+
+    std::mt19937 rng{1};
+    std::uniform_int_distribution<int> dist{-32768, 32767};
+    for (std::size_t len : {1, 5, 64}) {
+        f.reset(len);
+        std::vector<int> history;
+        for (auto i = 0; i < 1000; ++i) {
+            history.push_back(dist(rng));
+            auto out = *f.push(history.back());
+            auto n = std::min(history.size(), len);
+            double sum = 0;
+            for (auto j = history.size() - n; j < history.size(); ++j) {
+                sum += history[j];
+            }
+            if (not sim::check(std::abs(out - sum * one / n) < 1, "the window average of random samples")) {
+                return;
+            }
+        }
+    }
+    f.reset(1000);
+    sim::check(f.len == 64, "the window is limited to max_len");
+}
+
+void ema() {
+    for (std::uint8_t shift = 0; shift <= EmaFilter::max_shift; ++shift) {
+        EmaFilter f;
+        f.reset(shift);
+        sim::check(*f.push(-1000) == -1000 * one, "the first sample primes the state");
+        // small and large steps in both directions have to settle on the input exactly
+        for (int target : {-999, -1000, 0, 1, 0, 32767, -32768}) {
+            std::int32_t out{};
+            for (auto i = 0; i < (40 << shift) + 40; ++i) {
+                out = *f.push(target);
+            }
+            if (not sim::check(out == target * one, "settles on the input exactly")) {
+                std::fprintf(stderr, "  shift %d target %d got %f\n", shift, target, out / one);
+                return;
+            }
+        }
+    }
+
+    // the step response follows 1 - (1 - 2^-shift)^n
+    for (std::uint8_t shift : {1, 4, 10, 15}) {
+        EmaFilter f;
+        f.reset(shift);
+        f.push(0);
+        double alpha = std::ldexp(1., -shift);
+        for (auto n = 1; n <= (8 << shift); ++n) {
+            double expected = 10000 * (1 - std::pow(1 - alpha, n));
+            auto out = *f.push(10000) / one;
+            if (not sim::check(std::abs(out - expected) <= 1. / one, "the step response of a first order low pass")) {
+                std::fprintf(stderr, "  shift %d step %d got %f expected %f\n", shift, n, out, expected);
+                break;
+            }
+        }
+    }
+
+    // an input dithering around a fractional mean must not drag the output down
+    for (std::uint8_t shift : {0, 4, 8, 12, 15}) {
+        EmaFilter f;
+        f.reset(shift);
+        constexpr std::array<std::int16_t, 4> pattern{-101, -100, -100, -100};
+        double sum = 0;
+        std::size_t n = 0;
+        for (auto i = 0; i < (30 << shift) + 4096; ++i) {
+            auto out = *f.push(pattern[i % pattern.size()]);
+            if (i >= (30 << shift)) {
+                sum += out / one;
+                ++n;
+            }
+        }
+        if (not sim::check(std::abs(sum / n + 100.25) < .01, "no bias on a dithering input")) {
+            std::fprintf(stderr, "  shift %d mean %f\n", shift, sum / n);
+        }
+    }
+
+    EmaFilter f;
+    f.reset(200);
+    sim::check(f.shift == EmaFilter::max_shift, "the shift is limited to max_shift");
+}
+
+void cic() {
+    for (std::uint32_t dec : {1, 2, 7, 32}) {
+        CicDecimator<3> f;
+        f.reset(dec);
+        std::vector<std::int32_t> outputs;
+        // a constant input comes out exactly once the combs are filled, on every dec-th sample
+        for (std::uint32_t i = 1; i <= 10 * dec; ++i) {
+            auto out = f.push(-12345);
+            sim::check(out.has_value() == (i % dec == 0), "emits every decimation-th sample");
+            if (out) {
+                outputs.push_back(*out);
+            }
+        }
+        sim::check(outputs.back() == -12345 * one, "a constant input passes with unity gain");
+    }
+
+    // the integrators wrap long before this, the combs undo it
+    CicDecimator<3> f;
+    f.reset(32);
+    std::int32_t out{};
+    for (auto i = 0; i < 2'000'000; ++i) {
+        if (auto v = f.push(32767)) {
+            out = *v;
+        }
+    }
+    sim::check(out == 32767 * one, "full scale input over wrapping integrators");
+
+    // the output is the third order moving average of the input, compare it to the direct convolution
+    f.reset(4);
+    std::mt19937 rng{3};
+    std::uniform_int_distribution<int> dist{-32768, 32767};
+    std::vector<double> in;
+    for (auto i = 0; i < 400; ++i) {
+        in.push_back(dist(rng));
+        if (auto v = f.push(in.back()); v and in.size() >= 12) {
+            // three cascaded boxcars of length 4 make a kernel of length 10
+            std::vector<double> box{in.end() - 12, in.end()};
+            for (auto stage = 0; stage < 3; ++stage) {
+                std::vector<double> next;
+                for (auto j = 3U; j < box.size(); ++j) {
+                    next.push_back((box[j] + box[j - 1] + box[j - 2] + box[j - 3]) / 4);
+                }
+                box = next;
+            }
+            if (not sim::check(std::abs(*v / one - box.back()) < 1. / one, "matches the cascaded boxcar")) {
+                break;
+            }
+        }
+    }
+}
+
+void sample_filter() {
+    SampleFilter<64> f;
+    sim::check(*f.push(7) == 7 * one, "no filter passes the sample scaled");
+    f.reset(SampleFilter<64>::Type::cic, 4);
+    sim::check(not f.push(7), "the cic decimates");
+    f.reset(static_cast<SampleFilter<64>::Type>(17), 4);
+    sim::check(f.type == SampleFilter<64>::Type::none and *f.push(7) == 7 * one, "unknown types disable the filter");
+}
+
+void bench() {
+    std::vector<std::int16_t> input(4096);
+    std::mt19937 rng{4};
+    for (auto& v : input) {
+        v = static_cast<std::int16_t>(rng());
+    }
+    auto run = [&](char const* name, SampleFilter<64>::Type type, std::uint8_t param) {
+        SampleFilter<64> f;
+        f.reset(type, param);
+        auto ns = sim::measure_ns(1'000'000, [&](std::size_t i) {
+            sim::keep(f.push(input[i % input.size()]));
+        });
+        std::printf("%-28s %6.2f ns/sample\n", name, ns);
+    };
+    run("none", SampleFilter<64>::Type::none, 0);
+    run("moving average, 16", SampleFilter<64>::Type::moving_average, 16);
+    run("moving average, 64", SampleFilter<64>::Type::moving_average, 64);
+    run("ema, shift 4", SampleFilter<64>::Type::ema, 4);
+    run("ema, shift 15", SampleFilter<64>::Type::ema, 15);
+    run("cic, decimation 8", SampleFilter<64>::Type::cic, 8);
+    run("cic, decimation 32", SampleFilter<64>::Type::cic, 32);
+}
+
+}
+
+int main(int argc, char** argv) {
+    moving_average();
+    ema();
+    cic();
+    sample_filter();
+    if (sim::bench_requested(argc, argv)) {
+        bench();
+    }
+    return sim::result("filters");
+}
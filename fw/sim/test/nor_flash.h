@@ -0,0 +1,94 @@
+#pragma once
+
+#include "check.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+#include <vector>
+
+/*
+ * a NOR flash for the Flash parameter of ConfigLog: an erase sets whole sectors to 0xff, a program can only clear bits
+ * and programming a byte that isn't erased violates a check
+ * a power loss is injected after a number of flash steps, a step being a byte programmed or a page erased, the byte or
+ * page it hits is left with random bits and everything after it is ignored until the flash is powered up again
+ */
+
+namespace sim {
+
+struct Nor {
+    static constexpr std::size_t page_size = 256;
+    static constexpr std::size_t sector_size = 4096;
+
+    explicit Nor(std::size_t size = 16 * 1024) : memory(size, 0xff) {}
+
+    std::vector<std::uint8_t> memory;
+    std::optional<std::size_t> power_loss_in; // steps until the power fails
+    bool powered{true};
+    std::size_t steps{};
+    std::size_t erases{};
+    std::size_t programs{};
+    std::mt19937 rng{47};
+
+    void power_up() {
+        powered = true;
+        power_loss_in.reset();
+    }
+
+    // false if the power failed before the step was done
+    bool step() {
+        if (power_loss_in and (*power_loss_in)-- == 0) {
+            powered = false;
+            return false;
+        }
+        ++steps;
+        return true;
+    }
+};
+
+// the flash of one boot, the contents live on in the Nor
+struct NorFlash {
+    static constexpr std::size_t page_size = Nor::page_size;
+    static constexpr std::size_t sector_size = Nor::sector_size;
+
+    Nor* nor;
+
+    std::span<const std::uint8_t> region() const {
+        return nor->memory;
+    }
+
+    void erase(std::size_t offset, std::size_t size) {
+        if (not check(offset % sector_size == 0 and size % sector_size == 0 and offset + size <= nor->memory.size(), "erases whole sectors")) {
+            return;
+        }
+        ++nor->erases;
+        for (auto page = offset; page < offset + size and nor->powered; page += page_size) {
+            auto bytes = std::span{nor->memory}.subspan(page, page_size);
+            if (not nor->step()) {
+                std::ranges::generate(bytes, [&] { return static_cast<std::uint8_t>(nor->rng()); });
+                return;
+            }
+            std::ranges::fill(bytes, 0xff);
+        }
+    }
+
+    void program(std::size_t offset, std::span<const std::uint8_t> page) {
+        if (not check(offset % page_size == 0 and page.size() == page_size and offset + page_size <= nor->memory.size(), "programs whole pages")) {
+            return;
+        }
+        ++nor->programs;
+        for (std::size_t i = 0; i < page.size() and nor->powered; ++i) {
+            auto& byte = nor->memory[offset + i];
+            check(page[i] == 0xff or byte == 0xff, "programs only erased bytes");
+            if (not nor->step()) {
+                byte &= page[i] | static_cast<std::uint8_t>(nor->rng());
+                return;
+            }
+            byte &= page[i];
+        }
+    }
+};
+
+}
@@ -0,0 +1,219 @@
+#include "check.h"
+
+#include "protection.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * the trip latency of the protection in the sampling path, on a model of the adc round robin in analog_readings.cpp
+ * every schedule entry triggers a single shot conversion over i2c, waits for it and reads the result, the check runs
+ * right after the read and a trip cuts the pwm of the channel, which is off once the compare registers latch at the wrap
+ * a conversion reports the average of its input over the conversion time, the ads1115's filter settles within one
+ * conversion
+ * protection_test --bench prints the latency distribution for the data rates and a few schedules
+ */
+
+namespace {
+
+// i2c at 100 kHz: start, address and three bytes with acks, stop
+constexpr double trigger_us = 38 * 10.;
+// pointer write, repeated start, address and two bytes, stop
+constexpr double read_us = 48 * 10.;
+// resuming the sampling coroutine from the main loop and the interrupt of the ready pin, per transfer
+constexpr double overhead_us = 50.;
+// the adc wakes up from power down before a single shot conversion
+constexpr double wakeup_us = 25.;
+
+// force_off aborts the dither dma of the slice and writes its compare registers, they latch at the next wrap
+constexpr double cut_us = 5.;
+constexpr double pwm_period_us = 1e6 / 20'000;
+
+constexpr std::array<std::uint16_t, 8> data_rates {8, 16, 32, 64, 128, 250, 475, 860};
+
+// the current sense of output 0 with the default pga, 2 A/V behind 6.144 V full scale
+constexpr std::size_t current_channel = 1;
+constexpr float current_scale = 6.144f / ((1 << 15) - 1) * 2;
+
+double conversion_us(std::uint16_t rate) {
+    return 1e6 / rate + wakeup_us;
+}
+
+// from the check at check_us to the pwm being off, the pwm wraps at multiples of its period
+double actuation_us(double check_us) {
+    return std::ceil((check_us + cut_us) / pwm_period_us) * pwm_period_us - check_us;
+}
+
+// a current stepping from before to after at fault_us
+struct Fault {
+    double fault_us;
+    double before, after;
+
+    // the average over [from, to]
+    double average(double from, double to) const {
+        if (fault_us <= from) {
+            return after;
+        }
+        if (fault_us >= to) {
+            return before;
+        }
+        return (before * (fault_us - from) + after * (to - fault_us)) / (to - from);
+    }
+};
+
+std::int16_t to_raw(double value, float scale) {
+    return static_cast<std::int16_t>(std::clamp(std::lround(value / scale), -32768L, 32767L));
+}
+
+// runs the schedule until the current channel trips, returns the time from the fault to the pwm being off, or a
+// negative value
+double trip_latency(std::vector<std::uint8_t> const& schedule, std::uint16_t rate, Fault const& fault, double limit) {
+    protection::RawLimit raw_limit;
+    raw_limit.set(static_cast<float>(limit));
+    double t = 0;
+    double horizon = fault.fault_us + 4 * schedule.size() * (conversion_us(rate) + trigger_us + read_us + 2 * overhead_us);
+    while (t < horizon) {
+        for (auto channel : schedule) {
+            t += overhead_us + trigger_us;
+            double start = t;
+            t += conversion_us(rate) + overhead_us + read_us;
+            if (channel != current_channel) {
+                continue;
+            }
+            auto raw = to_raw(fault.average(start, start + conversion_us(rate)), current_scale);
+            if (raw_limit.exceeded(raw, current_scale)) {
+                return t + actuation_us(t) - fault.fault_us;
+            }
+        }
+    }
+    return -1;
+}
+
+// the longest time between the starts of two conversions of the current channel, around the end of the schedule
+double worst_gap_us(std::vector<std::uint8_t> const& schedule, std::uint16_t rate) {
+    double slot = overhead_us + trigger_us + conversion_us(rate) + overhead_us + read_us;
+    std::vector<double> starts;
+    for (auto round = 0; round < 2; ++round) {
+        for (std::size_t i = 0; i < schedule.size(); ++i) {
+            if (schedule[i] == current_channel) {
+                starts.push_back((round * schedule.size() + i) * slot);
+            }
+        }
+    }
+    double gap = 0;
+    for (std::size_t i = 1; i < starts.size(); ++i) {
+        gap = std::max(gap, starts[i] - starts[i - 1]);
+    }
+    return gap;
+}
+
+struct Stats {
+    double min{std::numeric_limits<double>::max()}, mean{}, p99{}, max{};
+    std::size_t missed{};
+};
+
+Stats latencies(std::vector<std::uint8_t> const& schedule, std::uint16_t rate, double before, double after) {
+    std::mt19937 rng{31};
+    double round_us = schedule.size() * (2 * overhead_us + trigger_us + conversion_us(rate) + read_us);
+    // the fault hits at any phase of the schedule, after a few rounds of normal operation
+    std::uniform_real_distribution<double> when{3 * round_us, 5 * round_us};
+    std::vector<double> samples;
+    Stats s;
+    for (auto n = 0; n < 5000; ++n) {
+        auto latency = trip_latency(schedule, rate, {when(rng), before, after}, 2.);
+        if (latency < 0) {
+            ++s.missed;
+            continue;
+        }
+        samples.push_back(latency);
+    }
+    if (samples.empty()) {
+        return s;
+    }
+    std::sort(samples.begin(), samples.end());
+    s.min = samples.front();
+    s.max = samples.back();
+    s.p99 = samples[samples.size() * 99 / 100];
+    for (auto v : samples) {
+        s.mean += v / samples.size();
+    }
+    return s;
+}
+
+std::vector<std::vector<std::uint8_t>> const schedules {
+    {0, 1, 2, 3},
+    {1, 0, 1, 2, 1, 3},
+    {1, 3},
+};
+
+void raw_limits() {
+    protection::RawLimit l;
+    sim::check(not l.exceeded(32767, current_scale), "an unset limit never trips");
+    l.set(2);
+    sim::check(not l.exceeded(to_raw(1.999, current_scale), current_scale), "no trip just below the limit");
+    sim::check(l.exceeded(to_raw(2.001, current_scale), current_scale), "trips just above the limit");
+    // a pga change rescales the threshold
+    sim::check(not l.exceeded(to_raw(2.001, current_scale), current_scale / 2), "the threshold follows the scale");
+    l.set(0);
+    sim::check(not l.exceeded(32767, current_scale), "a limit of zero disables the check");
+}
+
+void latency_bounds() {
+    for (auto const& schedule : schedules)
+    for (auto rate : data_rates) {
+        // a hard short trips on the conversion during which it starts, or on the next one
+        auto s = latencies(schedule, rate, 1, 3);
+        double bound = worst_gap_us(schedule, rate) + conversion_us(rate) + overhead_us + read_us + cut_us + pwm_period_us;
+        sim::check(s.missed == 0, "every fault trips");
+        if (not sim::check(s.max <= bound + 1e-6, "the latency is bounded by the time between two checks of the channel and a pwm period")) {
+            std::fprintf(stderr, "  rate %u: %.0f us exceeds %.0f us\n", rate, s.max, bound);
+        }
+        sim::check(s.min >= overhead_us + read_us + cut_us, "the result has to be read before it is checked and the pwm cut");
+    }
+
+    // the cut doesn't wait for the end of a dither sequence, 64 periods or 3.2 ms at 20 kHz
+    bool within_period = true;
+    for (double t = 0; t < 10 * pwm_period_us; t += 0.25) {
+        within_period &= actuation_us(t) >= cut_us and actuation_us(t) <= cut_us + pwm_period_us;
+    }
+    sim::check(within_period, "the pwm is off within a period of the trip");
+
+    // sampling the current more often cuts the worst case
+    auto round_robin = latencies(schedules[0], 860, 1, 3);
+    auto current_first = latencies(schedules[1], 860, 1, 3);
+    sim::check(current_first.max < round_robin.max * .75, "a schedule favouring the current trips faster");
+    // at the highest data rate a short trips within a round of the default schedule
+    sim::check(round_robin.max < 10'000, "the default schedule trips within 10 ms");
+
+    // a fault just above the limit only shows once it covers nearly a whole conversion
+    auto marginal = latencies(schedules[0], 860, 1, 2.05);
+    sim::check(marginal.missed == 0 and marginal.min >= conversion_us(860), "a marginal fault trips on a full conversion");
+}
+
+void bench() {
+    std::printf("%-20s %5s %9s %9s %9s %9s\n", "schedule", "sps", "min us", "mean us", "p99 us", "max us");
+    for (auto const& schedule : schedules)
+    for (auto rate : data_rates) {
+        auto s = latencies(schedule, rate, 1, 3);
+        std::string name;
+        for (auto c : schedule) {
+            name += std::to_string(c) + " ";
+        }
+        std::printf("%-20s %5u %9.0f %9.0f %9.0f %9.0f\n", name.c_str(), rate, s.min, s.mean, s.p99, s.max);
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    raw_limits();
+    latency_bounds();
+    if (sim::bench_requested(argc, argv)) {
+        bench();
+    }
+    return sim::result("protection");
+}
@@ -0,0 +1,344 @@
+#include "check.h"
+
+#include "cranc/config/ApplicationConfig.h"
+#include "cranc/config/ConfigRegistry.h"
+#include "misc/ConfigProtocol.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * the batched get and set of the config protocol over a loopback stand-in for the bulk endpoints: requests go out in
+ * 64 byte packets through the PacketReceiver of the usb transports, responses come back framed with their size, the
+ * host side batches like Device.get_configs and Device.set_configs in python/device.py
+ * protocol_test --bench compares the transfers and engine time of single and batched gets
+ */
+
+namespace {
+
+using config_protocol::Engine;
+
+cranc::ApplicationConfig<void> trigger {"proto.trigger"};
+cranc::ApplicationConfig<std::uint8_t> byte_cfg {"proto.byte", "B", 0};
+cranc::ApplicationConfig<float> float_cfg {"proto.float", "f", 0.f};
+cranc::ApplicationConfig<std::array<std::uint8_t, 100>> medium_cfg {"proto.medium", "100B"};
+std::deque<std::string> extra_names;
+std::deque<cranc::ApplicationConfig<std::uint32_t>> extra_configs;
+
+using Bytes = std::vector<std::uint8_t>;
+
+template<typename T>
+void put(Bytes& out, T v) {
+    auto pos = out.size();
+    out.resize(pos + sizeof(v));
+    std::memcpy(out.data() + pos, &v, sizeof(v));
+}
+
+template<typename T>
+T get(Bytes const& in, std::size_t pos) {
+    T v;
+    std::memcpy(&v, in.data() + pos, sizeof(v));
+    return v;
+}
+
+struct Loopback {
+    Engine engine;
+    config_protocol::PacketReceiver receiver{engine, 64};
+    std::size_t transfers{};
+    std::size_t packets{};
+    std::size_t rejections{};
+
+    // sends one transfer in packets of up to 64 bytes, ended by a short or zero length packet like a usb host does
+    // returns the responses one after the other, rejected requests only show up in the count
+    std::vector<Bytes> xfer(Bytes const& request) {
+        ++transfers;
+        std::vector<Bytes> responses;
+        for (std::size_t pos = 0; pos <= request.size(); pos += 64) {
+            std::span<const std::uint8_t> packet{request.data() + pos, std::min<std::size_t>(64, request.size() - pos)};
+            if (packet.empty() and pos != 0 and request.size() % 64 != 0) {
+                break;
+            }
+            ++packets;
+            receiver.received(packet);
+            for (auto framed = receiver.next(); not framed.empty(); framed = receiver.next()) {
+                auto size = get<std::uint16_t>(Bytes{framed.begin(), framed.end()}, 0);
+                if (size == config_protocol::rejected) {
+                    sim::check(framed.size() == sizeof(size), "a rejection has no payload");
+                    ++rejections;
+                    continue;
+                }
+                sim::check(framed.size() == sizeof(size) + size, "the response is framed with its size");
+                responses.emplace_back(framed.begin() + sizeof(size), framed.end());
+            }
+        }
+        return responses;
+    }
+
+    Bytes call(Bytes const& request) {
+        auto responses = xfer(request);
+        sim::check(responses.size() == 1, "one response per request");
+        return responses.empty() ? Bytes{} : responses.front();
+    }
+
+    Bytes get_one(std::uint16_t index) {
+        Bytes request;
+        put<std::uint8_t>(request, config_protocol::op_get);
+        put(request, index);
+        return call(request);
+    }
+
+    // Device.get_configs: batches of up to 255 indices, the response says how many values fit
+    std::vector<Bytes> get_configs(std::vector<std::uint16_t> const& indices) {
+        std::vector<Bytes> values;
+        while (values.size() < indices.size()) {
+            auto n = std::min<std::size_t>(indices.size() - values.size(), (config_protocol::max_payload - 2) / 2);
+            Bytes request;
+            put<std::uint8_t>(request, config_protocol::op_get_many);
+            put<std::uint16_t>(request, 0);
+            put<std::uint16_t>(request, n);
+            for (std::size_t i = 0; i < n; ++i) {
+                put(request, indices[values.size() + i]);
+            }
+            auto rx = call(request);
+            auto count = get<std::uint16_t>(rx, 0);
+            if (not sim::check(count > 0 and count <= n, "every batch makes progress")) {
+                return values;
+            }
+            std::size_t pos = sizeof(count);
+            for (auto i = 0; i < count; ++i) {
+                auto size = cranc::configAt(indices[values.size()])->getSize();
+                values.emplace_back(rx.begin() + pos, rx.begin() + pos + size);
+                pos += size;
+            }
+            sim::check(pos == rx.size(), "the values fill the response");
+        }
+        return values;
+    }
+
+    // Device.set_configs: as many values as fit into a payload per request
+    void set_configs(std::vector<std::pair<std::uint16_t, Bytes>> const& values) {
+        std::size_t done = 0;
+        while (done < values.size()) {
+            Bytes payload;
+            std::uint16_t count = 0;
+            for (auto i = done; i < values.size(); ++i) {
+                auto const& [index, value] = values[i];
+                if (2 + payload.size() + 2 + value.size() > config_protocol::max_payload) {
+                    break;
+                }
+                put(payload, index);
+                payload.insert(payload.end(), value.begin(), value.end());
+                ++count;
+            }
+            Bytes request;
+            put<std::uint8_t>(request, config_protocol::op_set_many);
+            put<std::uint16_t>(request, 0);
+            put(request, count);
+            request.insert(request.end(), payload.begin(), payload.end());
+            auto set = get<std::uint16_t>(call(request), 0);
+            if (not sim::check(set == count, "all values of a batch are set")) {
+                return;
+            }
+            done += set;
+        }
+    }
+};
+
+std::uint16_t index_of(cranc::ApplicationConfigBase const& config) {
+    for (std::size_t i = 0; i < cranc::configCount(); ++i) {
+        if (cranc::configAt(i) == &config) {
+            return i;
+        }
+    }
+    return 0xffff;
+}
+
+std::vector<std::uint16_t> all_indices() {
+    std::vector<std::uint16_t> indices(cranc::configCount());
+    for (std::size_t i = 0; i < indices.size(); ++i) {
+        indices[i] = i;
+    }
+    return indices;
+}
+
+void get_many() {
+    Loopback loop;
+    auto indices = all_indices();
+    // the configs in reverse, so the batch isn't just the list order
+    std::reverse(indices.begin(), indices.end());
+    auto values = loop.get_configs(indices);
+    bool same = values.size() == indices.size();
+    for (std::size_t i = 0; same and i < indices.size(); ++i) {
+        same = values[i] == loop.get_one(indices[i]);
+    }
+    sim::check(same, "get_many returns what single gets do");
+
+    // 600 bytes of medium values don't fit into 512, the host continues where the response stopped
+    std::vector<std::uint16_t> mediums(6, index_of(medium_cfg));
+    loop.transfers = 0;
+    values = loop.get_configs(mediums);
+    sim::check(values.size() == 6 and loop.transfers == 2, "values that don't fit spill into the next request");
+
+    Bytes request;
+    put<std::uint8_t>(request, config_protocol::op_get_many);
+    put<std::uint16_t>(request, 0);
+    put<std::uint16_t>(request, 3);
+    put(request, index_of(float_cfg));
+    put<std::uint16_t>(request, 0xfff0);
+    put(request, index_of(byte_cfg));
+    auto rx = loop.call(request);
+    sim::check(get<std::uint16_t>(rx, 0) == 1 and rx.size() == 2 + sizeof(float), "stops at an unknown config");
+}
+
+void set_many() {
+    Loopback loop;
+    std::mt19937 rng{39};
+    std::vector<std::pair<std::uint16_t, Bytes>> values;
+    for (auto index : all_indices()) {
+        Bytes value(cranc::configAt(index)->getSize());
+        for (auto& b : value) {
+            b = rng();
+        }
+        values.emplace_back(index, value);
+    }
+    loop.set_configs(values);
+    bool same = true;
+    for (auto const& [index, value] : values) {
+        same = same and loop.get_one(index) == value;
+    }
+    sim::check(same, "set_many sets every value");
+
+    Bytes request;
+    put<std::uint8_t>(request, config_protocol::op_set_many);
+    put<std::uint16_t>(request, 0);
+    put<std::uint16_t>(request, 2);
+    put(request, index_of(float_cfg));
+    put<float>(request, 1.f);
+    put<std::uint16_t>(request, 0xfff0);
+    sim::check(loop.xfer(request).empty() and loop.rejections == 1, "naming an unknown config is rejected");
+    sim::check(loop.get_one(index_of(float_cfg)).size() == sizeof(float), "and the engine resynchronizes");
+
+    // a batched get and set pipelined into one transfer, as a stream transport sends them
+    Bytes pipelined;
+    put<std::uint8_t>(pipelined, config_protocol::op_set_many);
+    put<std::uint16_t>(pipelined, 0);
+    put<std::uint16_t>(pipelined, 1);
+    put(pipelined, index_of(byte_cfg));
+    put<std::uint8_t>(pipelined, 42);
+    put<std::uint8_t>(pipelined, config_protocol::op_get_many);
+    put<std::uint16_t>(pipelined, 0);
+    put<std::uint16_t>(pipelined, 1);
+    put(pipelined, index_of(byte_cfg));
+    auto responses = loop.xfer(pipelined);
+    sim::check(responses.size() == 2 and responses[1] == Bytes{1, 0, 42}, "pipelined batches answer in order");
+}
+
+// requests pipelined past the request buffer, the engine has to execute some before it takes the rest of a packet
+void back_pressure() {
+    Loopback loop;
+    Bytes transfer;
+    std::vector<Bytes> expected;
+    std::mt19937 rng{45};
+    auto medium = index_of(medium_cfg);
+    for (auto n = 0; n < 40; ++n) {
+        if (rng() % 2) {
+            put<std::uint8_t>(transfer, config_protocol::op_get);
+            put(transfer, medium);
+            expected.push_back(loop.get_one(medium));
+            continue;
+        }
+        // a set of 4 medium values, 411 bytes, always straddles packets
+        put<std::uint8_t>(transfer, config_protocol::op_set_many);
+        put<std::uint16_t>(transfer, 0);
+        put<std::uint16_t>(transfer, 4);
+        for (auto i = 0; i < 4; ++i) {
+            put(transfer, medium);
+            for (auto j = 0; j < 100; ++j) {
+                put<std::uint8_t>(transfer, rng());
+            }
+        }
+        expected.push_back(Bytes{4, 0});
+    }
+    // the gets answer with the value of the last set before them
+    for (std::size_t n = 0, pos = 0; n < expected.size(); ++n) {
+        if (transfer[pos] == config_protocol::op_get) {
+            pos += 3;
+            continue;
+        }
+        Bytes last{transfer.begin() + pos + 5 + 3 * 102 + 2, transfer.begin() + pos + 5 + 4 * 102};
+        pos += 5 + 4 * 102;
+        for (auto m = n + 1; m < expected.size() and expected[m].size() == 100; ++m) {
+            expected[m] = last;
+        }
+    }
+    sim::check(transfer.size() > 4 * (config_protocol::header_size + config_protocol::max_payload), "several times the request buffer");
+    auto responses = loop.xfer(transfer);
+    sim::check(responses == expected and loop.rejections == 0, "every pipelined request is answered in order");
+}
+
+void rejections() {
+    Loopback loop;
+    Bytes unknown{0x42, 1, 2, 3};
+    sim::check(loop.xfer(unknown).empty() and loop.rejections == 1, "an unknown operation is rejected");
+    sim::check(loop.get_one(index_of(float_cfg)).size() == sizeof(float), "the next transfer is served");
+
+    // a set_many longer than the request buffer, spread over many packets: one rejection, the rest of it is dropped
+    Bytes oversized;
+    put<std::uint8_t>(oversized, config_protocol::op_set_many);
+    put<std::uint16_t>(oversized, 0);
+    put<std::uint16_t>(oversized, 6);
+    for (auto i = 0; i < 6; ++i) {
+        put(oversized, index_of(medium_cfg));
+        oversized.resize(oversized.size() + 100, config_protocol::op_count);
+    }
+    auto before = loop.get_one(index_of(medium_cfg));
+    sim::check(loop.xfer(oversized).empty() and loop.rejections == 2, "an oversized request is rejected once");
+    sim::check(loop.get_one(index_of(medium_cfg)) == before, "and none of it is applied");
+
+    // a rejected request in a transfer of whole packets, ended by a zero length packet
+    Bytes whole(128, 0x42);
+    sim::check(loop.xfer(whole).empty() and loop.rejections == 3, "rejected up to the zero length packet");
+    Bytes count{config_protocol::op_count};
+    sim::check(loop.xfer(count).size() == 1, "and served afterwards");
+}
+
+void bench() {
+    Loopback loop;
+    auto indices = all_indices();
+    loop.transfers = loop.packets = 0;
+    auto single_ns = sim::measure_ns(100, [&](std::size_t) {
+        for (auto i : indices) {
+            sim::keep(loop.get_one(i));
+        }
+    });
+    auto single_transfers = loop.transfers / (8 * 100);
+    loop.transfers = loop.packets = 0;
+    auto batched_ns = sim::measure_ns(100, [&](std::size_t) {
+        sim::keep(loop.get_configs(indices));
+    });
+    auto batched_transfers = loop.transfers / (8 * 100);
+    std::printf("%zu configs, single gets:  %4zu transfers %8.0f ns\n", indices.size(), single_transfers, single_ns);
+    std::printf("%zu configs, get_many:     %4zu transfers %8.0f ns\n", indices.size(), batched_transfers, batched_ns);
+}
+
+}
+
+int main(int argc, char** argv) {
+    for (auto i = 0; i < 200; ++i) {
+        extra_names.push_back("proto.extra" + std::to_string(i));
+        extra_configs.emplace_back(extra_names.back(), "I", static_cast<std::uint32_t>(i));
+    }
+    cranc::freezeConfigs();
+    get_many();
+    set_many();
+    back_pressure();
+    rejections();
+    if (sim::bench_requested(argc, argv)) {
+        bench();
+    }
+    return sim::result("protocol");
+}
@@ -0,0 +1,185 @@
+#include "check.h"
+
+#include "util/PwmCommit.h"
+
+#include <array>
+#include <random>
+#include <vector>
+
+/*
+ * PeriodCommit against a simulated pair of pwm slices with double buffered compare and wrap registers
+ * the main loop commits new values at random times, sometimes with a new top, and the wrap interrupt comes in late
+ * by a random number of counts; every write stages the same generation into both slices, a period that latches two
+ * different generations saw a commit torn across a wrap
+ */
+
+namespace {
+
+struct SimPwm {
+    struct Slice {
+        std::uint32_t top{}, top_buffer{};
+        std::uint32_t cc{}, cc_buffer{};
+    };
+    std::array<Slice, 2> slices;
+    std::uint32_t ctr{};
+    std::uint64_t now{};
+    bool wrap_flag{};
+    std::size_t counter_reads{};
+
+    explicit SimPwm(std::uint32_t top) {
+        for (auto& s : slices) {
+            s.top = s.top_buffer = top;
+        }
+    }
+
+    std::uint32_t counter(std::uint8_t) {
+        ++counter_reads;
+        return ctr;
+    }
+
+    // the register reads back what was written, not the wrap of the running period
+    std::uint32_t top(std::uint8_t slice) const {
+        return slices[slice].top_buffer;
+    }
+
+    // returns whether the counter wrapped
+    bool tick() {
+        ++now;
+        if (++ctr <= slices[0].top) {
+            return false;
+        }
+        ctr = 0;
+        for (auto& s : slices) {
+            s.top = s.top_buffer;
+            s.cc = s.cc_buffer;
+        }
+        wrap_flag = true;
+        return true;
+    }
+};
+
+struct Result {
+    std::size_t periods{};
+    std::size_t torn{};
+    std::size_t commits{};
+    std::size_t deferred{};
+    std::uint64_t worst_latency{};
+    std::size_t max_counter_reads{};
+};
+
+// write_counts: how long the register writes of both slices take; naive writes without looking at the counter
+Result run(std::uint16_t guard, std::uint32_t write_counts, std::uint32_t max_irq_latency, bool naive, std::uint32_t seed) {
+    // all above 2 * guard, shorter periods are not synchronized
+    constexpr std::array<std::uint32_t, 3> tops{1200, 3000, 6250};
+    std::mt19937 rng{seed};
+    SimPwm pwm{tops[2]};
+    PeriodCommit<SimPwm> committer{pwm, 0, guard};
+    Result r;
+
+    std::uint32_t generation = 0;
+    std::uint32_t staged_generation = 0;
+    std::uint32_t staged_top = 0;
+    std::uint64_t staged_at = 0;
+    bool irq_enabled = false;
+    std::uint64_t next_commit = 500;
+    std::uint64_t irq_at = 0;
+    bool irq_due = false;
+
+    // writes slice 0, lets the counter run on for the duration of the writes, then writes slice 1
+    auto write = [&] {
+        auto& a = pwm.slices[0];
+        a.cc_buffer = staged_generation;
+        if (staged_top) {
+            a.top_buffer = staged_top;
+        }
+        for (std::uint32_t i = 0; i < write_counts; ++i) {
+            if (pwm.tick()) {
+                ++r.periods;
+                r.torn += pwm.slices[0].cc != pwm.slices[1].cc or pwm.slices[0].top != pwm.slices[1].top;
+            }
+        }
+        auto& b = pwm.slices[1];
+        b.cc_buffer = staged_generation;
+        bool top_written = staged_top != 0;
+        if (top_written) {
+            b.top_buffer = staged_top;
+        }
+        staged_top = 0;
+        return top_written;
+    };
+
+    std::uint32_t latched_generation = 0;
+    while (r.periods < 20'000) {
+        // how long the latest value waits, superseding it doesn't hide one that got stuck
+        if (latched_generation != staged_generation) {
+            r.worst_latency = std::max(r.worst_latency, pwm.now - staged_at);
+        }
+        if (pwm.tick()) {
+            ++r.periods;
+            r.torn += pwm.slices[0].cc != pwm.slices[1].cc or pwm.slices[0].top != pwm.slices[1].top;
+            latched_generation = pwm.slices[0].cc;
+            if (irq_enabled and pwm.wrap_flag and not irq_due) {
+                irq_due = true;
+                irq_at = pwm.now + std::uniform_int_distribution<std::uint32_t>{0, max_irq_latency}(rng);
+            }
+        }
+        if (irq_due and pwm.now >= irq_at) {
+            irq_due = false;
+            pwm.wrap_flag = false;
+            if (not committer.on_wrap(write)) {
+                irq_enabled = false;
+            }
+        }
+        if (pwm.now >= next_commit) {
+            next_commit = pwm.now + std::uniform_int_distribution<std::uint32_t>{200, 20'000}(rng);
+            ++r.commits;
+            staged_generation = ++generation;
+            staged_at = pwm.now;
+            if (rng() % 8 == 0) {
+                staged_top = tops[rng() % tops.size()];
+            }
+            if (naive) {
+                write();
+                continue;
+            }
+            auto reads = pwm.counter_reads;
+            if (committer.commit(write)) {
+                ++r.deferred;
+                pwm.wrap_flag = false;
+                irq_due = false;
+                irq_enabled = true;
+            }
+            r.max_counter_reads = std::max(r.max_counter_reads, pwm.counter_reads - reads);
+        }
+    }
+    return r;
+}
+
+void commits() {
+    constexpr std::uint16_t guard = 512;
+    constexpr std::uint32_t write_counts = 200;
+    constexpr std::uint32_t max_irq_latency = 300;
+    for (std::uint32_t seed = 1; seed <= 5; ++seed) {
+        auto r = run(guard, write_counts, max_irq_latency, false, seed);
+        if (not sim::check(r.torn == 0, "no commit is torn across a wrap")) {
+            std::fprintf(stderr, "  seed %u: %zu of %zu periods torn\n", seed, r.torn, r.periods);
+        }
+        sim::check(r.deferred > 0 and r.deferred < r.commits, "most commits are written right away, some from the interrupt");
+        sim::check(r.max_counter_reads <= 2, "reads the counter once instead of spinning on it");
+        // the value lands at the second wrap at the latest, the longest period being 6251 counts
+        if (not sim::check(r.worst_latency <= 2 * 6251 + max_irq_latency + write_counts, "lands within two periods")) {
+            std::fprintf(stderr, "  seed %u: %llu counts\n", seed, static_cast<unsigned long long>(r.worst_latency));
+        }
+    }
+
+    // the simulation does see writes straddling a wrap when they don't mind the counter
+    auto naive = run(guard, write_counts, max_irq_latency, true, 1);
+    sim::check(naive.torn > 0, "unsynchronized writes tear");
+}
+
+}
+
+int main() {
+    commits();
+    return sim::result("pwm_commit");
+}
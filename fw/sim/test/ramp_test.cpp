@@ -0,0 +1,111 @@
+#include "check.h"
+
+#include "util/Ramp.h"
+
+#include <cmath>
+#include <limits>
+
+/*
+ * the setpoint ramps and the slew limit, stepped like the update loop in ramp.cpp
+ */
+
+namespace {
+
+constexpr double one = 1 << ramp_frac_bits;
+
+void fixed_point() {
+    sim::check(to_ramp_fixed(1.5f) == 3 << (ramp_frac_bits - 1), "converts to fixed point");
+    sim::check(from_ramp_fixed(to_ramp_fixed(-12.25f)) == -12.25f, "exact values round trip");
+    sim::check(std::abs(from_ramp_fixed(to_ramp_fixed(3.3f)) - 3.3f) < 1 / one, "others stay within a step");
+}
+
+void slew() {
+    sim::check(slew_limit(0, 100, 30) == 30 and slew_limit(100, 0, 30) == 70, "moves by the step in both directions");
+    sim::check(slew_limit(0, 20, 30) == 20, "stops at the target");
+    sim::check(slew_limit(5, -7, 0) == -7, "no limit without a step");
+    constexpr auto max = std::numeric_limits<std::int32_t>::max();
+    constexpr auto min = std::numeric_limits<std::int32_t>::min();
+    sim::check(slew_limit(min, max, max) == -1 and slew_limit(max, min, max) == 0, "no overflow across the full range");
+
+    // soft start of 12 V at 10 V/s in 5 ms ticks, as ramp.cpp does
+    std::int32_t reference = 0;
+    std::int32_t target = to_ramp_fixed(12);
+    std::int32_t step = std::max(to_ramp_fixed(10 * .005f), 1);
+    int ticks = 0;
+    while (reference != target and ticks < 10'000) {
+        reference = slew_limit(reference, target, step);
+        ++ticks;
+    }
+    // the step is truncated to fixed point, which costs at most one tick
+    sim::check(ticks == 240 or ticks == 241, "reaches the target after setpoint / slew");
+}
+
+void linear() {
+    Ramp r;
+    r.start(Ramp::Shape::linear, to_ramp_fixed(2), to_ramp_fixed(10), 400);
+    sim::check(r.value == to_ramp_fixed(2) and not r.done(), "starts at from");
+    for (std::uint32_t n = 1; n <= 400; ++n) {
+        auto v = r.step();
+        double expected = 2 + 8. * n / 400;
+        if (not sim::check(std::abs(v / one - expected) <= 1 / one, "follows the line")) {
+            break;
+        }
+    }
+    sim::check(r.done() and r.value == to_ramp_fixed(10), "ends exactly on to");
+    sim::check(r.step() == to_ramp_fixed(10), "a done ramp holds its value");
+
+    // a span across the whole fixed point range doesn't overflow
+    r.start(Ramp::Shape::linear, to_ramp_fixed(-30000), to_ramp_fixed(30000), 3);
+    sim::check(r.step() == to_ramp_fixed(-10000), "wide spans don't overflow");
+
+    r.start(Ramp::Shape::linear, 0, to_ramp_fixed(5), 0);
+    sim::check(r.step() == to_ramp_fixed(5) and r.done(), "a zero duration jumps in one tick");
+
+    r.start(Ramp::Shape::linear, 0, to_ramp_fixed(5), 100);
+    r.step();
+    r.stop();
+    sim::check(r.done() and r.step() < to_ramp_fixed(5), "stop holds the current value");
+}
+
+void exponential() {
+    for (std::uint32_t ticks : {10, 200, 12'000}) {
+        Ramp r;
+        r.start(Ramp::Shape::exponential, to_ramp_fixed(1), to_ramp_fixed(5), ticks);
+        std::int32_t last = r.value;
+        for (std::uint32_t n = 1; n <= ticks; ++n) {
+            auto v = r.step();
+            double expected = n == ticks ? 5 : 5 - 4 * std::exp(-Ramp::exp_time_constants * n / ticks);
+            if (not sim::check(std::abs(v / one - expected) < 1e-4, "follows the first order approach")
+                or not sim::check(v >= last, "rises monotonically")) {
+                std::fprintf(stderr, "  ticks %u step %u got %f expected %f\n", ticks, n, v / one, expected);
+                break;
+            }
+            last = v;
+        }
+        sim::check(r.done() and r.value == to_ramp_fixed(5), "snaps to the end value");
+    }
+
+    // a tiny span over a long time keeps moving instead of stalling on rounding
+    Ramp r;
+    r.start(Ramp::Shape::exponential, 0, 100, 100'000);
+    for (auto n = 0; n < 50'000; ++n) {
+        r.step();
+    }
+    sim::check(r.value >= 90 and r.value < 100, "slow ramps progress");
+
+    r.start(Ramp::Shape::exponential, to_ramp_fixed(5), to_ramp_fixed(-5), 100);
+    for (auto n = 0; n < 99; ++n) {
+        r.step();
+    }
+    sim::check(std::abs(r.value / one - 5 + 10 * (1 - std::exp(-Ramp::exp_time_constants * 99 / 100))) < 1e-4, "falling ramps");
+}
+
+}
+
+int main() {
+    fixed_point();
+    slew();
+    linear();
+    exponential();
+    return sim::result("ramp");
+}
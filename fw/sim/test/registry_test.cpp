@@ -0,0 +1,103 @@
+#include "check.h"
+
+#include "cranc/config/ApplicationConfig.h"
+#include "cranc/config/ConfigRegistry.h"
+
+#include <deque>
+#include <string>
+
+/*
+ * the frozen config registry against walking the globally linked list, up to the 500 configs it is sized for
+ * registry_test --bench compares the lookups by index and the count of both at 50 and 500 configs
+ */
+
+namespace {
+
+std::deque<std::string> names;
+std::deque<cranc::ApplicationConfig<std::uint32_t>> configs;
+
+auto& config_list() {
+    return cranc::util::GloballyLinkedList<cranc::ApplicationConfigBase>::getHead();
+}
+
+// the lookup before freezing, as the usb worker did it for every request
+cranc::ApplicationConfigBase* walk(std::size_t index) {
+    std::size_t i = 0;
+    for (auto& c : config_list()) {
+        if (i++ == index) {
+            return &(*c);
+        }
+    }
+    return nullptr;
+}
+
+void grow_to(std::size_t n) {
+    while (configs.size() < n) {
+        names.push_back("reg.config" + std::to_string(configs.size()));
+        configs.emplace_back(names.back(), "I", static_cast<std::uint32_t>(configs.size()));
+    }
+    while (configs.size() > n) {
+        configs.pop_back();
+        names.pop_back();
+    }
+}
+
+bool matches_list() {
+    if (cranc::configCount() != configs.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        if (cranc::configAt(i) != walk(i)) {
+            return false;
+        }
+    }
+    return cranc::configAt(configs.size()) == nullptr;
+}
+
+void lookups() {
+    for (std::size_t n : {std::size_t{0}, std::size_t{1}, std::size_t{50}, std::size_t{500}, cranc::maxConfigs}) {
+        grow_to(n);
+        sim::check(cranc::freezeConfigs(), "freezes up to maxConfigs");
+        sim::check(matches_list(), "the index is the list order");
+    }
+
+    grow_to(cranc::maxConfigs + 1);
+    sim::check(not cranc::freezeConfigs(), "refuses more than maxConfigs");
+    sim::check(matches_list(), "and keeps walking the list");
+
+    grow_to(50);
+    sim::check(cranc::freezeConfigs() and matches_list(), "freezes again once they fit");
+
+    cranc::ConfigIndex<8> small;
+    sim::check(not small.freeze(config_list()) and not small.frozen, "a short table fails instead of cutting the list");
+}
+
+void bench() {
+    for (std::size_t n : {50, 500}) {
+        grow_to(n);
+        cranc::ConfigIndex<cranc::maxConfigs> index;
+        index.freeze(config_list());
+        auto walk_ns = sim::measure_ns(10'000, [&](std::size_t i) {
+            sim::keep(walk(i % n));
+        });
+        auto index_ns = sim::measure_ns(10'000, [&](std::size_t i) {
+            sim::keep(index.at(i % n));
+        });
+        auto count_walk_ns = sim::measure_ns(1'000, [&](std::size_t) {
+            sim::keep(config_list().count());
+        });
+        std::printf("%3zu configs: lookup %7.1f ns walking, %5.1f ns indexed; count %7.1f ns walking, a load indexed\n",
+                    n, walk_ns, index_ns, count_walk_ns);
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    lookups();
+    if (sim::bench_requested(argc, argv)) {
+        bench();
+    }
+    grow_to(0);
+    return sim::result("registry");
+}
@@ -0,0 +1,254 @@
+#include "check.h"
+
+#include "regulator.h"
+#include "util/Ramp.h"
+
+#include <cmath>
+#include <vector>
+
+/*
+ * the CV/CC regulator closed around a model of the output stage, sampled and clocked like regulation.cpp
+ * the output stage follows its references with gain and offset errors and a first order lag, it limits the current
+ * to its current reference and drives a resistive load
+ * the current limit of a calibrated stage is within the mode switching hysteresis of its setpoint, the regulator
+ * can't tell a stage limiting further below from a load that just draws less
+ */
+
+namespace {
+
+constexpr double h = 50e-6;                 // simulation step
+constexpr std::uint32_t control_period_us = 10'000;
+constexpr std::uint32_t ramp_period_us = 5'000;
+constexpr std::uint32_t max_sample_gap_us = 1'000'000;
+
+struct OutputStage {
+    double gain_u{.95}, offset_u{-.08};
+    double gain_i{.99}, offset_i{.005};
+    double max_u{20};
+    double tau{2e-3};
+    double load_ohm{10};
+    double u{}, i{};
+
+    void step(double u_ref, double i_ref) {
+        double u_cmd = std::clamp(gain_u * u_ref + offset_u, 0., max_u);
+        double i_lim = std::max(gain_i * i_ref + offset_i, 0.);
+        double target = std::min(u_cmd, i_lim * load_ohm);
+        u += (target - u) * h / tau;
+        i = u / load_ohm;
+    }
+};
+
+struct Loop {
+    OutputStage stage;
+    CVCCRegulator regulator;
+    // the references applied to the stage, the regulator works towards them like regulation.cpp
+    float u_set{5}, i_set{1};
+    std::uint32_t sample_period_us;
+    // while slew is set u_set moves towards u_target like ramp.cpp moves a slew limited reference
+    float slew{};
+    float u_target{};
+    std::uint64_t next_ramp_us{ramp_period_us};
+
+    std::uint64_t now_us{};
+    std::uint64_t next_sample_us{};
+    std::uint64_t next_tick_us{control_period_us};
+    float du{}, di{};
+    // the latest sample and the one the regulator consumed last
+    float sample_u{}, sample_i{};
+    std::uint32_t sample_timestamp_us{};
+    bool fresh{};
+    std::uint32_t last_timestamp_us{};
+    bool primed{};
+
+    explicit Loop(std::uint32_t period_us) : sample_period_us{period_us} {
+        auto& r = regulator;
+        r.voltage = {.kp = .1f, .ki = 20.f, .out_min = -2.f, .out_max = 2.f};
+        r.current = {.kp = .1f, .ki = 20.f, .out_min = -.5f, .out_max = .5f};
+    }
+
+    // runs for the given time, calls observe(loop) after every simulation step
+    template<typename F>
+    void run(double seconds, F&& observe) {
+        auto end_us = now_us + static_cast<std::uint64_t>(seconds * 1e6);
+        while (now_us < end_us) {
+            stage.step(u_set + du, i_set + di);
+            now_us += static_cast<std::uint64_t>(h * 1e6);
+            if (now_us >= next_sample_us) {
+                sample_u = stage.u;
+                sample_i = stage.i;
+                sample_timestamp_us = now_us;
+                fresh = true;
+                next_sample_us += sample_period_us;
+            }
+            if (now_us >= next_ramp_us) {
+                next_ramp_us += ramp_period_us;
+                if (slew > 0) {
+                    u_set = from_ramp_fixed(slew_limit(to_ramp_fixed(u_set), to_ramp_fixed(u_target), to_ramp_fixed(slew * ramp_period_us * 1e-6f)));
+                }
+            }
+            if (now_us >= next_tick_us) {
+                next_tick_us += control_period_us;
+                tick();
+            }
+            observe(*this);
+        }
+    }
+
+    void run(double seconds) {
+        run(seconds, [](Loop const&) {});
+    }
+
+    // the body of the control loop in regulation.cpp
+    void tick() {
+        if (not fresh) {
+            return;
+        }
+        fresh = false;
+        std::uint32_t elapsed_us = sample_timestamp_us - last_timestamp_us;
+        float dt = (primed and elapsed_us <= max_sample_gap_us) ? elapsed_us * 1e-6f : 0.f;
+        last_timestamp_us = sample_timestamp_us;
+        primed = true;
+        auto correction = regulator.update(u_set, i_set, sample_u, sample_i, dt);
+        du = correction.du;
+        di = correction.di;
+    }
+};
+
+struct Response {
+    double peak{};
+    double settle_s{};
+};
+
+// runs for the given time, reports when the output last left the tolerance band around target and its peak
+// after the stage itself settled on a load step
+Response step_response(Loop& loop, double target, double tolerance, double seconds, bool current = false) {
+    Response r{};
+    double start_s = loop.now_us * 1e-6;
+    double last_outside = start_s;
+    loop.run(seconds, [&](Loop const& l) {
+        double v = current ? l.stage.i : l.stage.u;
+        if (l.now_us * 1e-6 - start_s > 10 * l.stage.tau) {
+            r.peak = std::max(r.peak, v);
+        }
+        if (std::abs(v - target) > tolerance) {
+            last_outside = l.now_us * 1e-6;
+        }
+    });
+    r.settle_s = last_outside - start_s;
+    return r;
+}
+
+bool within(char const* what, double value, double limit) {
+    if (value > limit) {
+        std::fprintf(stderr, "  %s: %g exceeds %g\n", what, value, limit);
+        return false;
+    }
+    return true;
+}
+
+void cv_steps() {
+    // from the full rate of a four channel schedule down to 8 SPS
+    for (std::uint32_t period_us : {7'000U, 40'000U, 125'000U, 500'000U}) {
+        Loop loop{period_us};
+        auto r = step_response(loop, 5, 2e-3, 60 * period_us * 1e-6 + 1);
+        sim::check(std::abs(loop.stage.u - 5) < 1e-3, "cv removes the static error");
+        sim::check(loop.regulator.mode == CVCCRegulator::Mode::cv, "stays in cv below the current limit");
+        sim::check(within("overshoot", r.peak, 5 * 1.05), "cv step without much overshoot");
+        // the loop needs a similar number of samples at every rate, it does not slow down with the rate
+        auto consumed_period_s = std::max(period_us, control_period_us) * 1e-6;
+        sim::check(within("settling time in samples", r.settle_s / consumed_period_s, 50), "cv settles within a few samples");
+
+        loop.u_set = 8;
+        r = step_response(loop, 8, 2e-3, 60 * period_us * 1e-6 + 1);
+        sim::check(within("overshoot", r.peak, 8 * 1.05) and std::abs(loop.stage.u - 8) < 1e-3, "second setpoint step");
+    }
+}
+
+void cc_transitions() {
+    for (std::uint32_t period_us : {7'000U, 500'000U})
+    for (double gain_i : {.99, 1.04}) {
+        Loop loop{period_us};
+        loop.stage.gain_i = gain_i;
+        double settle = 60 * period_us * 1e-6 + 1;
+        loop.run(settle);
+
+        // a load that wants 2.5 A at 5 V pulls the output into the current limit
+        loop.stage.load_ohm = 2;
+        auto r = step_response(loop, 1, 2e-3, 2 * settle, true);
+        sim::check(loop.regulator.mode == CVCCRegulator::Mode::cc, "switches to cc at the current limit");
+        sim::check(std::abs(loop.stage.i - 1) < 1e-3, "cc removes the static error");
+        sim::check(within("current overshoot", r.peak, 1.06), "the current limit doesn't overshoot much");
+
+        // releasing the load goes back to cv without the voltage jumping past the setpoint
+        loop.stage.load_ohm = 10;
+        r = step_response(loop, 5, 2e-3, 2 * settle);
+        sim::check(loop.regulator.mode == CVCCRegulator::Mode::cv, "back to cv once the voltage recovers");
+        sim::check(std::abs(loop.stage.u - 5) < 1e-3, "cv after cc");
+        sim::check(within("overshoot after cc", r.peak, 5 * 1.1), "recovers from cc without a large overshoot");
+    }
+}
+
+void anti_windup() {
+    // a step down from a reachable setpoint as the reference
+    Loop reference{7'000};
+    reference.u_set = 19;
+    reference.run(2);
+    reference.u_set = 5;
+    auto expected = step_response(reference, 5, 2e-3, 2);
+
+    Loop loop{7'000};
+    loop.u_set = 25; // the stage tops out at 20 V
+    loop.run(2);
+    sim::check(loop.regulator.voltage.integral <= loop.regulator.voltage.out_max, "the integral stays clamped");
+    loop.u_set = 5;
+    auto r = step_response(loop, 5, 2e-3, 2);
+    sim::check(within("recovery after saturation", r.settle_s, expected.settle_s + .05), "no wind up while saturated");
+}
+
+void soft_start() {
+    // 12 V at 10 V/s from an output that was just enabled
+    for (std::uint32_t period_us : {7'000U, 125'000U}) {
+        Loop loop{period_us};
+        loop.u_set = 0;
+        loop.i_set = 2;
+        loop.run(.5);
+        loop.slew = 10;
+        loop.u_target = 12;
+        double peak = 0;
+        double lag = 0;
+        loop.run(3, [&](Loop const& l) {
+            peak = std::max(peak, l.stage.u);
+            if (l.u_set < l.u_target) {
+                lag = std::max(lag, static_cast<double>(l.u_set) - l.stage.u);
+            }
+        });
+        sim::check(within("overshoot after a soft start", peak, 12 * 1.01), "the integrator doesn't wind up during the ramp");
+        sim::check(within("lag behind the reference", lag, 1), "the output follows the slewed reference");
+        sim::check(std::abs(loop.stage.u - 12) < 1e-3, "settles on the setpoint");
+    }
+}
+
+void integral_time() {
+    // the integral follows ki * the integral of the error over time, independent of how it is split into updates
+    for (int steps : {100, 10, 5}) {
+        PIController pi{.kp = 0, .ki = 20, .out_min = -10, .out_max = 10};
+        for (auto n = 0; n < steps; ++n) {
+            pi.update(.5f, .1f / steps);
+        }
+        sim::check(std::abs(pi.integral - 20 * .5f * .1f) < .02f, "the integral is proportional to the elapsed time");
+    }
+    PIController pi{.kp = 0, .ki = 20, .out_min = -10, .out_max = 10};
+    pi.update(1, 1);
+    sim::check(pi.integral == PIController::max_step_gain, "the integral step per update is limited");
+}
+
+}
+
+int main() {
+    integral_time();
+    cv_steps();
+    cc_transitions();
+    anti_windup();
+    soft_start();
+    return sim::result("regulator");
+}
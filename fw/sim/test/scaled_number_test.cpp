@@ -0,0 +1,105 @@
+#include "check.h"
+
+#include "util/Filters.h"
+#include "util/ScaledNumber.h"
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+/*
+ * the fixed point measurement path of analog_readings.cpp, every adc count against the float conversion it replaced
+ * scaled_number_test --bench compares the cost of both; the host has an fpu, the rp2040 doesn't
+ */
+
+namespace {
+
+using CountScale = FixedPoint<std::int32_t, 30>;
+using RawCount = ScaledNumber<std::int16_t>;
+using FilteredCount = FixedPoint<std::int32_t, filter_frac_bits>;
+using Milli = ScaledNumber<std::int32_t, std::milli>;
+
+constexpr std::array<float, 8> pga_full_scale {6.144, 4.096, 2.048, 1.024, 0.512, 0.256, 0.256, 0.256};
+// output voltage divider and current sense of analog_readings.cpp
+constexpr std::array<float, 2> channel_gains {(91.f + 13) / 13, 1.f / (100 * 5e-3f)};
+
+float count_scale(std::size_t pga, std::size_t channel) {
+    return pga_full_scale[pga] / ((1 << 15) - 1) * channel_gains[channel];
+}
+
+void raw_counts() {
+    for (std::size_t pga = 0; pga < 6; ++pga)
+    for (std::size_t channel = 0; channel < channel_gains.size(); ++channel) {
+        float scale = count_scale(pga, channel);
+        auto fixed = CountScale::from_float(scale);
+        double worst = 0;
+        for (std::int32_t raw = -32768; raw <= 32767; ++raw) {
+            auto milli = rounded_cast<Milli>(RawCount{static_cast<std::int16_t>(raw)} * fixed);
+            worst = std::max(worst, std::abs(milli.val - raw * static_cast<double>(scale) * 1000));
+        }
+        // the cast to milli rounds, the q30 scale adds at most 2^-30 per count
+        if (not sim::check(worst <= .5 + 32768e3 / (1 << 30), "every count within half a milli unit of the float conversion")) {
+            std::fprintf(stderr, "  pga %zu channel %zu: %f\n", pga, channel, worst);
+        }
+    }
+}
+
+void filtered_counts() {
+    auto scale = count_scale(0, 0);
+    auto fixed = CountScale::from_float(scale);
+    for (std::int32_t v : {-32768 << filter_frac_bits, -1, 0, 1, 12345 << filter_frac_bits, (32767 << filter_frac_bits) + 255}) {
+        auto milli = rounded_cast<Milli>(FilteredCount{v} * fixed);
+        double expected = v / double(1 << filter_frac_bits) * scale * 1000;
+        if (not sim::check(std::abs(milli.val - expected) < .6, "filtered counts keep their fraction")) {
+            std::fprintf(stderr, "  %d: %d expected %f\n", v, milli.val, expected);
+        }
+    }
+}
+
+void arithmetic() {
+    // the same checks as the static_asserts, with values the compiler doesn't see
+    volatile std::int32_t u = 12'000, i = -1'500;
+    sim::check(power(millivolts{u}, milliamps{i}).val == -18'000, "power");
+    sim::check(power(millivolts{u}, milliamps{1}).val == 12, "power of a small current");
+    sim::check(power(millivolts{1}, milliamps{499}).val == 0 and power(millivolts{1}, milliamps{500}).val == 1, "power rounds to the nearest mW");
+    sim::check(power(millivolts{-1}, milliamps{500}).val == -1, "and symmetrically below zero");
+    sim::check(power(millivolts{2'000'000'000}, milliamps{2'000'000}).val == std::numeric_limits<std::int32_t>::max(), "power saturates");
+
+    sim::check((millivolts{u} + ScaledNumber<std::int32_t, std::micro>{7}).val == 12'000'007, "sums use the finer ratio");
+    sim::check((millivolts{u} - ScaledNumber<std::int32_t>{12}).val == 0, "differences");
+    sim::check(millivolts{u} > ScaledNumber<std::int32_t>{11} and millivolts{u} == ScaledNumber<std::int32_t>{12}, "mixed comparisons");
+    sim::check(saturate_cast<ScaledNumber<std::int16_t, std::milli>>(millivolts{u * 10}).val == 32767, "saturate_cast clamps");
+    sim::check(scaled_number_cast<ScaledNumber<std::int16_t>>(millivolts{-1999}).val == -1, "casts truncate towards zero");
+    sim::check(rounded_cast<ScaledNumber<std::int16_t>>(millivolts{-1500}).val == -2, "rounded casts round half away from zero");
+    sim::check(rounded_cast<ScaledNumber<std::int16_t>>(millivolts{u - 501}).val == 11, "rounded casts round to the nearest");
+    sim::check(std::abs(FixedPoint<std::int32_t, 16>::from_float(-3.25f).to_float() + 3.25f) < 1e-6f, "float round trip");
+}
+
+void bench() {
+    std::vector<std::int16_t> raw(4096);
+    for (std::size_t n = 0; n < raw.size(); ++n) {
+        raw[n] = static_cast<std::int16_t>(n * 16 - 32768);
+    }
+    float scale = count_scale(0, 0);
+    auto fixed = CountScale::from_float(scale);
+    auto float_ns = sim::measure_ns(1'000'000, [&](std::size_t n) {
+        sim::keep(raw[n % raw.size()] * scale);
+    });
+    auto fixed_ns = sim::measure_ns(1'000'000, [&](std::size_t n) {
+        sim::keep(rounded_cast<Milli>(RawCount{raw[n % raw.size()]} * fixed).val);
+    });
+    std::printf("%-28s %6.2f ns/sample\n", "float count * scale", float_ns);
+    std::printf("%-28s %6.2f ns/sample\n", "q30 count * scale to milli", fixed_ns);
+}
+
+}
+
+int main(int argc, char** argv) {
+    raw_counts();
+    filtered_counts();
+    arithmetic();
+    if (sim::bench_requested(argc, argv)) {
+        bench();
+    }
+    return sim::result("scaled_number");
+}
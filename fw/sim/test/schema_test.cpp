@@ -0,0 +1,180 @@
+#include "check.h"
+
+#include "cranc/config/ApplicationConfig.h"
+#include "cranc/config/ConfigRegistry.h"
+#include "misc/ConfigProtocol.h"
+#include "util/Hash.h"
+
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * the schema blob fetched in chunks like Device.fetch_schema, parsed like parse_config_records in python/device.py, and
+ * every format checked against the size of its config with the rules of python's struct.calcsize
+ */
+
+namespace {
+
+struct Limits {
+    float u0, i0, u1, i1;
+};
+
+struct Mixed {
+    std::uint8_t flag;
+    std::uint32_t count;
+    std::int16_t offset;
+};
+
+cranc::ApplicationConfig<void> trigger {"schema.trigger"};
+cranc::ApplicationConfig<std::uint8_t> byte_cfg {"schema.byte", "B", 0};
+cranc::ApplicationConfig<bool> bool_cfg {"schema.bool", "?", false};
+cranc::ApplicationConfig<Limits> limits_cfg {"schema.limits", "4f"};
+// python doesn't pad the end of a format like the compiler pads a struct, the format has to spell it out
+cranc::ApplicationConfig<Mixed> mixed_cfg {"schema.mixed", "BIh2x"};
+cranc::ApplicationConfig<std::array<std::uint64_t, 3>> load_cfg {"schema.load", "3Q"};
+cranc::ApplicationConfig<std::array<char, 12>> text_cfg {"schema.text", "12s"};
+std::deque<std::string> extra_names;
+std::deque<cranc::ApplicationConfig<double>> extra_configs;
+
+// struct.calcsize with the native byte order, size and alignment python uses without a prefix character
+std::optional<std::size_t> calcsize(std::string_view format) {
+    std::size_t size = 0;
+    for (std::size_t pos = 0; pos < format.size();) {
+        std::size_t count = 1;
+        if (std::isdigit(format[pos])) {
+            count = 0;
+            while (pos < format.size() and std::isdigit(format[pos])) {
+                count = count * 10 + (format[pos++] - '0');
+            }
+            if (pos == format.size()) {
+                return {};
+            }
+        }
+        std::size_t item;
+        switch (format[pos++]) {
+        case 'x': case 'c': case 'b': case 'B': case '?': case 's': case 'p':
+            item = 1; break;
+        case 'h': case 'H': case 'e':
+            item = 2; break;
+        case 'i': case 'I': case 'f':
+            item = 4; break;
+        case 'l': case 'L':
+            item = sizeof(long); break;
+        case 'q': case 'Q': case 'd':
+            item = 8; break;
+        case 'n': case 'N': case 'P':
+            item = sizeof(void*); break;
+        case ' ':
+            continue;
+        default:
+            return {};
+        }
+        // strings and padding count bytes, everything else is aligned to its own size
+        size = (size + item - 1) / item * item;
+        size += item * count;
+    }
+    return size;
+}
+
+struct Record {
+    std::uint16_t size;
+    std::string name;
+    std::string format;
+};
+
+std::vector<std::uint8_t> fetch_chunk(config_protocol::Engine& engine, std::uint16_t chunk, std::size_t& transfers) {
+    std::array<std::uint8_t, 3> request{config_protocol::op_schema};
+    std::memcpy(request.data() + 1, &chunk, sizeof(chunk));
+    engine.receive(request);
+    auto framed = engine.execute();
+    ++transfers;
+    return {framed.begin() + 2, framed.end()};
+}
+
+void python_rules() {
+    // values of struct.calcsize on x86_64 and the rp2040 alike
+    sim::check(calcsize("") == 0u, "empty");
+    sim::check(calcsize("4f") == 16u, "repeat counts");
+    sim::check(calcsize("BI") == 8u, "aligned");
+    sim::check(calcsize("IB") == 5u, "no padding at the end");
+    sim::check(calcsize("BIh") == 10u, "mixed");
+    sim::check(calcsize("12s") == 12u, "strings count bytes");
+    sim::check(calcsize("B3Q") == 32u, "a repeated item is aligned once");
+    sim::check(calcsize("BIh2x") == sizeof(Mixed) and calcsize("BIh") != sizeof(Mixed), "trailing padding is explicit");
+    sim::check(not calcsize("4") and not calcsize("k"), "malformed formats");
+}
+
+void schema() {
+    config_protocol::Engine engine;
+    std::size_t transfers = 0;
+    auto blob = fetch_chunk(engine, 0, transfers);
+    struct {
+        std::uint32_t hash;
+        std::uint16_t size;
+        std::uint16_t count;
+    } header;
+    if (not sim::check(blob.size() >= sizeof(header), "the first chunk starts with the header")) {
+        return;
+    }
+    std::memcpy(&header, blob.data(), sizeof(header));
+    sim::check(header.count == cranc::configCount(), "counts every config");
+    while (blob.size() < sizeof(header) + header.size) {
+        auto chunk = fetch_chunk(engine, blob.size() / config_protocol::max_payload, transfers);
+        if (not sim::check(not chunk.empty(), "every chunk up to the size has data")) {
+            return;
+        }
+        blob.insert(blob.end(), chunk.begin(), chunk.end());
+    }
+    sim::check(blob.size() == sizeof(header) + header.size, "the chunks add up to the size");
+    sim::check(transfers == (blob.size() + config_protocol::max_payload - 1) / config_protocol::max_payload, "in full chunks");
+    sim::check(fetch_chunk(engine, transfers, transfers).empty(), "empty past the end");
+
+    std::span<const std::uint8_t> records{blob.data() + sizeof(header), header.size};
+    sim::check(header.hash == hash_str({reinterpret_cast<char const*>(records.data()), records.size()}), "the hash covers the records");
+
+    std::vector<Record> parsed;
+    for (std::size_t pos = 0; pos < records.size();) {
+        Record r;
+        std::memcpy(&r.size, records.data() + pos, sizeof(r.size));
+        auto name_len = records[pos + 2];
+        r.name.assign(reinterpret_cast<char const*>(records.data() + pos + 3), name_len);
+        pos += 3 + name_len;
+        auto format_len = records[pos];
+        r.format.assign(reinterpret_cast<char const*>(records.data() + pos + 1), format_len);
+        pos += 1 + format_len;
+        if (not sim::check(pos <= records.size(), "the records end with the blob")) {
+            return;
+        }
+        parsed.push_back(r);
+    }
+    if (not sim::check(parsed.size() == cranc::configCount(), "one record per config")) {
+        return;
+    }
+    for (std::size_t i = 0; i < parsed.size(); ++i) {
+        auto cfg = cranc::configAt(i);
+        auto& r = parsed[i];
+        sim::check(r.name == cfg->getName() and r.format == cfg->getFormat() and r.size == cfg->getSize(), "the records are the configs in index order");
+        if (not sim::check(calcsize(r.format) == r.size, "the format decodes exactly the value")) {
+            std::fprintf(stderr, "  %s: \"%s\" for %u bytes\n", r.name.c_str(), r.format.c_str(), r.size);
+        }
+    }
+}
+
+}
+
+int main() {
+    // enough configs for the blob to span several chunks
+    for (auto i = 0; i < 100; ++i) {
+        extra_names.push_back("schema.extra" + std::to_string(i));
+        extra_configs.emplace_back(extra_names.back(), "d", 0.);
+    }
+    cranc::freezeConfigs();
+    python_rules();
+    schema();
+    return sim::result("schema");
+}
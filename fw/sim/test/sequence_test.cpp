@@ -0,0 +1,141 @@
+#include "check.h"
+
+#include "util/Sequence.h"
+
+#include <optional>
+#include <random>
+#include <vector>
+
+/*
+ * the sequence player on a virtual clock, driven like sequence.cpp drives it: a timer interrupt that fires late
+ * advances the player and leaves the step it moved to for the main loop, which applies the latest one when it gets
+ * around to it
+ */
+
+namespace {
+
+// the steps are numbered in u_mV so an applied step can be told apart
+std::vector<SequenceStep> numbered(std::vector<std::uint32_t> const& durations_us) {
+    std::vector<SequenceStep> steps;
+    for (auto const d : durations_us) {
+        steps.push_back({d, static_cast<std::uint16_t>(steps.size()), 0});
+    }
+    return steps;
+}
+
+struct Applied {
+    std::uint16_t step;
+    std::uint64_t at_us;
+    // when the step was due to start and end
+    std::uint64_t start_us, end_us;
+};
+
+struct Run {
+    std::vector<Applied> applied;
+    std::uint64_t end_us{};
+};
+
+// plays steps with the timer firing up to irq_jitter_us late and the main loop picking due steps up every
+// main_period_us, plus up to main_jitter_us
+Run play(std::vector<SequenceStep> const& steps, std::uint32_t loops, std::uint32_t irq_jitter_us,
+         std::uint32_t main_period_us, std::uint32_t main_jitter_us, std::uint32_t seed = 1) {
+    std::mt19937 rng{seed};
+    auto jitter = [&](std::uint32_t max) {
+        return max ? std::uniform_int_distribution<std::uint32_t>{0, max}(rng) : 0;
+    };
+    Run run;
+    SequencePlayer player;
+    std::uint64_t now = 1000;
+    if (not player.start(steps, loops, now)) {
+        return run;
+    }
+    run.applied.push_back({player.current().u_mV, now, now, player.deadline_us()});
+    std::optional<Applied> due;
+    std::uint64_t timer_at = player.deadline_us() + jitter(irq_jitter_us);
+    std::uint64_t main_at = now + main_period_us + jitter(main_jitter_us);
+    bool running = true;
+    while (running or due) {
+        if (running and timer_at <= main_at) {
+            now = timer_at;
+            if (not player.advance(now)) {
+                running = false;
+                run.end_us = player.step_start_us;
+                continue;
+            }
+            due = {player.current().u_mV, 0, player.step_start_us, player.deadline_us()};
+            timer_at = std::max(player.deadline_us(), now) + jitter(irq_jitter_us);
+        } else {
+            now = main_at;
+            if (due) {
+                due->at_us = now;
+                run.applied.push_back(*due);
+                due.reset();
+            }
+            main_at = now + main_period_us + jitter(main_jitter_us);
+        }
+    }
+    return run;
+}
+
+void player() {
+    SequencePlayer p;
+    std::vector<SequenceStep> none{{0, 0, 0}, {0, 0, 0}};
+    sim::check(not p.start(none, 1, 0), "a sequence without duration doesn't start");
+    sim::check(not p.start({}, 1, 0), "an empty sequence doesn't start");
+
+    SequenceStep on{SequenceStep::enable_flag | 500, 1200, 300};
+    sim::check(on.enabled() and on.duration() == 500, "the msb carries the enable");
+
+    auto steps = numbered({100, 200, 300});
+    p.start(steps, 2, 0);
+    sim::check(p.advance(99) and p.index == 0, "stays on a step until its deadline");
+    sim::check(p.advance(450) and p.index == 2 and p.step_start_us == 300, "skips steps missed entirely");
+    sim::check(p.advance(600) and p.loop == 1 and p.index == 0, "loops");
+    sim::check(not p.advance(1200) and not p.running, "stops after the loop count");
+
+    p.start(steps, 0, 0);
+    sim::check(p.advance(600'000) and p.loop == 1000, "zero loops repeat forever");
+}
+
+void timing() {
+    // steps well above the latencies: every step is applied once, late by no more than the latencies
+    auto steps = numbered({2000, 5000, 1000, 10'000});
+    constexpr std::uint32_t loops = 1000;
+    constexpr std::uint32_t irq_jitter = 50, main_period = 100, main_jitter = 400;
+    auto run = play(steps, loops, irq_jitter, main_period, main_jitter);
+    sim::check(run.applied.size() == steps.size() * loops, "every step is applied");
+    std::uint64_t ideal = 1000;
+    for (std::size_t n = 0; n < run.applied.size(); ++n) {
+        auto const& a = run.applied[n];
+        if (not sim::check(a.step == n % steps.size(), "in order")
+            or not sim::check(a.at_us >= ideal and a.at_us <= ideal + irq_jitter + main_period + main_jitter, "late by at most the latencies")) {
+            std::fprintf(stderr, "  step %zu at %llu, due at %llu\n", n, static_cast<unsigned long long>(a.at_us),
+                         static_cast<unsigned long long>(ideal));
+            break;
+        }
+        ideal += steps[a.step].duration();
+    }
+    // the deadlines are absolute, the latencies don't add up over the loops
+    sim::check(run.end_us == 1000 + loops * 18'000ULL, "no drift over many loops");
+
+    // steps shorter than the latencies: the main loop applies the latest step, never an older one
+    auto fast = numbered({30, 40, 20, 50, 60, 30, 20, 50});
+    run = play(fast, 200, 100, 250, 500, 7);
+    for (std::size_t n = 1; n < run.applied.size(); ++n) {
+        auto const& a = run.applied[n];
+        if (not sim::check(a.start_us > run.applied[n - 1].start_us, "never goes back to an older step")
+            or not sim::check(a.end_us + 250 + 500 >= a.at_us, "the step was current within a main loop latency")) {
+            break;
+        }
+    }
+    sim::check(run.applied.size() < fast.size() * 200, "steps shorter than the main loop latency are skipped");
+    sim::check(run.end_us == 1000 + 200 * 300ULL, "skipping doesn't shift the time base");
+}
+
+}
+
+int main() {
+    player();
+    timing();
+    return sim::result("sequence");
+}
@@ -0,0 +1,238 @@
+#include "check.h"
+
+#include "util/Subscriptions.h"
+
+#include <array>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <random>
+#include <vector>
+
+/*
+ * the change notifications of usbCom.cpp against a stand-in for the notify endpoint: the notifier polls the table every
+ * millisecond and packs the records into a 512 byte transfer, the host side decodes them and checks what it saw against
+ * the history of the configs
+ * subscriptions_test --bench compares the bytes on the bus with polling every config every 50 ms like plot.py
+ */
+
+namespace {
+
+using Table = SubscriptionTable<16, 64>;
+
+// the record layout of usbCom.cpp
+struct NotificationHeader {
+    std::uint16_t index;
+    std::uint16_t size;
+    std::uint32_t timestamp_us;
+};
+
+struct Record {
+    std::uint16_t index;
+    std::uint32_t timestamp_us;
+    std::vector<std::uint8_t> value;
+};
+
+// packs records like the notifier does, transfer_size 0 refuses everything
+struct Endpoint {
+    std::size_t transfer_size{512};
+    std::vector<std::uint8_t> buffer;
+    std::size_t bytes{};
+
+    bool emit(std::uint16_t index, std::uint32_t timestamp_us, std::span<std::uint8_t const> value) {
+        NotificationHeader header{index, static_cast<std::uint16_t>(value.size()), timestamp_us};
+        if (buffer.size() + sizeof(header) + value.size() > transfer_size) {
+            return false;
+        }
+        auto pos = buffer.size();
+        buffer.resize(pos + sizeof(header) + value.size());
+        std::memcpy(buffer.data() + pos, &header, sizeof(header));
+        std::memcpy(buffer.data() + pos + sizeof(header), value.data(), value.size());
+        return true;
+    }
+
+    // what the host reads from one transfer
+    std::vector<Record> transfer() {
+        std::vector<Record> records;
+        std::size_t pos = 0;
+        while (pos + sizeof(NotificationHeader) <= buffer.size()) {
+            NotificationHeader header;
+            std::memcpy(&header, buffer.data() + pos, sizeof(header));
+            pos += sizeof(header);
+            records.push_back({header.index, header.timestamp_us, {buffer.begin() + pos, buffer.begin() + pos + header.size}});
+            pos += header.size;
+        }
+        bytes += buffer.size();
+        buffer.clear();
+        return records;
+    }
+};
+
+struct Configs {
+    std::vector<std::vector<std::uint8_t>> values;
+
+    std::span<std::uint8_t const> operator()(std::uint16_t index) const {
+        if (index >= values.size()) {
+            return {};
+        }
+        return values[index];
+    }
+};
+
+std::size_t poll(Table& table, std::uint32_t now_us, Configs const& configs, Endpoint& ep) {
+    return table.poll(now_us, configs, [&](std::uint16_t index, std::uint32_t t, std::span<std::uint8_t const> value) {
+        return ep.emit(index, t, value);
+    });
+}
+
+void subscribe() {
+    Table table;
+    sim::check(table.empty(), "starts empty");
+    sim::check(not table.subscribe(Table::no_index, 4, 0), "no_index is refused");
+    sim::check(not table.subscribe(1, 0, 0), "configs without a value are refused");
+    sim::check(not table.subscribe(1, 65, 0), "values larger than a record are refused");
+    for (std::uint16_t i = 0; i < 16; ++i) {
+        sim::check(table.subscribe(i, 4, 1000), "subscribes up to the capacity");
+    }
+    sim::check(not table.subscribe(16, 4, 1000), "refuses more than the capacity");
+    sim::check(table.subscribe(3, 4, 5000), "subscribing again fits into a full table");
+    table.unsubscribe(3);
+    sim::check(table.subscribe(16, 4, 1000), "unsubscribing frees the entry");
+    table.unsubscribe(Table::no_index);
+    sim::check(table.empty(), "no_index drops everything");
+}
+
+void reports() {
+    Table table;
+    Configs configs{{{1, 0, 0, 0}, {2, 0}}};
+    Endpoint ep;
+    table.subscribe(0, 4, 10'000);
+    table.subscribe(1, 2, 0);
+
+    sim::check(poll(table, 100, configs, ep) == 2, "the first poll reports the current values");
+    auto records = ep.transfer();
+    sim::check(records.size() == 2 and records[0].timestamp_us == 100 and records[0].value == configs.values[0], "with value and timestamp");
+    sim::check(poll(table, 200, configs, ep) == 0 and ep.buffer.empty(), "unchanged values aren't reported");
+
+    configs.values[0][0] = 7;
+    configs.values[1][1] = 7;
+    sim::check(poll(table, 300, configs, ep) == 1, "a change within the interval waits, one without an interval goes out");
+    ep.transfer();
+    sim::check(poll(table, 10'099, configs, ep) == 0, "still within the interval");
+    sim::check(poll(table, 10'100, configs, ep) == 1, "reported once the interval elapsed");
+    records = ep.transfer();
+    sim::check(records.size() == 1 and records[0].index == 0 and records[0].value == configs.values[0], "the current value");
+
+    // a change that went back before the interval elapsed is no change
+    configs.values[0][0] = 8;
+    configs.values[0][0] = 7;
+    sim::check(poll(table, 20'100, configs, ep) == 0, "changes back and forth within an interval are not reported");
+
+    table.subscribe(0, 4, 10'000);
+    sim::check(poll(table, 20'200, configs, ep) == 1, "subscribing again forces a report");
+    ep.transfer();
+
+    // the buffer is full: the change stays pending and goes out with the next transfer
+    configs.values[1][0] = 9;
+    Endpoint full{.transfer_size = 0};
+    sim::check(poll(table, 20'300, configs, full) == 0, "a full transfer keeps the change");
+    sim::check(poll(table, 20'400, configs, ep) == 1, "and reports it later");
+    records = ep.transfer();
+    sim::check(records.size() == 1 and records[0].timestamp_us == 20'400, "stamped with the time it was taken");
+
+    configs.values[1].resize(3);
+    sim::check(poll(table, 20'500, configs, ep) == 0, "a value of the wrong size is skipped");
+    configs.values.resize(1);
+    sim::check(poll(table, 20'600, configs, ep) == 0, "a config that vanished is skipped");
+}
+
+// random changes of 16 configs at up to 1 kHz, each subscription with its own interval, against the host's view
+void stream() {
+    std::mt19937 rng{38};
+    Table table;
+    Configs configs;
+    std::array<std::uint32_t, 16> intervals;
+    for (std::uint16_t i = 0; i < 16; ++i) {
+        configs.values.emplace_back(1 + rng() % 64, 0);
+        intervals[i] = (rng() % 4) * 5'000;
+        table.subscribe(i, configs.values[i].size(), intervals[i]);
+    }
+    // what each config held over time, to check the notifications against
+    std::vector<std::map<std::uint32_t, std::vector<std::uint8_t>>> history(16);
+    std::vector<std::optional<Record>> last(16);
+    Endpoint ep;
+    bool ok = true;
+    std::uint32_t now_us = 0;
+    for (auto tick = 0; tick < 20'000 and ok; ++tick, now_us += 1'000) {
+        // the configs stop changing after 15 s, the rest is for the last values to arrive
+        if (tick < 15'000) {
+            for (auto n = rng() % 3; n > 0; --n) {
+                auto i = rng() % 16;
+                configs.values[i][rng() % configs.values[i].size()] = rng() % 4;
+            }
+        }
+        for (std::uint16_t i = 0; i < 16; ++i) {
+            history[i][now_us] = configs.values[i];
+        }
+        // a host that doesn't keep up every now and then
+        ep.transfer_size = rng() % 10 == 0 ? 0 : 512;
+        poll(table, now_us, configs, ep);
+        for (auto& r : ep.transfer()) {
+            auto& h = history[r.index];
+            auto it = h.find(r.timestamp_us);
+            ok &= sim::check(it != h.end() and it->second == r.value, "every notification holds the value at its timestamp");
+            if (auto& prev = last[r.index]) {
+                ok &= sim::check(prev->value != r.value, "only changes are reported");
+                ok &= sim::check(r.timestamp_us - prev->timestamp_us >= intervals[r.index], "at most one report per interval");
+            }
+            last[r.index] = r;
+        }
+    }
+    for (std::uint16_t i = 0; i < 16 and ok; ++i) {
+        sim::check(last[i] and last[i]->value == configs.values[i], "the host ends up with the final values");
+    }
+}
+
+void bench() {
+    // plot.py polls 16 configs every 50 ms, each get a request of 3 bytes and a response of 2 + size
+    std::mt19937 rng{1};
+    Table table;
+    Configs configs;
+    for (std::uint16_t i = 0; i < 16; ++i) {
+        configs.values.emplace_back(4, 0);
+        table.subscribe(i, 4, 50'000);
+    }
+    for (auto changing : {0, 4, 16}) {
+        Endpoint ep;
+        std::size_t polled = 0;
+        constexpr auto seconds = 10;
+        for (std::uint32_t now_us = 0; now_us < seconds * 1'000'000; now_us += 1'000) {
+            if (now_us % 50'000 == 0) {
+                for (auto i = 0; i < changing; ++i) {
+                    configs.values[i][0] = rng();
+                }
+                polled += 16 * (3 + 2 + 4);
+            }
+            poll(table, now_us, configs, ep);
+            ep.transfer();
+        }
+        std::printf("%2d of 16 configs changing every 50 ms: %7zu B/s polled, %7zu B/s notified\n",
+                    changing, polled / seconds, ep.bytes / seconds);
+    }
+    auto ns = sim::measure_ns(100'000, [&](std::size_t n) {
+        sim::keep(table.poll(static_cast<std::uint32_t>(n * 1'000), configs, [](auto, auto, auto) { return true; }));
+    });
+    std::printf("poll of 16 subscriptions: %.1f ns\n", ns);
+}
+
+}
+
+int main(int argc, char** argv) {
+    subscribe();
+    reports();
+    stream();
+    if (sim::bench_requested(argc, argv)) {
+        bench();
+    }
+    return sim::result("subscriptions");
+}
@@ -0,0 +1,55 @@
+#!/usr/bin/python3
+
+"""
+decodes the stream simulated by telemetry_test with the FrameDecoder of python/telemetry.py, fed in usb sized reads
+usage: telemetry_decode_test.py <telemetry_test binary>
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import types
+
+import numpy as np
+
+# the decoder doesn't touch the usb stack, this runs on hosts without pyusb too
+for name in ("usb", "usb.core", "usb.util"):
+    sys.modules.setdefault(name, types.ModuleType(name))
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "python"))
+from telemetry import FrameDecoder, sync
+
+failures = 0
+
+
+def check(condition, what):
+    global failures
+    if not condition:
+        print(f"violated: {what}", file=sys.stderr)
+        failures += 1
+
+
+with tempfile.TemporaryDirectory() as tmp:
+    path = os.path.join(tmp, "stream.bin")
+    out = subprocess.run([sys.argv[1], "--stream", path], check=True, capture_output=True, text=True).stdout
+    sent, dropped = map(int, out.split())
+    with open(path, "rb") as f:
+        stream = f.read()
+
+decoder = FrameDecoder()
+chunks = [decoder.feed(stream[pos:pos + 512]) for pos in range(0, len(stream), 512)]
+frames = np.concatenate(chunks)
+seq = frames['seq'].astype(np.int64)
+
+check(len(frames) == sent, f"decodes every frame sent ({len(frames)} of {sent})")
+check(decoder.lost == dropped, f"counts the frames dropped on the device ({decoder.lost} of {dropped})")
+check(np.all(frames['sync'] == sync) and np.all(np.diff(seq) > 0), "frames in order")
+# the content telemetry_test gives every frame
+check(np.array_equal(frames['status'], seq & 0xf), "status")
+check(np.array_equal(frames['timestamp_us'], (seq * 1163) % (1 << 32)), "timestamps")
+lanes = seq[:, None] * 4 + np.arange(4)
+check(np.array_equal(frames['measured'], lanes - 1000), "measured values")
+check(np.array_equal(frames['setpoints'], -lanes), "setpoints")
+
+print(f"telemetry_decode: {'FAILED' if failures else 'ok'}")
+sys.exit(1 if failures else 0)
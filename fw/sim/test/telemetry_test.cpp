@@ -0,0 +1,122 @@
+#include "check.h"
+
+#include "util/Telemetry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+/*
+ * the telemetry batcher of telemetry.cpp: samples are pushed at the adc rate and taken every 5 ms by a sender that
+ * stalls now and then, as the main loop does
+ * telemetry_test --stream <file> writes the simulated byte stream for telemetry_decode_test.py, which decodes it with
+ * the FrameDecoder of python/telemetry.py, and prints the number of frames and the number dropped on the device
+ */
+
+namespace {
+
+constexpr std::size_t frames_per_batch = 512 / sizeof(TelemetryFrame);
+using Batcher = TelemetryBatcher<frames_per_batch>;
+
+// the content of a frame follows from its sequence number, so the decoder side can check every field
+TelemetryFrame frame_for(std::uint32_t seq) {
+    TelemetryFrame f{};
+    f.status = seq & 0xf;
+    f.timestamp_us = seq * 1163;
+    for (auto i{0U}; i < 4; ++i) {
+        f.measured[i] = static_cast<std::int32_t>(seq * 4 + i) - 1000;
+        f.setpoints[i] = -static_cast<std::int32_t>(seq * 4 + i);
+    }
+    return f;
+}
+
+std::vector<TelemetryFrame> frames_of(std::span<std::uint8_t const> bytes) {
+    std::vector<TelemetryFrame> frames(bytes.size() / sizeof(TelemetryFrame));
+    std::memcpy(frames.data(), bytes.data(), frames.size() * sizeof(TelemetryFrame));
+    return frames;
+}
+
+void batches() {
+    Batcher batcher;
+    sim::check(frames_per_batch * sizeof(TelemetryFrame) <= 512, "a batch fits into one transfer");
+    sim::check(batcher.take().empty(), "nothing to take at first");
+
+    for (auto i = 0; i < 3; ++i) {
+        batcher.push(frame_for(0));
+    }
+    auto first = batcher.take();
+    auto frames = frames_of(first);
+    sim::check(frames.size() == 3, "takes what was pushed");
+    sim::check(frames[0].sync == telemetry_sync and frames[2].seq == 2, "frames get the sync word and consecutive numbers");
+
+    // the taken batch is in flight while the other one fills
+    std::vector<std::uint8_t> in_flight{first.begin(), first.end()};
+    for (std::size_t i = 0; i < frames_per_batch + 5; ++i) {
+        batcher.push(frame_for(0));
+    }
+    sim::check(std::equal(first.begin(), first.end(), in_flight.begin()), "pushing doesn't touch the batch in flight");
+    sim::check(batcher.dropped == 5, "frames beyond a full batch are dropped and counted");
+    frames = frames_of(batcher.take());
+    sim::check(frames.size() == frames_per_batch and frames.front().seq == 3, "the next batch continues the numbers");
+    batcher.push(frame_for(0));
+    sim::check(frames_of(batcher.take()).front().seq == 3 + frames_per_batch + 5, "dropped frames leave a gap in the numbers");
+}
+
+struct Stream {
+    std::vector<std::uint8_t> bytes;
+    std::uint32_t frames{};
+    std::uint32_t dropped{};
+};
+
+// 860 samples per second for 10 s, the sender takes a batch every 5 ms but stalls for up to 20 ms every few hundred ms
+Stream simulate(bool with_junk) {
+    std::mt19937 rng{42};
+    Batcher batcher;
+    Stream stream;
+    std::uint64_t next_take = 5'000;
+    std::uint32_t last_seq = 0;
+    bool ok = true;
+    for (std::uint64_t t = 0; t < 10'000'000; t += 1163) {
+        batcher.push(frame_for(batcher.next_seq));
+        if (t < next_take) {
+            continue;
+        }
+        next_take = t + 5'000 + (rng() % 64 == 0 ? rng() % 20'000 : 0);
+        auto batch = batcher.take();
+        for (auto const& f : frames_of(batch)) {
+            auto expected = frame_for(f.seq);
+            expected.sync = telemetry_sync;
+            expected.seq = f.seq;
+            ok = ok and sim::check(stream.frames == 0 or f.seq > last_seq, "frames leave in order");
+            ok = ok and sim::check(std::memcmp(&f, &expected, sizeof(f)) == 0, "with their content");
+            last_seq = f.seq;
+            ++stream.frames;
+        }
+        stream.bytes.insert(stream.bytes.end(), batch.begin(), batch.end());
+        // a few bytes that aren't a frame, for the decoder to resynchronize on
+        if (with_junk and rng() % 200 == 0) {
+            stream.bytes.insert(stream.bytes.end(), 5, 0);
+        }
+    }
+    stream.dropped = batcher.dropped;
+    sim::check(stream.frames + stream.dropped == batcher.next_seq, "every numbered frame is either sent or counted as dropped");
+    sim::check(stream.dropped > 0, "the stalls overflow a batch");
+    return stream;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 and std::string_view{argv[1]} == "--stream") {
+        auto stream = simulate(true);
+        std::ofstream{argv[2], std::ios::binary}.write(reinterpret_cast<char const*>(stream.bytes.data()), stream.bytes.size());
+        std::printf("%u %u\n", stream.frames, stream.dropped);
+        return sim::failures ? 1 : 0;
+    }
+    batches();
+    simulate(false);
+    return sim::result("telemetry");
+}
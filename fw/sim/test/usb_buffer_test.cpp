@@ -0,0 +1,325 @@
+#include "check.h"
+
+#include "usb/usb_endpoint.h"
+
+#include <array>
+#include <functional>
+#include <optional>
+#include <vector>
+
+/*
+ * the in side of usb.cpp's buffer control against a model of the controller, one IN token per tick: the controller
+ * sends the buffer it alternates to if that one is available, hands it back and raises the buffer status interrupt,
+ * which is served a number of ticks later and may find both buffers done
+ * every packet has to carry the data toggle the host expects, a transfer has to arrive whole with a zero length packet
+ * after a full last one, cb has to fire once after its last packet and the next transfer may start right from it
+ * --bench sends a 514 byte response packet by packet, the sender resuming 3 ticks after each cb, and as one transfer
+ * single and double buffered
+ */
+
+namespace {
+
+constexpr std::size_t packet_size = 64;
+
+using Bytes = std::vector<std::uint8_t>;
+
+struct Packet {
+    unsigned buffer;
+    Bytes data;
+};
+
+// the controller's side of one bulk in endpoint
+struct Controller {
+    volatile std::uint32_t buffer_control{};
+    // the register when the firmware last waited before setting a buffer available
+    std::uint32_t settled{};
+    std::array<std::uint8_t, 2 * packet_size> dpram{};
+    bool double_buffered;
+    unsigned next_buffer{};
+    unsigned last_buffer{};
+    unsigned data_toggle{};
+    std::vector<Packet> sent;
+    // waits on one buffer while the other is available, reported once
+    bool stuck{};
+
+    explicit Controller(bool double_buffered) : double_buffered{double_buffered} {}
+
+    static std::uint32_t half(std::uint32_t reg, unsigned buffer) {
+        return (reg >> (16 * buffer)) & 0xffff;
+    }
+
+    // one IN token from the host, returns whether a packet went out
+    bool in_token() {
+        std::uint32_t reg = buffer_control;
+        auto ctl = half(reg, next_buffer);
+        if (not (ctl & USB_BUF_CTRL_AVAIL)) {
+            if (double_buffered and not stuck) {
+                stuck = not sim::check(not (half(reg, next_buffer ^ 1) & USB_BUF_CTRL_AVAIL), "the buffer filled is the one the controller sends next");
+            }
+            return false;
+        }
+        sim::check(ctl & USB_BUF_CTRL_FULL, "an available buffer is full");
+        sim::check((half(settled, next_buffer) | USB_BUF_CTRL_AVAIL) == ctl, "available is set after the rest of the buffer control settled");
+        sim::check(bool(ctl & USB_BUF_CTRL_DATA1_PID) == bool(data_toggle), "the pid alternates with every packet");
+        std::size_t len = ctl & USB_BUF_CTRL_LEN_MASK;
+        if (not sim::check(len <= packet_size, "a packet fits its buffer")) {
+            len = packet_size;
+        }
+        auto data = std::span(dpram).subspan(next_buffer * packet_size, len);
+        sent.push_back({next_buffer, {data.begin(), data.end()}});
+        data_toggle ^= 1;
+        buffer_control = reg & ~((USB_BUF_CTRL_FULL | USB_BUF_CTRL_AVAIL) << (16 * next_buffer));
+        last_buffer = next_buffer;
+        if (double_buffered) {
+            next_buffer ^= 1;
+        }
+        return true;
+    }
+};
+
+Controller* controller{};
+
+// one endpoint with its controller, the interrupt served isr_delay ticks after a buffer is done
+struct Endpoint {
+    Controller ctl;
+    usb::endpoint desc{};
+    usb::usb_endpoint_configuration cfg;
+    std::size_t isr_delay;
+    std::size_t now{};
+    std::size_t last_sent_at{};
+    std::optional<std::size_t> isr_at;
+    std::optional<std::size_t> resume_at;
+    std::size_t callbacks{};
+    // run from cb and from the main loop, resume() 3 ticks after the last cb like a coroutine awaiting it
+    std::function<void()> on_done;
+    std::function<void()> resume;
+
+    Endpoint(bool double_buffered, std::size_t isr_delay)
+        : ctl{double_buffered}
+        , cfg{
+            .descriptor = &desc,
+            .endpoint_control = nullptr,
+            .buffer_control = &ctl.buffer_control,
+            .data_buffer = ctl.dpram,
+            .data_buffer0 = std::span(ctl.dpram).subspan(0, packet_size),
+            .data_buffer1 = double_buffered ? std::span(ctl.dpram).subspan(packet_size) : std::span<std::uint8_t>{},
+        }
+        , isr_delay{isr_delay}
+    {
+        controller = &ctl;
+        desc.descriptor.bEndpointAddress = USB_DIR_IN | 1;
+        desc.descriptor.bmAttributes = USB_TRANSFER_TYPE_BULK;
+        desc.descriptor.wMaxPacketSize = packet_size;
+        desc.double_buffered = double_buffered;
+        desc.cb = [this](std::span<std::uint8_t>) { done(); };
+    }
+
+    Endpoint(Endpoint const&) = delete;
+
+    // what endpoint::send_all does
+    bool send_all(std::span<std::uint8_t const> data) {
+        return usb::start_transfer(cfg, data);
+    }
+
+    void done() {
+        ++callbacks;
+        if (resume) {
+            resume_at = now + 3;
+        }
+        if (on_done) {
+            on_done();
+        }
+    }
+
+    void tick() {
+        ++now;
+        if (ctl.in_token()) {
+            last_sent_at = now;
+            if (not isr_at) {
+                isr_at = now + isr_delay;
+            }
+        }
+        if (isr_at and *isr_at <= now) {
+            isr_at.reset();
+            usb::in_buffer_done(cfg, ctl.last_buffer);
+        }
+        if (resume_at and *resume_at <= now) {
+            resume_at.reset();
+            resume();
+        }
+    }
+
+    // false if cb didn't fire n more times in a reasonable time
+    bool run_until_callbacks(std::size_t n) {
+        auto target = callbacks + n;
+        for (std::size_t i = 0; i < 10'000 and callbacks < target; ++i) {
+            tick();
+        }
+        return callbacks >= target;
+    }
+};
+
+Bytes pattern(std::size_t size, std::uint8_t seed) {
+    Bytes data(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<std::uint8_t>(seed + 7 * i);
+    }
+    return data;
+}
+
+// the packets a transfer of data has to arrive in
+std::vector<Bytes> packets_of(Bytes const& data) {
+    std::vector<Bytes> packets;
+    for (std::size_t i = 0; i < data.size(); i += packet_size) {
+        packets.emplace_back(data.begin() + i, data.begin() + std::min(data.size(), i + packet_size));
+    }
+    if (data.size() % packet_size == 0) {
+        packets.emplace_back();
+    }
+    return packets;
+}
+
+std::vector<Bytes> packets_sent(Controller const& ctl, std::size_t from = 0) {
+    std::vector<Bytes> packets;
+    for (auto i = from; i < ctl.sent.size(); ++i) {
+        packets.push_back(ctl.sent[i].data);
+    }
+    return packets;
+}
+
+void transfers(bool double_buffered, std::size_t isr_delay) {
+    Endpoint ep{double_buffered, isr_delay};
+    std::size_t sent_at_cb{};
+    bool idle_at_cb{};
+    ep.on_done = [&] {
+        sent_at_cb = ep.ctl.sent.size();
+        idle_at_cb = usb::tx_idle(ep.cfg);
+    };
+    bool ok = true;
+    for (std::size_t size : {0, 1, 63, 64, 65, 127, 128, 129, 514, 1024}) {
+        auto data = pattern(size, static_cast<std::uint8_t>(size));
+        auto before = ep.ctl.sent.size();
+        auto calls = ep.callbacks;
+        ok &= sim::check(ep.send_all(data), "a transfer starts once the last one is done");
+        ok &= sim::check(ep.run_until_callbacks(1), "every transfer completes");
+        for (auto i = 0; i < 20; ++i) {
+            ep.tick();
+        }
+        auto packets = packets_sent(ep.ctl, before);
+        ok &= sim::check(packets == packets_of(data), "a transfer arrives whole in full packets and a short last one");
+        ok &= sim::check(size % packet_size != 0 or (not packets.empty() and packets.back().empty()), "a transfer ending on a full packet gets a zero length packet");
+        ok &= sim::check(ep.callbacks == calls + 1, "cb fires exactly once per transfer");
+        ok &= sim::check(sent_at_cb == ep.ctl.sent.size() and idle_at_cb, "after the last packet went out");
+        if (not ok) {
+            std::fprintf(stderr, "  %s buffered, interrupt after %zu ticks, %zu bytes\n", double_buffered ? "double" : "single", isr_delay, size);
+            return;
+        }
+    }
+    for (std::size_t i = 0; i < ep.ctl.sent.size(); ++i) {
+        if (not sim::check(ep.ctl.sent[i].buffer == (double_buffered ? i % 2 : 0), "the buffers alternate")) {
+            std::fprintf(stderr, "  %s buffered, interrupt after %zu ticks, packet %zu\n", double_buffered ? "double" : "single", isr_delay, i);
+            return;
+        }
+    }
+}
+
+// transfers started right from the cb of the last one or by the main loop resumed after it
+void back_to_back(bool double_buffered, bool from_callback) {
+    Endpoint ep{double_buffered, 1};
+    std::vector<Bytes> data;
+    for (std::size_t size : {64, 3, 0, 130, 128, 1, 200, 64}) {
+        data.push_back(pattern(size, static_cast<std::uint8_t>(data.size())));
+    }
+    std::size_t next = 1;
+    auto start_next = [&] {
+        if (next < data.size()) {
+            sim::check(ep.send_all(data[next++]), "the next transfer starts once cb fired");
+        }
+    };
+    if (from_callback) {
+        ep.on_done = start_next;
+    } else {
+        ep.resume = start_next;
+    }
+    sim::check(ep.send_all(data[0]), "the first transfer starts");
+    sim::check(not ep.send_all(data[1]), "a transfer doesn't start while the last one is under way");
+    sim::check(ep.run_until_callbacks(data.size()), "every transfer completes");
+    for (auto i = 0; i < 20; ++i) {
+        ep.tick();
+    }
+    std::vector<Bytes> expected;
+    for (auto const& d : data) {
+        auto packets = packets_of(d);
+        expected.insert(expected.end(), packets.begin(), packets.end());
+    }
+    sim::check(packets_sent(ep.ctl) == expected, "back to back transfers arrive one after the other");
+    sim::check(ep.callbacks == data.size(), "with one cb each");
+}
+
+struct Response {
+    std::size_t last_packet;
+    std::size_t done;
+    std::size_t round_trips;
+};
+
+// the response as one transfer, done is the tick of its cb
+Response as_transfer(bool double_buffered, Bytes const& data) {
+    Endpoint ep{double_buffered, 1};
+    ep.send_all(data);
+    sim::check(ep.run_until_callbacks(1), "the response completes");
+    sim::check(packets_sent(ep.ctl) == packets_of(data), "and arrives whole");
+    return {ep.last_sent_at, ep.now, 1};
+}
+
+// the response handed out a packet at a time, the sender resuming after the cb of the last one
+Response packet_by_packet(bool double_buffered, Bytes const& data) {
+    Endpoint ep{double_buffered, 1};
+    auto expected = packets_of(data);
+    std::size_t next = 0;
+    std::size_t round_trips = 0;
+    Bytes packet;
+    ep.resume = [&] {
+        if (next == expected.size()) {
+            return;
+        }
+        ++round_trips;
+        packet = expected[next++];
+        sim::check(usb::tx_data(ep.cfg, packet) == packet.size(), "a packet fits a free buffer");
+    };
+    ep.resume();
+    sim::check(ep.run_until_callbacks(expected.size()), "the response completes");
+    sim::check(packets_sent(ep.ctl) == expected, "and arrives whole");
+    return {ep.last_sent_at, ep.now, round_trips};
+}
+
+void bench() {
+    auto response = pattern(514, 0);
+    auto print = [](char const* what, Response r) {
+        std::printf("%-34s last packet at tick %3zu, cb at tick %3zu, round trips %zu\n", what, r.last_packet, r.done, r.round_trips);
+    };
+    std::printf("514 byte response, one IN token per tick, interrupt 1 tick after a packet, the sender resumes 3 ticks after cb\n");
+    print("packet by packet, single buffered", packet_by_packet(false, response));
+    print("packet by packet, double buffered", packet_by_packet(true, response));
+    print("send_all, single buffered", as_transfer(false, response));
+    print("send_all, double buffered", as_transfer(true, response));
+}
+
+}
+
+void usb::usb_12_cycle_delay() {
+    controller->settled = controller->buffer_control;
+}
+
+int main(int argc, char** argv) {
+    for (bool double_buffered : {false, true}) {
+        for (std::size_t isr_delay : {0, 1, 3}) {
+            transfers(double_buffered, isr_delay);
+        }
+        back_to_back(double_buffered, true);
+        back_to_back(double_buffered, false);
+    }
+    if (sim::bench_requested(argc, argv)) {
+        bench();
+    }
+    return sim::result("usb_buffer");
+}
@@ -1,9 +1,12 @@
 #include "analog_readings.h"
+#include "protection.h"
 
 #include "cranc/module/Module.h"
 #include "cranc/msg/Message.h"
 
+#include "util/AdcConversion.h"
 #include "util/ScaledNumber.h"
+#include "util/Filters.h"
 
 #include "cranc/config/ApplicationConfig.h"
 
@@ -15,32 +18,78 @@
 #include "misc/gpio_irq_multiplexing.h"
 #include "hardware/gpio.h"
 
+#include <algorithm>
+
 namespace {
 
-cranc::ApplicationConfig<std::array<std::int16_t, 4>> adc_raw_config {"adc.raw",  "4H"};
-cranc::ApplicationConfig<std::array<float, 4>> adc_config {"adc",  "4f"};
+using namespace std::literals::chrono_literals;
 
-cranc::MessageBufferMemory<AnalogReadings, 4> msg_buf;
+using namespace adc;
+
+void update_scales(bool setter);
+
+cranc::ApplicationConfig<std::array<std::int16_t, num_channels>> adc_raw_config {"adc.raw",  "4H"};
+cranc::ApplicationConfig<std::array<float, num_channels>> adc_config {"adc",  "4f"};
+
+cranc::ApplicationConfig<std::array<std::uint8_t, num_channels>> adc_pga {"adc.pga", "4B", update_scales, {
+    default_pga, default_pga, default_pga, default_pga
+}};
+cranc::ApplicationConfig<std::uint8_t> adc_rate {"adc.rate", "B", default_rate};
+// the order in which the channels are sampled, the first entry that is not a valid channel terminates the schedule
+cranc::ApplicationConfig<Schedule> adc_schedule {"adc.schedule", "16B", Schedule{
+    0, 1, 2, 3, schedule_end, schedule_end, schedule_end, schedule_end,
+    schedule_end, schedule_end, schedule_end, schedule_end, schedule_end, schedule_end, schedule_end, schedule_end,
+}};
+cranc::ApplicationConfig<std::array<float, num_channels>> adc_scales {"adc.scale", "4f", {
+    reading_to_value_scale(0, default_pga), reading_to_value_scale(1, default_pga),
+    reading_to_value_scale(2, default_pga), reading_to_value_scale(3, default_pga),
+}};
+
+void update_scales(bool setter) {
+    if (setter) {
+        cranc::LockGuard lock;
+        for (auto i{0U}; i < num_channels; ++i) {
+            (*adc_pga)[i] &= 0b111;
+            (*adc_scales)[i] = reading_to_value_scale(i, (*adc_pga)[i]);
+        }
+    }
+}
 
-using namespace std::literals::chrono_literals;
+// physical units per adc count
+using CountScale = FixedPoint<std::int32_t, 30>;
+using RawCount = ScaledNumber<std::int16_t>;
+using FilteredCount = FixedPoint<std::int32_t, filter_frac_bits>;
+using Milli = ScaledNumber<std::int32_t, std::milli>;
 
-constexpr std::uint8_t i2c_addr = 0b1001'000;
+static_assert(scaled_number_cast<Milli>(RawCount{1000} * CountScale::from_float(reading_to_value_scale(0, default_pga))).val
+              == static_cast<std::int32_t>(1000 * reading_to_value_scale(0, default_pga) * 1000));
 
-constexpr auto rdy_pin = 10;
+constexpr std::size_t max_filter_len = 64;
+using Filter = SampleFilter<max_filter_len>;
 
-constexpr std::array<std::uint8_t, 4> channel_selects {
-    0b1'110'000'1, // OUT_SENSE_0 2
-    0b1'111'000'1, // CUR_SENSE_0 3
-    0b1'101'000'1, // OUT_SENSE_1 1
-    0b1'100'000'1, // CUR_SENSE_1 0
+struct FilterSetting {
+    Filter::Type type;
+    std::uint8_t param; // window length, smoothing shift or decimation factor
 };
 
-constexpr std::array<float, 4> reading_to_value_scales {
-    6.144 / ((1 << 15) - 1) * (91+13)/13,
-    6.144 / ((1 << 15) - 1) / (100 * 5e-3),
-    6.144 / ((1 << 15) - 1) * (91+13)/13,
-    6.144 / ((1 << 15) - 1) / (100 * 5e-3),
-};
+std::array<Filter, num_channels> filters;
+bool filters_dirty{true};
+
+cranc::ApplicationConfig<FilterSetting> adc_filter {"adc.filter", "2B", [](bool setter) {
+    if (setter) {
+        cranc::LockGuard lock;
+        filters_dirty = true;
+    }
+}, {Filter::Type::none, 1}};
+// how many rounds through the schedule are aggregated into one AnalogReadings message
+cranc::ApplicationConfig<std::uint16_t> adc_decimation {"adc.decimation", "H", 1};
+
+cranc::MessageBufferMemory<AnalogReadings, 4> msg_buf;
+cranc::Message<AnalogSample> sample_msg;
+
+constexpr std::uint8_t i2c_addr = 0b1001'000;
+
+constexpr auto rdy_pin = 10;
 
 struct : cranc::Module {
     using cranc::Module::Module;
@@ -59,8 +108,11 @@ struct : cranc::Module {
         cranc::coro::Awaitable<bool> i2cDone;
         auto i2cDoneF = [&i2cDone](bool b) { i2cDone(b); };
 
+        std::uint16_t rounds{};
+
         restart:
         *adc_config = {};
+        filters_dirty = true;
         while (true) {
             co_await cranc::coro::AwaitableDelay{1s};
             {
@@ -103,14 +155,41 @@ struct : cranc::Module {
             }
 
             while (true) {
-
-                for (int i=0; i < 4; ++i) {
+                Schedule schedule;
+                std::uint8_t rate;
+                std::array<std::uint8_t, num_channels> pgas;
+                std::array<float, num_channels> scales;
+                std::array<CountScale, num_channels> count_scales;
+                auto& sample = sample_msg.get().emplace();
+                {
+                    cranc::LockGuard lock;
+                    schedule = *adc_schedule;
+                    rate     = *adc_rate & 0b111;
+                    pgas     = *adc_pga;
+                    scales   = *adc_scales;
+                    if (filters_dirty) {
+                        for (auto& filter : filters) {
+                            filter.reset(adc_filter->type, adc_filter->param);
+                        }
+                        filters_dirty = false;
+                    }
+                }
+                for (auto i{0U}; i < num_channels; ++i) {
+                    count_scales[i] = CountScale::from_float(scales[i]);
+                    sample.milli[i] = rounded_cast<Milli>(RawCount{(*adc_raw_config)[i]} * count_scales[i]);
+                    sample.values[i] = sample.milli[i].to_float();
+                }
+                for (auto channel : sampled_schedule(schedule)) {
+                    if (channel >= num_channels) {
+                        break;
+                    }
                     {
                         I2C::claim(claim);
                         auto i2c = co_await claim;
                         i2c->set_addr(i2c_addr);
                         // trigger a conversion
-                        auto data = std::array<std::uint8_t, 3>{0x01, channel_selects[i], 0b111'0'1'1'00};
+                        auto config = conversion_config(channel, pgas[channel], rate);
+                        auto data = std::array<std::uint8_t, 3>{0x01, config[0], config[1]};
                         i2c->write(data, true);
                         i2c->sync(i2cDoneF);
                         if (not co_await i2cDone) { goto restart; }
@@ -121,7 +200,7 @@ struct : cranc::Module {
 
                     cranc::Timer timeout_timer{[&](int){
                         alert(true);
-                    }, cranc::getSystemTime() + 50ms};
+                    }, cranc::getSystemTime() + conversion_timeout(rate)};
                     
                     if (co_await alert) {
                         goto restart;
@@ -136,10 +215,22 @@ struct : cranc::Module {
                         auto rx_data = std::array<std::uint8_t, 2>{};
                         i2c->read(rx_data, true, i2cDoneF);
                         if (not co_await i2cDone) { goto restart; }
-                        (*adc_raw_config)[i] = (rx_data[0] << 8) | (rx_data[1] << 0);
-                        (*adc_config)[i] = (*adc_raw_config)[i] * reading_to_value_scales[i];
+                        (*adc_raw_config)[channel] = (rx_data[0] << 8) | (rx_data[1] << 0);
+                        protection::check(channel, (*adc_raw_config)[channel], scales[channel]);
+                        sample.milli[channel] = rounded_cast<Milli>(RawCount{(*adc_raw_config)[channel]} * count_scales[channel]);
+                        sample.values[channel] = sample.milli[channel].to_float();
+                        if (auto filtered = filters[channel].push((*adc_raw_config)[channel])) {
+                            (*adc_config)[channel] = rounded_cast<Milli>(FilteredCount{*filtered} * count_scales[channel]).to_float();
+                        }
                     }
                 }
+                sample.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(cranc::getSystemTime()).count();
+                sample_msg.invokeDirectly();
+
+                if (++rounds < *adc_decimation) {
+                    continue;
+                }
+                rounds = 0;
                 auto msg = msg_buf.getFreeMessage(
                     (*adc_config)[0], (*adc_config)[1],
                     (*adc_config)[2], (*adc_config)[3]
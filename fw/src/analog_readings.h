@@ -1,6 +1,18 @@
 #pragma once
 
+#include "util/ScaledNumber.h"
+
+#include <array>
+#include <cstdint>
+
 struct AnalogReadings {
     float u0, i0;
     float u1, i1;
-};
\ No newline at end of file
+};
+
+// one unfiltered round through the adc schedule, dispatched synchronously from the sampling path
+struct AnalogSample {
+    std::uint32_t timestamp_us;
+    std::array<float, 4> values; // u0, i0, u1, i1
+    std::array<ScaledNumber<std::int32_t, std::milli>, 4> milli; // the same in mV and mA
+};
@@ -0,0 +1,106 @@
+#include "capture.h"
+#include "relais.h"
+
+#include "cranc/module/Module.h"
+#include "cranc/msg/Message.h"
+#include "cranc/platform/system.h"
+
+#include "cranc/config/ApplicationConfig.h"
+
+#include "util/TriggeredCapture.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr std::size_t capture_depth = 512;
+constexpr std::size_t chunk_samples = 24;
+
+using Capture = TriggeredCapture<capture::Sample, capture_depth>;
+
+Capture buffer;
+capture::Sample last_sample{};
+bool has_last_sample{};
+
+struct Status {
+    Capture::State state;
+    std::uint16_t trigger_index;
+    std::uint16_t size;
+};
+
+struct Chunk {
+    std::uint16_t offset;
+    std::uint16_t count;
+    std::array<std::uint32_t, chunk_samples> timestamps_us;
+    std::array<float, chunk_samples * 4> values;
+};
+static_assert(sizeof(Chunk) <= 512);
+
+cranc::ApplicationConfig<capture::Trigger> trigger_cfg {"capture.trigger", "BBf", {capture::TriggerMode::manual, 0, 0.f}};
+cranc::ApplicationConfig<std::uint16_t> pre_cfg {"capture.pre", "H", capture_depth / 4};
+
+cranc::ApplicationConfig<void> arm_cfg {"capture.arm", [] {
+    cranc::LockGuard lock;
+    has_last_sample = false;
+    buffer.arm(*pre_cfg);
+}};
+cranc::ApplicationConfig<void> force_cfg {"capture.force", [] {
+    cranc::LockGuard lock;
+    buffer.trigger();
+}};
+
+cranc::ApplicationConfig<Status> status_cfg {"capture.status", "BHH", [](bool setter) {
+    if (not setter) {
+        cranc::LockGuard lock;
+        *status_cfg = {
+            buffer.getState(),
+            static_cast<std::uint16_t>(buffer.trigger_index()),
+            static_cast<std::uint16_t>(buffer.size())
+        };
+    }
+}};
+
+// reading capture.data returns the samples starting at capture.offset, the host moves on by writing the next offset
+// reads have no side effects, so subscriptions and batched reads don't consume the capture
+cranc::ApplicationConfig<std::uint16_t> offset_cfg {"capture.offset", "H", 0};
+cranc::ApplicationConfig<Chunk> data_cfg {"capture.data", "HH24I96f", [](bool setter) {
+    if (setter) {
+        return;
+    }
+    cranc::LockGuard lock;
+    auto& chunk = *data_cfg;
+    std::size_t offset = *offset_cfg;
+    std::size_t count = std::min(chunk_samples, buffer.size() - std::min(offset, buffer.size()));
+    chunk = {};
+    chunk.offset = offset;
+    chunk.count = count;
+    for (auto i{0U}; i < count; ++i) {
+        auto const& sample = buffer[offset + i];
+        chunk.timestamps_us[i] = sample.timestamp_us;
+        std::copy(sample.values.begin(), sample.values.end(), chunk.values.begin() + i * sample.values.size());
+    }
+}};
+
+cranc::Listener<EnableCMD> enable_listener{[](EnableCMD const& cmd) {
+    auto mode = trigger_cfg->mode;
+    if (cmd.channel != trigger_cfg->channel) {
+        return;
+    }
+    if ((cmd.enable and mode == capture::TriggerMode::output_enable) or
+        (not cmd.enable and mode == capture::TriggerMode::output_disable)) {
+        cranc::LockGuard lock;
+        buffer.trigger();
+    }
+}};
+
+cranc::Listener<AnalogSample> sample_listener{[](AnalogSample const& sample) {
+    cranc::LockGuard lock;
+    if (buffer.ready() and has_last_sample and (*trigger_cfg)(last_sample, sample)) {
+        buffer.trigger();
+    }
+    buffer.push(sample);
+    last_sample = sample;
+    has_last_sample = true;
+}};
+
+}
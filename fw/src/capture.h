@@ -0,0 +1,43 @@
+#pragma once
+
+#include "analog_readings.h"
+
+#include <cstdint>
+
+namespace capture {
+
+using Sample = AnalogSample;
+
+enum class TriggerMode : std::uint8_t {
+    manual,
+    above,
+    below,
+    rising_edge,
+    falling_edge,
+    output_enable,
+    output_disable,
+};
+
+struct Trigger {
+    TriggerMode mode;
+    std::uint8_t channel; // index into Sample::values or the output channel for the output modes
+    float threshold;
+
+    // evaluates the sample based trigger modes
+    constexpr bool operator()(Sample const& prev, Sample const& cur) const {
+        if (channel >= cur.values.size()) {
+            return false;
+        }
+        auto p = prev.values[channel];
+        auto c = cur.values[channel];
+        switch (mode) {
+        case TriggerMode::above:        return c > threshold;
+        case TriggerMode::below:        return c < threshold;
+        case TriggerMode::rising_edge:  return p <= threshold and c > threshold;
+        case TriggerMode::falling_edge: return p >= threshold and c < threshold;
+        default:                        return false;
+        }
+    }
+};
+
+}
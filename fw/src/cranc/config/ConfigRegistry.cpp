@@ -0,0 +1,44 @@
+#include "cranc/config/ConfigRegistry.h"
+
+namespace cranc
+{
+
+namespace
+{
+
+ConfigIndex<maxConfigs> registry;
+
+auto& configList() {
+	return util::GloballyLinkedList<ApplicationConfigBase>::getHead();
+}
+
+}
+
+bool freezeConfigs()
+{
+	return registry.freeze(configList());
+}
+
+std::size_t configCount()
+{
+	if (registry.frozen) {
+		return registry.count;
+	}
+	return configList().count();
+}
+
+ApplicationConfigBase* configAt(std::size_t index)
+{
+	if (registry.frozen) {
+		return registry.at(index);
+	}
+	std::size_t i = 0;
+	for (auto& c : configList()) {
+		if (i++ == index) {
+			return &(*c);
+		}
+	}
+	return nullptr;
+}
+
+} /* namespace cranc */
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "cranc/config/ApplicationConfig.h"
+
+#include <array>
+#include <cstdint>
+
+namespace cranc
+{
+
+/*
+ * contiguous snapshot of the globally linked configs
+ * the list is walked once when the configs are frozen, afterwards configs are found by index without iterating
+ */
+template<std::size_t max_configs>
+struct ConfigIndex {
+	std::array<ApplicationConfigBase*, max_configs> table{};
+	std::size_t count{};
+	bool frozen{};
+
+	// fails if there are more configs than fit into the table
+	bool freeze(util::LinkedList<ApplicationConfigBase>& configs) {
+		count = 0;
+		frozen = false;
+		for (auto& c : configs) {
+			if (count == max_configs) {
+				return false;
+			}
+			table[count++] = &(*c);
+		}
+		frozen = true;
+		return true;
+	}
+
+	ApplicationConfigBase* at(std::size_t index) const {
+		return index < count ? table[index] : nullptr;
+	}
+};
+
+// the firmware has less than 100 configs, the host build sets a larger table for its load tests
+#ifndef CRANC_MAX_CONFIGS
+#define CRANC_MAX_CONFIGS 128
+#endif
+constexpr std::size_t maxConfigs = CRANC_MAX_CONFIGS;
+
+// to be called once all modules are initialized, configs constructed afterwards are not indexed
+// returns false if there are more than maxConfigs, the lookups keep walking the list then
+bool freezeConfigs();
+
+// these fall back to walking the list until the configs are frozen
+std::size_t configCount();
+ApplicationConfigBase* configAt(std::size_t index);
+
+} /* namespace cranc */
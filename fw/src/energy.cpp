@@ -0,0 +1,64 @@
+#include "energy.h"
+#include "analog_readings.h"
+
+#include "cranc/module/Module.h"
+#include "cranc/msg/Message.h"
+#include "cranc/platform/system.h"
+
+#include "cranc/config/ApplicationConfig.h"
+
+#include <array>
+
+namespace {
+
+constexpr std::size_t num_channels = 2;
+
+std::array<EnergyIntegrator, num_channels> integrators;
+
+struct Totals {
+    float amp_hours;
+    float watt_hours;
+    float peak_watts;
+    float average_watts;
+    float seconds;
+};
+
+void refresh(std::size_t channel, Totals& totals) {
+    cranc::LockGuard lock;
+    auto const& integrator = integrators[channel];
+    totals = {
+        static_cast<float>(integrator.amp_hours()),
+        static_cast<float>(integrator.watt_hours()),
+        static_cast<float>(integrator.peak_watts()),
+        static_cast<float>(integrator.average_watts()),
+        static_cast<float>(integrator.elapsed_us * 1e-6),
+    };
+}
+
+void reset(std::size_t channel) {
+    cranc::LockGuard lock;
+    integrators[channel].reset();
+}
+
+cranc::ApplicationConfig<Totals> totals_0 {"energy0", "5f", [](bool setter) {
+    if (not setter) {
+        refresh(0, *totals_0);
+    }
+}};
+cranc::ApplicationConfig<Totals> totals_1 {"energy1", "5f", [](bool setter) {
+    if (not setter) {
+        refresh(1, *totals_1);
+    }
+}};
+
+cranc::ApplicationConfig<void> reset_0 {"energy0.reset", [] { reset(0); }};
+cranc::ApplicationConfig<void> reset_1 {"energy1.reset", [] { reset(1); }};
+
+cranc::Listener<AnalogSample> sample_listener{[](AnalogSample const& sample) {
+    cranc::LockGuard lock;
+    for (auto i{0U}; i < num_channels; ++i) {
+        integrators[i].push(sample.timestamp_us, sample.milli[2 * i + 0], sample.milli[2 * i + 1]);
+    }
+}};
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "util/ScaledNumber.h"
+
+#include <cstdint>
+#include <limits>
+
+// trapezoidal integration of charge and energy in fixed point (mV, mA and us)
+struct EnergyIntegrator {
+    // gaps in the sample stream longer than this are not integrated over
+    static constexpr std::uint32_t max_gap_us = 1'000'000;
+    // mA*us resp. mW*us per Ah resp. Wh
+    static constexpr double units_per_hour = 1e3 * 3600e6;
+
+    std::int64_t charge_mA_us{};
+    std::int64_t energy_mW_us{};
+    std::int32_t peak_mW{};
+    std::uint64_t elapsed_us{};
+
+    void reset() {
+        *this = {};
+    }
+
+    void push(std::uint32_t timestamp_us, millivolts u, milliamps i) {
+        std::int32_t mA = i.val;
+        std::int32_t mW = power(u, i).val;
+        if (not primed or (mW > peak_mW)) {
+            peak_mW = mW;
+        }
+        if (primed) {
+            std::uint32_t dt = timestamp_us - last_timestamp_us; // wraps correctly
+            if (dt <= max_gap_us) {
+                saturating_add(charge_mA_us, (static_cast<std::int64_t>(last_mA) + mA) * dt / 2);
+                saturating_add(energy_mW_us, (static_cast<std::int64_t>(last_mW) + mW) * dt / 2);
+                elapsed_us += dt;
+            }
+        }
+        last_timestamp_us = timestamp_us;
+        last_mA = mA;
+        last_mW = mW;
+        primed = true;
+    }
+
+    double amp_hours() const {
+        return charge_mA_us / units_per_hour;
+    }
+
+    double watt_hours() const {
+        return energy_mW_us / units_per_hour;
+    }
+
+    double peak_watts() const {
+        return peak_mW * 1e-3;
+    }
+
+    double average_watts() const {
+        if (elapsed_us == 0) {
+            return 0;
+        }
+        return (static_cast<double>(energy_mW_us) / elapsed_us) * 1e-3;
+    }
+
+private:
+    static void saturating_add(std::int64_t& acc, std::int64_t v) {
+        if (__builtin_add_overflow(acc, v, &acc)) {
+            acc = v > 0 ? std::numeric_limits<std::int64_t>::max() : std::numeric_limits<std::int64_t>::min();
+        }
+    }
+
+    std::uint32_t last_timestamp_us{};
+    std::int32_t last_mA{};
+    std::int32_t last_mW{};
+    bool primed{};
+};
@@ -87,7 +87,7 @@ struct Controller {
 
     Controller(std::uint8_t idx, std::uint8_t pin) 
     : cdc{name, std::uint8_t(USB_DIR_OUT|idx2ep(idx)), std::uint8_t(USB_DIR_IN|idx2ep(idx)), std::uint8_t(USB_DIR_IN|(idx2ep(idx)+1)), 
-        [this](auto data){ on_rx_data(data); }, 
+        [this](auto data){ on_rx_data(data); return true; }, 
         [this] {}
     }
     {
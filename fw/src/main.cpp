@@ -1,6 +1,7 @@
 
 #include "cranc/msg/MessagePump.h"
 #include "cranc/module/Module.h"
+#include "cranc/config/ConfigRegistry.h"
 #include "cranc/timer/ISRTime.h"
 
 #include "pico/stdlib.h"
@@ -12,6 +13,8 @@ int main() {
 	stdio_init_all();
 	timer_hw->dbgpause = 0x0;
 	cranc::InitializeModules();
+	// with too many configs the lookups keep walking the list, slower but complete
+	cranc::freezeConfigs();
 
 	auto& msgPump = cranc::MessagePump::get();
 	while (true) {
@@ -0,0 +1,325 @@
+#include "ConfigProtocol.h"
+
+#include "cranc/config/ConfigRegistry.h"
+
+#include "util/Hash.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace config_protocol {
+
+namespace {
+
+// writes the op_describe record of a config, returns its size or 0 if it doesn't fit
+std::size_t describe(cranc::ApplicationConfigBase const& config, std::span<std::uint8_t> out) {
+	auto name = config.getName();
+	auto format = config.getFormat();
+	std::uint16_t size = config.getSize();
+	auto record_size = sizeof(size) + 2 + name.size() + format.size();
+	if (record_size > out.size()) {
+		return 0;
+	}
+	std::size_t pos = 0;
+	std::memcpy(out.data() + pos, &size, sizeof(size));
+	pos += sizeof(size);
+	out[pos++] = name.size();
+	std::memcpy(out.data() + pos, name.data(), name.size());
+	pos += name.size();
+	out[pos++] = format.size();
+	std::memcpy(out.data() + pos, format.data(), format.size());
+	return record_size;
+}
+
+/*
+ * the descriptions of all configs in one blob so the host can enumerate them in a few transfers
+ * and skip that entirely if it already knows the hash
+ */
+struct SchemaHeader {
+	std::uint32_t hash;   // over the records
+	std::uint16_t size;   // of the records
+	std::uint16_t count;
+};
+std::array<std::uint8_t, 4096> schema;
+std::size_t schema_size{};
+
+// the configs are frozen by the time the host asks, so the blob is built once
+std::span<const std::uint8_t> build_schema() {
+	if (schema_size == 0) {
+		auto records = std::span{schema}.subspan(sizeof(SchemaHeader));
+		std::size_t pos = 0;
+		for (std::size_t i = 0; i < cranc::configCount(); ++i) {
+			auto written = describe(*cranc::configAt(i), records.subspan(pos));
+			if (written == 0) {
+				return {};
+			}
+			pos += written;
+		}
+		SchemaHeader header{
+			.hash  = hash_str({reinterpret_cast<char const*>(records.data()), pos}),
+			.size  = static_cast<std::uint16_t>(pos),
+			.count = static_cast<std::uint16_t>(cranc::configCount()),
+		};
+		std::memcpy(schema.data(), &header, sizeof(header));
+		schema_size = sizeof(header) + pos;
+	}
+	return {schema.data(), schema_size};
+}
+
+std::uint16_t read_u16(std::span<const std::uint8_t> data, std::size_t pos) {
+	std::uint16_t v;
+	std::memcpy(&v, data.data() + pos, sizeof(v));
+	return v;
+}
+
+}
+
+std::size_t Engine::receive(std::span<const std::uint8_t> data) {
+	auto n = std::min(data.size(), rx.raw.size() - received);
+	if (n == 0) {
+		return 0;
+	}
+	std::memcpy(rx.raw.data() + received, data.data(), n);
+	received += n;
+	return n;
+}
+
+Engine::State Engine::state() const {
+	auto need = required_length();
+	if (need == 0) {
+		return State::malformed;
+	}
+	return need <= received ? State::complete : State::incomplete;
+}
+
+void Engine::reset() {
+	received = 0;
+}
+
+std::span<const std::uint8_t> Engine::reject() {
+	reset();
+	tx.size = rejected;
+	return {tx.raw.data(), sizeof(tx.size)};
+}
+
+std::size_t Engine::required_length() const {
+	if (received < sizeof(rx.operation)) {
+		return sizeof(rx.operation);
+	}
+	if (rx.operation == op_count) {
+		return sizeof(rx.operation);
+	}
+	if (rx.operation > op_schema) {
+		return 0;
+	}
+	if (received < header_size) {
+		return header_size;
+	}
+
+	std::span<const std::uint8_t> buffered{rx.raw.data(), received};
+	std::size_t need = header_size;
+	switch (rx.operation) {
+	case op_size:
+	case op_name:
+	case op_format:
+	case op_get:
+		return cranc::configAt(rx.index) ? need : 0;
+	case op_set: {
+		auto cfg = cranc::configAt(rx.index);
+		need = cfg ? need + cfg->getSize() : 0;
+		break;
+	}
+	case op_subscribe:
+		need = cranc::configAt(rx.index) ? need + sizeof(std::uint32_t) : 0;
+		break;
+	case op_get_many:
+	case op_set_many: {
+		need += sizeof(std::uint16_t);
+		if (received < need) {
+			return need;
+		}
+		auto count = read_u16(buffered, header_size);
+		if (rx.operation == op_get_many) {
+			need += count * sizeof(std::uint16_t);
+			break;
+		}
+		for (auto i{0U}; i < count and need <= rx.raw.size(); ++i) {
+			need += sizeof(std::uint16_t);
+			// a request that can't fit is malformed even before all of it arrived
+			if (received < need) {
+				break;
+			}
+			auto cfg = cranc::configAt(read_u16(buffered, need - sizeof(std::uint16_t)));
+			if (not cfg) {
+				return 0;
+			}
+			need += cfg->getSize();
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	return need <= rx.raw.size() ? need : 0;
+}
+
+std::span<const std::uint8_t> Engine::respond(std::size_t size) {
+	tx.size = size;
+	return {tx.raw.data(), sizeof(tx.size) + size};
+}
+
+template<typename T>
+std::span<const std::uint8_t> Engine::respond_with(T const& value) {
+	static_assert(sizeof(value) <= sizeof(tx.payload));
+	std::memcpy(tx.payload.data(), &value, sizeof(value));
+	return respond(sizeof(value));
+}
+
+std::span<const std::uint8_t> Engine::respond_with(std::span<const std::uint8_t> data) {
+	// configs without a value have no data pointer at all
+	auto n = std::min(data.size(), tx.payload.size());
+	if (n != 0) {
+		std::memcpy(tx.payload.data(), data.data(), n);
+	}
+	return respond(n);
+}
+
+std::span<const std::uint8_t> Engine::execute() {
+	auto length = required_length();
+	if (length == 0 or length > received) {
+		return {};
+	}
+	std::span<const std::uint8_t> response{};
+	auto& payload = tx.payload;
+
+	switch (rx.operation) {
+	case op_count:
+		response = respond_with(static_cast<std::uint16_t>(cranc::configCount()));
+		break;
+	case op_size:
+		response = respond_with(static_cast<std::uint16_t>(cranc::configAt(rx.index)->getSize()));
+		break;
+	case op_name: {
+		auto name = cranc::configAt(rx.index)->getName();
+		response = respond_with(std::span{reinterpret_cast<std::uint8_t const*>(name.data()), name.size()});
+		break;
+	}
+	case op_format: {
+		auto format = cranc::configAt(rx.index)->getFormat();
+		response = respond_with(std::span{reinterpret_cast<std::uint8_t const*>(format.data()), format.size()});
+		break;
+	}
+	case op_get:
+		response = respond_with(cranc::configAt(rx.index)->getValue());
+		break;
+	case op_set: {
+		auto cfg = cranc::configAt(rx.index);
+		cfg->setValue({rx.payload.data(), cfg->getSize()});
+		response = respond(0);
+		break;
+	}
+	case op_subscribe: {
+		std::uint32_t interval_us;
+		std::memcpy(&interval_us, rx.payload.data(), sizeof(interval_us));
+		std::uint8_t ok = subscriptions and subscriptions->subscribe(rx.index, cranc::configAt(rx.index)->getSize(), interval_us);
+		response = respond_with(ok);
+		break;
+	}
+	case op_unsubscribe:
+		if (subscriptions) {
+			subscriptions->unsubscribe(rx.index);
+		}
+		response = respond(0);
+		break;
+	case op_get_many:
+	case op_set_many: {
+		std::span<const std::uint8_t> request{rx.payload.data(), length - header_size};
+		auto count = read_u16(request, 0);
+		std::size_t in = sizeof(count);
+		std::size_t out = sizeof(count);
+		std::uint16_t done = 0;
+		for (; done < count; ++done) {
+			auto cfg = cranc::configAt(read_u16(request, in));
+			in += sizeof(std::uint16_t);
+			if (not cfg) {
+				break;
+			}
+			if (rx.operation == op_get_many) {
+				auto value = cfg->getValue();
+				if (out + value.size() > payload.size()) {
+					break;
+				}
+				if (not value.empty()) {
+					std::memcpy(payload.data() + out, value.data(), value.size());
+				}
+				out += value.size();
+			} else {
+				cfg->setValue(request.subspan(in, cfg->getSize()));
+				in += cfg->getSize();
+			}
+		}
+		std::memcpy(payload.data(), &done, sizeof(done));
+		response = respond(rx.operation == op_get_many ? out : sizeof(done));
+		break;
+	}
+	case op_describe: {
+		std::size_t out = 0;
+		for (std::size_t i = rx.index; i < cranc::configCount(); ++i) {
+			auto written = describe(*cranc::configAt(i), std::span{payload}.subspan(out));
+			if (written == 0) {
+				break;
+			}
+			out += written;
+		}
+		response = respond(out);
+		break;
+	}
+	case op_schema: {
+		auto blob = build_schema();
+		auto offset = std::min<std::size_t>(rx.index * payload.size(), blob.size());
+		response = respond_with(blob.subspan(offset, std::min(blob.size() - offset, payload.size())));
+		break;
+	}
+	}
+
+	// keep what was sent after this request
+	std::memmove(rx.raw.data(), rx.raw.data() + length, received - length);
+	received -= length;
+	return response;
+}
+
+void PacketReceiver::received(std::span<const std::uint8_t> data) {
+	packet = data;
+	ends_transfer = data.size() < max_packet_size;
+}
+
+std::span<const std::uint8_t> PacketReceiver::next() {
+	if (discarding) {
+		discarding = not ends_transfer;
+		packet = {};
+		return {};
+	}
+	packet = packet.subspan(engine.receive(packet));
+	switch (engine.state()) {
+	case Engine::State::complete:
+		return engine.execute();
+	case Engine::State::malformed:
+		discarding = not ends_transfer;
+		packet = {};
+		return engine.reject();
+	case Engine::State::incomplete:
+		break;
+	}
+	// an incomplete request always fits, so the engine took all of the packet
+	assert(packet.empty());
+	return {};
+}
+
+void PacketReceiver::reset() {
+	engine.reset();
+	packet = {};
+	discarding = false;
+}
+
+}
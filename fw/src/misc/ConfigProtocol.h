@@ -0,0 +1,120 @@
+#pragma once
+
+#include "util/Subscriptions.h"
+
+#include <array>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * the request/response protocol to access the configs, independent of the transport carrying it
+ * a request is {u8 operation, u16 index, payload}, a response is {u16 size, payload}, both little endian
+ * stream transports send requests back to back, the length of a request follows from its operation and the configs it names
+ * a malformed request (unknown operation or config, longer than max_payload) is answered with the size `rejected` and
+ * no payload, the rest of the transfer it came in is dropped
+ */
+
+namespace config_protocol {
+
+enum Operation : std::uint8_t {
+	op_count       = 0,
+	op_size        = 1,
+	op_name        = 2,
+	op_format      = 3,
+	op_get         = 4,
+	op_set         = 5,
+	op_subscribe   = 6, // payload: u32 minimal interval in us, responds with a u8 success flag
+	op_unsubscribe = 7, // index 0xffff drops all subscriptions
+	op_get_many    = 8, // payload: u16 n, u16 indices[n]; responds with u16 k followed by the values of the first k
+	op_set_many    = 9, // payload: u16 n, n times {u16 index, value}; responds with the u16 count of values set
+	op_describe    = 10, // responds with {u16 size, u8 len, name, u8 len, format} of the configs starting at index
+	op_schema      = 11, // responds with the chunk at index of the schema blob, empty past its end
+};
+
+constexpr std::size_t max_payload = 512;
+constexpr std::size_t header_size = sizeof(std::uint8_t) + sizeof(std::uint16_t);
+constexpr std::uint16_t rejected = 0xffff;
+
+using Subscriptions = SubscriptionTable<16, 64>;
+
+struct Engine {
+	enum class State : std::uint8_t {
+		incomplete,
+		complete,
+		malformed, // the transport has to drop what it buffered and resynchronize
+	};
+
+	// buffers received bytes, returns how many fit
+	std::size_t receive(std::span<const std::uint8_t> data);
+
+	State state() const;
+
+	// runs the complete request at the front and returns the framed response, valid until the next call
+	// returns an empty span if there is no complete request
+	// has to be called from the main loop with the configs locked
+	std::span<const std::uint8_t> execute();
+
+	// drops what was buffered and returns the framed response to a malformed request
+	std::span<const std::uint8_t> reject();
+
+	void reset();
+
+	// subscriptions are only available on transports that can push the notifications
+	Subscriptions* subscriptions{};
+
+private:
+	union {
+		struct __attribute__((packed)) {
+			std::uint8_t operation;
+			std::uint16_t index;
+			std::array<std::uint8_t, max_payload> payload;
+		};
+		std::array<std::uint8_t, header_size + max_payload> raw;
+	} rx;
+	std::size_t received{};
+
+	union {
+		struct __attribute__((packed)) {
+			std::uint16_t size;
+			std::array<std::uint8_t, max_payload> payload;
+		};
+		std::array<std::uint8_t, sizeof(size) + max_payload> raw;
+	} tx;
+
+	// the length of the request at the front as far as it is known from the bytes received so far, 0 if it is malformed
+	std::size_t required_length() const;
+
+	std::span<const std::uint8_t> respond(std::size_t size);
+	template<typename T>
+	std::span<const std::uint8_t> respond_with(T const& value);
+	std::span<const std::uint8_t> respond_with(std::span<const std::uint8_t> data);
+};
+
+/*
+ * feeds the packets of an endpoint into an engine with back-pressure: the endpoint is only armed again once the whole
+ * packet went into the engine, which executes requests to make room for the rest of it
+ * after a rejected request the packets up to the end of its transfer (a short packet) are dropped
+ */
+struct PacketReceiver {
+	PacketReceiver(Engine& engine, std::size_t max_packet_size) : engine{engine}, max_packet_size{max_packet_size} {}
+
+	Engine& engine;
+	std::size_t max_packet_size;
+
+	// from the receive callback, the packet has to stay valid until next() returned an empty span
+	void received(std::span<const std::uint8_t> data);
+
+	// the next response to send, empty once the packet is consumed and the endpoint can be armed again
+	// has to be called from the main loop with the configs locked
+	std::span<const std::uint8_t> next();
+
+	void reset();
+
+private:
+	std::span<const std::uint8_t> packet;
+	bool ends_transfer{};
+	bool discarding{};
+};
+
+}
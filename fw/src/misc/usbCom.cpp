@@ -4,9 +4,10 @@
 #include "cranc/coro/Task.h"
 #include "cranc/coro/SwitchToMainLoop.h"
 #include "cranc/platform/system.h"
-#include "cranc/config/ApplicationConfig.h"
+#include "cranc/config/ConfigRegistry.h"
+#include "cranc/timer/systemTime.h"
 
-#include "util/Finally.h"
+#include "ConfigProtocol.h"
 
 #include <string.h>
 #include <cstring>
@@ -22,58 +23,28 @@ using namespace usb::literals;
 
 auto interface_name = "general interface"_usb_str;
 
+using namespace std::literals::chrono_literals;
+
 cranc::coro::Task<void> worker_task;
+cranc::coro::Task<void> notifier_task;
 cranc::coro::Awaitable<void, cranc::LockGuard> usb_rx;
 cranc::coro::Awaitable<void, cranc::LockGuard> usb_tx_done;
-
-
-
-template<typename T>
-concept is_container = requires(T v) { 
-    { v.begin() };
-    { v.size() }; 
+cranc::coro::Awaitable<void, cranc::LockGuard> usb_notify_done;
+
+constexpr auto notify_period = 1ms;
+config_protocol::Subscriptions subscriptions;
+config_protocol::Engine engine;
+config_protocol::PacketReceiver receiver{engine, 64};
+
+// changes are streamed as records of this header followed by the value
+struct NotificationHeader {
+	std::uint16_t index;
+	std::uint16_t size;
+	std::uint32_t timestamp_us;
 };
+std::array<std::uint8_t, 512> notify_buffer;
 
-union  {
-	struct __attribute__((packed)) {
-		std::uint8_t operation;
-		std::uint16_t index;
-		std::array<std::uint8_t, 512> payload;	
-	};
-	std::array<std::uint8_t, sizeof(operation)+sizeof(index)+sizeof(payload)> raw;
-} rx_buffer;
-
-union  {
-	struct __attribute__((packed)) {
-		std::uint16_t size;
-		std::array<std::uint8_t, 512> payload;	
-	};
-	std::array<std::uint8_t, sizeof(size)+sizeof(payload)> raw;
-
-	std::span<const std::uint8_t> fill(auto const& data) {
-		if constexpr ( requires {data.begin(); data.end(); data.size();}) {
-			assert(data.size() <= payload.size());
-			std::memcpy(payload.data(), data.data(), data.size());
-			size = data.size();
-			return {raw.data(), size+sizeof(size)};
-		} else {
-			static_assert(sizeof(data) <= sizeof(payload));
-			std::memcpy(payload.data(), &data, sizeof(data));
-			size = sizeof(data);
-			return {raw.data(), size+sizeof(size)};
-		}
-	}
-
-	std::span<const std::uint8_t> fill() {
-		size = 0;
-		return {raw.data(), size+sizeof(size)};
-	}
-} tx_buffer;
-
-std::span<std::uint8_t> rx_buffer_view_free{rx_buffer.raw};
-std::span<std::uint8_t> rx_buffer_view_received{rx_buffer.raw.data(), 0};
-
-std::array<usb::endpoint, 2> eps  = {
+std::array<usb::endpoint, 3> eps  = {
     usb::endpoint{
         .descriptor = {
             .bEndpointAddress = USB_DIR_OUT | 1,
@@ -83,12 +54,7 @@ std::array<usb::endpoint, 2> eps  = {
         },
         .double_buffered = false,
         .cb = [](std::span<std::uint8_t> data) {
-			if (data.size() > rx_buffer_view_free.size()) {
-				return;
-			}
-			std::memcpy(rx_buffer_view_free.data(), data.data(), data.size());
-			rx_buffer_view_free = rx_buffer_view_free.subspan(data.size());
-			rx_buffer_view_received = {rx_buffer.raw.data(), static_cast<std::size_t>(rx_buffer_view_free.data() - rx_buffer.raw.data())};
+			receiver.received(data);
 			usb_rx();
 		},
     },
@@ -99,14 +65,27 @@ std::array<usb::endpoint, 2> eps  = {
             .wMaxPacketSize = 64,
             .bInterval = 1,
         },
-        .double_buffered = false,
+        .double_buffered = true,
         .cb = [](std::span<std::uint8_t>){ 
 			usb_tx_done(); 
 		},
     },
+    usb::endpoint{
+        .descriptor = {
+            .bEndpointAddress = USB_DIR_IN | 2,
+            .bmAttributes = USB_TRANSFER_TYPE_BULK,
+            .wMaxPacketSize = 64,
+            .bInterval = 1,
+        },
+        .double_buffered = true,
+        .cb = [](std::span<std::uint8_t>){
+			usb_notify_done();
+		},
+    },
 };
 auto& ep_out = eps[0];
 auto& ep_in = eps[1];
+auto& ep_notify = eps[2];
 
 std::array<usb::usb_iface_setting, 1> iface_settings {
     usb::usb_iface_setting{
@@ -125,78 +104,69 @@ usb::Interface iface {
     iface_settings
 };
 
-std::span<const std::uint8_t> response{};
+cranc::coro::Task<void> notifier() {
+	cranc::coro::SwitchToMainLoop sw2main;
+	cranc::coro::AwaitableDelay ticker{cranc::getSystemTime() + notify_period, notify_period};
+	while (true) {
+		co_await ticker;
+		co_await sw2main;
+		if (subscriptions.empty()) {
+			continue;
+		}
+
+		std::size_t fill = 0;
+		{
+			cranc::LockGuard lock;
+			std::uint32_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(cranc::getSystemTime()).count();
+			auto fetch = [](std::uint16_t index) -> std::span<std::uint8_t const> {
+				auto cfg = cranc::configAt(index);
+				if (not cfg) {
+					return {};
+				}
+				return cfg->getValue();
+			};
+			auto emit = [&](std::uint16_t index, std::uint32_t timestamp_us, std::span<std::uint8_t const> value) {
+				NotificationHeader header{index, static_cast<std::uint16_t>(value.size()), timestamp_us};
+				if (fill + sizeof(header) + value.size() > notify_buffer.size()) {
+					return false;
+				}
+				std::memcpy(notify_buffer.data() + fill, &header, sizeof(header));
+				std::memcpy(notify_buffer.data() + fill + sizeof(header), value.data(), value.size());
+				fill += sizeof(header) + value.size();
+				return true;
+			};
+			subscriptions.poll(now_us, fetch, emit);
+		}
+
+		// the host reads the records as a stream, the pending ones wait until it picked up the last batch
+		if (fill != 0) {
+			usb_notify_done.clear();
+			ep_notify.send_all({notify_buffer.data(), fill});
+			co_await usb_notify_done;
+		}
+	}
+}
 
 cranc::coro::Task<void> worker() {
-	auto& configs = cranc::util::GloballyLinkedList<cranc::ApplicationConfigBase>::getHead();
 	cranc::coro::SwitchToMainLoop sw2main;
-	rx_buffer_view_free = rx_buffer.raw;
 	while (true) {
 		usb_rx.clear();
 		ep_out.start_rx();
 		co_await usb_rx;
+		co_await sw2main;
 
-		if (rx_buffer_view_received.size() == 0) {
-			co_return;
-		}
-
-		if (rx_buffer.operation == 0) {
-			std::uint16_t count = 0;
-			for ([[maybe_unused]] auto const& c : configs) {
-				++count;
-			}
-			response = tx_buffer.fill(count);
-		} else {
-			constexpr auto header_size = sizeof(rx_buffer.operation) +  sizeof(rx_buffer.index);
-			if (rx_buffer_view_received.size() < header_size) {
-				co_return;
-			}
-			auto it = configs.begin();
-			auto end = configs.end();
-			for (auto i{0}; (i < rx_buffer.index) and (it != end); ++i, ++it) {}
-			if (it == end) {
-				co_return;
-			}
-			auto& tgt = *it;
-
-			if (rx_buffer.operation == 1) {
-				std::uint16_t size = tgt->getSize();
-				response = tx_buffer.fill(size);
-			}
-			if (rx_buffer.operation == 2) {
-				response = tx_buffer.fill(tgt->getName());
-			}
-			if (rx_buffer.operation == 3) {
-				response = tx_buffer.fill(tgt->getFormat());
-			}
-			if (rx_buffer.operation == 4) {
-				co_await sw2main;
+		// a packet may complete several requests, the endpoint stays disarmed until all of it is consumed
+		while (true) {
+			std::span<const std::uint8_t> response;
+			{
 				cranc::LockGuard lock;
-				response = tx_buffer.fill(tgt->getValue());
+				response = receiver.next();
 			}
-			if (rx_buffer.operation == 5) {
-				auto payload_len = tgt->getSize();
-				if (rx_buffer.payload.size() < payload_len) {
-					co_return;
-				}
-				while (rx_buffer_view_received.size() < header_size + payload_len) {
-					ep_out.start_rx();
-					co_await usb_rx;
-				}
-				co_await sw2main;
-				cranc::LockGuard lock;
-				tgt->setValue(std::span<std::uint8_t>{rx_buffer.payload.data(), payload_len});
-				response = tx_buffer.fill();
+			if (response.empty()) {
+				break;
 			}
-		}
-
-		rx_buffer_view_free = rx_buffer.raw;
-		rx_buffer_view_received = {rx_buffer.raw.data(), 0};
-
-		while (not response.empty()) {
 			usb_tx_done.clear();
-			auto sent = ep_in.send(response);
-			response = response.subspan(sent);
+			ep_in.send_all(response);
 			co_await usb_tx_done;
 		}
 	}
@@ -207,13 +177,18 @@ struct USBComModule : cranc::Module {
 	using cranc::Module::Module;
 
 	void init() override {
+		engine.subscriptions = &subscriptions;
         iface.on_altsetting_changed = []() {
 			cranc::LockGuard lock;
 			worker_task.terminate();
+			notifier_task.terminate();
+			receiver.reset();
+			subscriptions.unsubscribe(decltype(subscriptions)::no_index);
             if (not iface.cur_active_altsetting.has_value()) {
                 return;
             }
 			worker_task = worker();
+			notifier_task = notifier();
 		};
 	}
 
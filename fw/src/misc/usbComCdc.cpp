@@ -0,0 +1,73 @@
+#include "cranc/module/Module.h"
+#include "cranc/coro/Awaitable.h"
+#include "cranc/coro/Task.h"
+#include "cranc/coro/SwitchToMainLoop.h"
+#include "cranc/platform/system.h"
+
+#include "misc/usb_cdc.h"
+#include "ConfigProtocol.h"
+
+/*
+ * the config protocol over a cdc serial port for hosts without libusb, requests and responses are framed as on the bulk interface
+ * there are no subscriptions as a serial port has no second stream to push them on
+ */
+
+namespace
+{
+
+using namespace usb::literals;
+
+auto interface_name = "config serial"_usb_str;
+
+cranc::coro::Task<void> worker_task;
+cranc::coro::Awaitable<void, cranc::LockGuard> cdc_rx;
+cranc::coro::Awaitable<void, cranc::LockGuard> cdc_tx_done;
+
+config_protocol::Engine engine;
+config_protocol::PacketReceiver receiver{engine, 64};
+
+USB_CDC_Device cdc{interface_name, USB_DIR_OUT | 4, USB_DIR_IN | 4, USB_DIR_IN | 7,
+	[](std::span<std::uint8_t const> data) {
+		receiver.received(data);
+		cdc_rx();
+		return false;
+	},
+	[] {
+		cdc_tx_done();
+	}
+};
+
+cranc::coro::Task<void> worker() {
+	cranc::coro::SwitchToMainLoop sw2main;
+	while (true) {
+		co_await cdc_rx;
+		cdc_rx.clear();
+		co_await sw2main;
+
+		// the port stays held until the engine took the whole packet
+		while (true) {
+			std::span<const std::uint8_t> response;
+			{
+				cranc::LockGuard lock;
+				response = receiver.next();
+			}
+			if (response.empty()) {
+				break;
+			}
+			cdc_tx_done.clear();
+			cdc.send_all(response);
+			co_await cdc_tx_done;
+		}
+		cdc.resume_rx();
+	}
+}
+
+struct : cranc::Module {
+	using cranc::Module::Module;
+
+	void init() override {
+		worker_task = worker();
+	}
+} _{1000};
+
+}
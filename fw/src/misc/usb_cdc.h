@@ -8,7 +8,8 @@
 
 
 struct USB_CDC_Device {
-    using rx_cb      = cranc::function<void(std::span<std::uint8_t const>)>;
+    // returning false holds the endpoint, nothing more is received until resume_rx()
+    using rx_cb      = cranc::function<bool(std::span<std::uint8_t const>)>;
     using tx_done_cb = cranc::function<void()>;
     USB_CDC_Device(usb::USB_String& name, std::uint8_t data_ep_out, std::uint8_t data_ep_in, std::uint8_t notif_ep, rx_cb on_rx, tx_done_cb on_tx_done);
 
@@ -33,6 +34,21 @@ struct USB_CDC_Device {
         }
         return transfer_eps[1].send({reinterpret_cast<std::uint8_t const*>(&(out[0])), out.size()});
     }
+    // arms the endpoint after on_rx held it, the data it got is invalid from then on
+    void resume_rx() {
+        if (active) {
+            transfer_eps[0].start_rx();
+        }
+    }
+
+    // the whole buffer as one transfer, on_tx_done is called once it is through
+    bool send_all(std::span<std::uint8_t const> out) {
+        if (not active) {
+            on_tx_done();
+            return true;
+        }
+        return transfer_eps[1].send_all(out);
+    }
 
 private:
     struct __attribute__((packed)) {
@@ -55,8 +71,9 @@ private:
             },
             .double_buffered = false,
             .cb = [this](std::span<std::uint8_t> data) {
-                on_rx(data);
-                transfer_eps[0].start_rx();
+                if (on_rx(data)) {
+                    transfer_eps[0].start_rx();
+                }
             }
         },
         usb::endpoint{ // in ep
@@ -65,7 +82,7 @@ private:
                 .wMaxPacketSize = 64,
                 .bInterval = 0,
             },
-            .double_buffered = false,
+            .double_buffered = true,
             .cb = [this](std::span<std::uint8_t>) {
                 on_tx_done();
             }
@@ -4,17 +4,29 @@
 #include "cranc/msg/Message.h"
 
 #include "cranc/config/ApplicationConfig.h"
+#include "cranc/timer/ISRTime.h"
 #include "persistent_config/PersistentConfig.h"
+#include "util/Correction.h"
+#include "util/ScaledNumber.h"
+#include "util/Dither.h"
+#include "util/PwmCommit.h"
 
 #include <hardware/clocks.h>
 #include <hardware/pwm.h>
 #include <hardware/gpio.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+
+#include <algorithm>
+#include <optional>
+#include <utility>
 
 namespace {
 
 constexpr std::uint32_t pwm_frequency_hz  = 20'000;
 
 void update_pwm_vals(bool setter);
+void update_raw_vals(bool setter);
 void update_vals(bool setter);
 void update_everything(bool setter);
 
@@ -22,11 +34,15 @@ cranc::MessageBufferMemory<OutputSetpoint, 4> msg_buf;
 
 cranc::ApplicationConfig<std::uint32_t> cfg_feq{ "out.pwm_freq", "I", update_everything, pwm_frequency_hz};
 
+// the compare levels are dithered over 2^n pwm periods to gain n bits of resolution, 0 disables dithering
+constexpr std::uint8_t max_dither_bits = 6;
+cranc::ApplicationConfig<std::uint8_t> cfg_dither{ "out.dither", "B", update_everything, 0};
+
 std::array raw_cfgs = {
-    cranc::ApplicationConfig<std::uint16_t>{ "vout0.raw", "H", update_pwm_vals, 0},
-    cranc::ApplicationConfig<std::uint16_t>{ "iout0.raw", "H", update_pwm_vals, 0},
-    cranc::ApplicationConfig<std::uint16_t>{ "vout1.raw", "H", update_pwm_vals, 0},
-    cranc::ApplicationConfig<std::uint16_t>{ "iout1.raw", "H", update_pwm_vals, 0},
+    cranc::ApplicationConfig<std::uint16_t>{ "vout0.raw", "H", update_raw_vals, 0},
+    cranc::ApplicationConfig<std::uint16_t>{ "iout0.raw", "H", update_raw_vals, 0},
+    cranc::ApplicationConfig<std::uint16_t>{ "vout1.raw", "H", update_raw_vals, 0},
+    cranc::ApplicationConfig<std::uint16_t>{ "iout1.raw", "H", update_raw_vals, 0},
 };
 
 
@@ -37,31 +53,58 @@ std::array flt_cfgs = {
     cranc::ApplicationConfig<float>{ "iout1", "f", update_vals, 0},
 };
 
+void update_corrections(bool setter);
+
+// the linear part keeps its name and format so calibrations stored in flash stay valid
 using correction_polynomial = std::array<float, 2>;
 std::array correction_polynomials = {
-    cranc::ApplicationConfig<correction_polynomial>{ "corr.vout0", "2f", {0, 1}},
-    cranc::ApplicationConfig<correction_polynomial>{ "corr.iout0", "2f", {0, 1}},
-    cranc::ApplicationConfig<correction_polynomial>{ "corr.vout1", "2f", {0, 1}},
-    cranc::ApplicationConfig<correction_polynomial>{ "corr.iout1", "2f", {0, 1}},
+    cranc::ApplicationConfig<correction_polynomial>{ "corr.vout0", "2f", update_corrections, {0, 1}},
+    cranc::ApplicationConfig<correction_polynomial>{ "corr.iout0", "2f", update_corrections, {0, 1}},
+    cranc::ApplicationConfig<correction_polynomial>{ "corr.vout1", "2f", update_corrections, {0, 1}},
+    cranc::ApplicationConfig<correction_polynomial>{ "corr.iout1", "2f", update_corrections, {0, 1}},
+};
+
+// the coefficients of x^2 and up
+constexpr std::size_t correction_order = 4;
+using higher_order_terms = std::array<float, correction_order - 2>;
+std::array correction_higher_orders = {
+    cranc::ApplicationConfig<higher_order_terms>{ "corr.vout0.hi", "2f", update_corrections, {}},
+    cranc::ApplicationConfig<higher_order_terms>{ "corr.iout0.hi", "2f", update_corrections, {}},
+    cranc::ApplicationConfig<higher_order_terms>{ "corr.vout1.hi", "2f", update_corrections, {}},
+    cranc::ApplicationConfig<higher_order_terms>{ "corr.iout1.hi", "2f", update_corrections, {}},
+};
+
+// a piecewise linear map applied to the output of the polynomial, disabled with less than two points
+constexpr std::size_t correction_points = 8;
+struct CorrectionTable {
+    std::uint8_t count;
+    std::array<float, correction_points> x;
+    std::array<float, correction_points> y;
+};
+std::array correction_tables = {
+    cranc::ApplicationConfig<CorrectionTable>{ "corr.vout0.pwl", "B8f8f", update_corrections, {}},
+    cranc::ApplicationConfig<CorrectionTable>{ "corr.iout0.pwl", "B8f8f", update_corrections, {}},
+    cranc::ApplicationConfig<CorrectionTable>{ "corr.vout1.pwl", "B8f8f", update_corrections, {}},
+    cranc::ApplicationConfig<CorrectionTable>{ "corr.iout1.pwl", "B8f8f", update_corrections, {}},
 };
 
 config::PersistentConfig persistence[] = {
     correction_polynomials[0],
     correction_polynomials[1],
     correction_polynomials[2],
-    correction_polynomials[3]
+    correction_polynomials[3],
+    correction_higher_orders[0],
+    correction_higher_orders[1],
+    correction_higher_orders[2],
+    correction_higher_orders[3],
+    correction_tables[0],
+    correction_tables[1],
+    correction_tables[2],
+    correction_tables[3],
 };
 
-
-float apply_polynomial(float x, correction_polynomial const& poly) {
-    float x_ = 1;
-    float v = 0;
-    for (int i=0; i < poly.size(); ++i) {
-        v += poly[i] * x_;
-        x_ *= x;
-    }
-    return v;
-}
+std::array<FixedPolynomial<correction_order>, 4> polynomials;
+std::array<PiecewiseLinear<correction_points>, 4> tables;
 
 constexpr std::array<float, 4> conversion_scalars = {
     1./ 26.,
@@ -70,13 +113,224 @@ constexpr std::array<float, 4> conversion_scalars = {
     1./ 8.,
 };
 
-std::array<float, 4> conversions = {};
+using PwmCountsPerUnit = FixedPoint<std::int32_t, correction_frac_bits>;
+using CorrectedValue = FixedPoint<std::int32_t, correction_frac_bits>;
+// pwm compare levels with max_dither_bits fractional bits, raw_cfgs hold their integer part
+using PwmLevel = FixedPoint<std::uint32_t, max_dither_bits>;
+constexpr PwmLevel max_pwm_level{std::uint32_t{0xffff} << max_dither_bits};
+
+std::array<PwmLevel, 4> levels = {};
+
+std::array<PwmCountsPerUnit, 4> conversions = {};
+std::array<float, 4> trims = {};
+// the setpoints actually applied, they follow flt_cfgs unless a channel is slew limited
+std::array<float, 4> references = {};
+std::array<bool, 4> slew_limited = {};
+std::array<bool, 2> forced_off = {};
+// nesting depth of output::Batch and the updates it held back
+std::uint8_t batch_depth{};
+bool batched_apply{};
+bool batched_post{};
 
 constexpr std::array<std::uint8_t, 4> pins {
     6,7,8,9,
 };
 
 constexpr std::uint16_t pwm_mask = (1 << 3) | (1 << 4);
+constexpr std::uint8_t ref_slice = 3;
+// pwm counts kept clear of the wrap when committing new values
+constexpr std::uint16_t commit_guard = 512;
+
+bool pwm_configured{false};
+
+struct PicoPwm {
+    std::uint32_t counter(std::uint8_t slice) const { return pwm_get_counter(slice); }
+    std::uint32_t top(std::uint8_t slice) const { return pwm_hw->slice[slice].top; }
+} pico_pwm;
+
+// per pwm slice a data dma channel feeds a sigma delta sequence of compare values into the cc register, paced by the
+// pwm wrap; when done it chains to a control channel that restarts it with the sequence `active` points to
+struct DitheredSlice {
+    static constexpr std::size_t max_len = std::size_t{1} << max_dither_bits;
+    // a spare word between the buffers keeps the read address of a finished sequence unambiguous
+    using Buffer = std::array<std::uint32_t, max_len + 1>;
+
+    std::uint8_t slice;
+    std::array<std::size_t, 2> level_idx; // the levels of channel a and b
+
+    int data_channel{-1};
+    int control_channel{-1};
+    // one buffer is active, one may still be played and one is filled
+    std::array<Buffer, 3> buffers{};
+    std::uint32_t const* volatile active{buffers[0].data()};
+    std::uint32_t const* prepared{buffers[0].data()};
+
+    void claim() {
+        data_channel = dma_claim_unused_channel(true);
+        control_channel = dma_claim_unused_channel(true);
+    }
+
+    void start(std::uint8_t bits) {
+        auto data_config = dma_channel_get_default_config(data_channel);
+        channel_config_set_transfer_data_size(&data_config, DMA_SIZE_32);
+        channel_config_set_read_increment(&data_config, true);
+        channel_config_set_write_increment(&data_config, false);
+        channel_config_set_dreq(&data_config, pwm_get_dreq(slice));
+        channel_config_set_chain_to(&data_config, control_channel);
+        dma_channel_configure(data_channel, &data_config, &pwm_hw->slice[slice].cc, active, std::uint32_t{1} << bits, false);
+
+        auto control_config = dma_channel_get_default_config(control_channel);
+        channel_config_set_transfer_data_size(&control_config, DMA_SIZE_32);
+        channel_config_set_read_increment(&control_config, false);
+        channel_config_set_write_increment(&control_config, false);
+        dma_channel_configure(control_channel, &control_config, &dma_hw->ch[data_channel].al3_read_addr_trig, &active, 1, true);
+    }
+
+    void stop() {
+        // aborting the data channel may trigger its chain, abort the control channel once more afterwards
+        dma_channel_abort(control_channel);
+        dma_channel_abort(data_channel);
+        dma_channel_abort(control_channel);
+    }
+
+    // the trip path, registers only: the sequence stops where it is and the compare values of both channels are zero
+    // from the next wrap on instead of at the end of the sequence, only start() brings the sequence back
+    void cut() {
+        stop();
+        pwm_set_both_levels(slice, 0, 0);
+    }
+
+    void prepare(std::array<std::uint32_t, 2> const& slice_levels, std::uint8_t bits) {
+        auto playing = reinterpret_cast<std::uint32_t const*>(dma_hw->ch[data_channel].read_addr);
+        Buffer* target = nullptr;
+        for (auto& buffer : buffers) {
+            bool is_playing = playing >= buffer.data() and playing <= buffer.data() + max_len;
+            if (buffer.data() != active and not is_playing) {
+                target = &buffer;
+                break;
+            }
+        }
+        std::size_t len = std::size_t{1} << bits;
+        std::array<std::uint16_t, max_len> a, b;
+        sigma_delta_sequence(slice_levels[0], bits, {a.data(), len});
+        sigma_delta_sequence(slice_levels[1], bits, {b.data(), len});
+        for (auto i{0U}; i < len; ++i) {
+            (*target)[i] = a[i] | (static_cast<std::uint32_t>(b[i]) << 16);
+        }
+        prepared = target->data();
+    }
+};
+
+// indexed by output channel, each slice carries the voltage and current reference of one channel
+std::array<DitheredSlice, 2> dithered_slices {{
+    {3, {0, 1}},
+    {4, {3, 2}},
+}};
+std::uint8_t dither_bits{0};
+
+// what commit() hands to the pwm registers, written in one period either right away or from the wrap interrupt
+struct Staged {
+    std::optional<std::uint16_t> top;
+    // switch the dma to the prepared sequences instead of writing the levels of each slice
+    bool dithered{};
+    std::array<std::array<std::uint16_t, 2>, 2> levels{};
+    // start the dma sequences with that many bits
+    std::uint8_t start_bits{};
+} staged;
+
+PeriodCommit<PicoPwm> period_commit{pico_pwm, ref_slice, commit_guard};
+
+bool write_staged() {
+    for (auto i{0U}; i < dithered_slices.size(); ++i) {
+        auto& s = dithered_slices[i];
+        if (staged.top) {
+            pwm_hw->slice[s.slice].top = *staged.top;
+        }
+        if (staged.dithered) {
+            s.active = s.prepared;
+        } else {
+            pwm_set_both_levels(s.slice, staged.levels[i][0], staged.levels[i][1]);
+        }
+    }
+    // both sequences have to start at the same wrap to keep their boundaries aligned, a slice that was cut stays off
+    if (staged.start_bits) {
+        for (auto i{0U}; i < dithered_slices.size(); ++i) {
+            if (not forced_off[i]) {
+                dithered_slices[i].start(staged.start_bits);
+            }
+        }
+        staged.start_bits = 0;
+    }
+    return std::exchange(staged.top, std::nullopt).has_value();
+}
+
+void pwm_wrap_handler() {
+    cranc::ISRTime isrTimer;
+    cranc::LockGuard lock;
+    pwm_clear_irq(ref_slice);
+    if (not period_commit.on_wrap(write_staged)) {
+        pwm_set_irq_enabled(ref_slice, false);
+    }
+}
+
+// with the lock held
+void flush_staged() {
+    if (period_commit.commit(write_staged)) {
+        // a wrap flagged before now may predate a top written in this period
+        pwm_clear_irq(ref_slice);
+        pwm_set_irq_enabled(ref_slice, true);
+    }
+}
+
+// the level of channel i with that many fractional bits, zero while its output is forced off
+std::uint32_t level_of(std::size_t i, std::uint8_t bits) {
+    return forced_off[i / 2] ? 0 : levels[i].val >> (max_dither_bits - bits);
+}
+
+// the single place that writes the pwm registers, apart from the trip path of force_off: the compare values of all
+// four channels (and the wrap, if top is given) change in the same pwm period, at the latest in the one after the next
+// wrap. When dithering, the new sequences start at the same sequence boundary.
+void commit(std::optional<std::uint16_t> top = {}) {
+    auto level = [](std::size_t i) {
+        return level_of(i, dither_bits);
+    };
+    cranc::LockGuard lock;
+    staged.dithered = dither_bits != 0;
+    for (auto i{0U}; i < dithered_slices.size(); ++i) {
+        auto& s = dithered_slices[i];
+        if (dither_bits) {
+            s.prepare({level(s.level_idx[0]), level(s.level_idx[1])}, dither_bits);
+        } else {
+            staged.levels[i] = {static_cast<std::uint16_t>(level(s.level_idx[0])), static_cast<std::uint16_t>(level(s.level_idx[1]))};
+        }
+    }
+    if (top) {
+        staged.top = top;
+    }
+    flush_staged();
+}
+
+void start_dithering(std::uint8_t bits) {
+    cranc::LockGuard lock;
+    dither_bits = bits;
+    for (auto& s : dithered_slices) {
+        s.prepare({level_of(s.level_idx[0], bits), level_of(s.level_idx[1], bits)}, bits);
+        s.active = s.prepared;
+    }
+    staged.dithered = true;
+    staged.start_bits = bits;
+    flush_staged();
+}
+
+void stop_dithering() {
+    cranc::LockGuard lock;
+    for (auto& s : dithered_slices) {
+        s.stop();
+    }
+    dither_bits = 0;
+    staged.dithered = false;
+    staged.start_bits = 0;
+}
 
 
 struct : cranc::Module {
@@ -89,55 +343,211 @@ struct : cranc::Module {
             gpio_set_function(pin, GPIO_FUNC_PWM);
         }
 
+        for (auto& s : dithered_slices) {
+            s.claim();
+        }
+        update_corrections(false);
+
+        irq_set_exclusive_handler(PWM_IRQ_WRAP, pwm_wrap_handler);
+        irq_set_enabled(PWM_IRQ_WRAP, true);
+
+        // the slices have to run in lockstep for commit() to change them in the same period
+        pwm_set_mask_enabled(0);
+        pwm_set_counter(3, 0);
+        pwm_set_counter(4, 0);
+        pwm_set_wrap(3, clock_get_hz(clk_sys) / *cfg_feq);
+        pwm_set_wrap(4, clock_get_hz(clk_sys) / *cfg_feq);
+        pwm_set_mask_enabled(pwm_mask);
+
         update_everything(true);
+        pwm_configured = true;
     }
 } _{1000};
 
 void update_pwm_vals(bool setter) {
     if (setter) {
-        pwm_set_both_levels(3, *(raw_cfgs[0]), *(raw_cfgs[1]));
-        pwm_set_both_levels(4, *(raw_cfgs[3]), *(raw_cfgs[2]));
+        commit();
     }
 }
 
-void update_vals(bool setter) {
+// a raw level written from outside replaces the level of its channel
+void update_raw_vals(bool setter) {
     if (setter) {
         for (auto i=0; i < 4; ++i) {
-            auto corrected = apply_polynomial(*(flt_cfgs[i]), *(correction_polynomials[i]));
-            *(raw_cfgs[i]) = corrected * conversions[i];
+            if (*(raw_cfgs[i]) != (levels[i].val >> max_dither_bits)) {
+                levels[i] = PwmLevel{static_cast<std::uint32_t>(*(raw_cfgs[i])) << max_dither_bits};
+            }
         }
-        update_pwm_vals(true);
-        auto msg = msg_buf.getFreeMessage(
-            *(flt_cfgs[0]), *(flt_cfgs[1]),
-            *(flt_cfgs[2]), *(flt_cfgs[3])
-        );
-        if (msg) {
-            msg->post();
+        commit();
+    }
+}
+
+PwmLevel to_pwm_level(std::size_t i, float value) {
+    CorrectedValue corrected = tables[i](polynomials[i](to_correction_fixed(value)));
+    return std::min(saturate_cast<PwmLevel>(corrected * conversions[i]), max_pwm_level);
+}
+
+void compute_levels() {
+    for (auto i=0; i < 4; ++i) {
+        levels[i] = to_pwm_level(i, references[i] + trims[i]);
+        *(raw_cfgs[i]) = levels[i].val >> max_dither_bits;
+    }
+}
+
+void apply_setpoints() {
+    if (batch_depth) {
+        batched_apply = true;
+        return;
+    }
+    compute_levels();
+    commit();
+}
+
+// also called with setter == false to build the fixed point curves from the persisted configs during init
+void update_corrections(bool setter) {
+    for (auto i=0; i < 4; ++i) {
+        std::array<float, correction_order> coefficients{};
+        std::copy_n(correction_polynomials[i]->begin(), 2, coefficients.begin());
+        std::copy(correction_higher_orders[i]->begin(), correction_higher_orders[i]->end(), coefficients.begin() + 2);
+        polynomials[i].set(coefficients);
+
+        auto const& table = *(correction_tables[i]);
+        tables[i].set(table.x, table.y, table.count);
+    }
+    if (setter and pwm_configured) {
+        apply_setpoints();
+    }
+}
+
+void post_setpoints() {
+    if (batch_depth) {
+        batched_post = true;
+        return;
+    }
+    auto msg = msg_buf.getFreeMessage(
+        *(flt_cfgs[0]), *(flt_cfgs[1]),
+        *(flt_cfgs[2]), *(flt_cfgs[3])
+    );
+    if (msg) {
+        msg->post();
+    }
+}
+
+void update_references() {
+    for (auto i=0; i < 4; ++i) {
+        if (not slew_limited[i]) {
+            references[i] = *(flt_cfgs[i]);
         }
     }
 }
 
-void update_everything(bool setter) {
+void update_vals(bool setter) {
     if (setter) {
-        pwm_set_mask_enabled(0);
+        update_references();
+        apply_setpoints();
+        post_setpoints();
+    }
+}
 
-        pwm_set_counter(3, 0);
-        pwm_set_counter(4, 0);
+// changes the pwm frequency and dithering without stopping the outputs
+void update_everything(bool setter) {
+    if (setter) {
+        auto bits = std::min(*cfg_dither, max_dither_bits);
+        *cfg_dither = bits;
 
         float system_clock_frequency = clock_get_hz(clk_sys);
         auto max = system_clock_frequency / *cfg_feq;
-
-        pwm_set_wrap(3, max);
-        pwm_set_wrap(4, max);
-
         for (auto i=0; i < 4; ++i) {
-            conversions[i] = max * conversion_scalars[i];
+            conversions[i] = PwmCountsPerUnit::from_float(max * conversion_scalars[i]);
         }
 
-        update_vals(true);
-        
-        pwm_set_mask_enabled(pwm_mask);
+        // the dma sequences would keep the old levels for a while, switch to direct writes around the change
+        stop_dithering();
+        update_references();
+        compute_levels();
+        commit(static_cast<std::uint16_t>(max));
+        if (bits) {
+            start_dithering(bits);
+        }
+        post_setpoints();
+    }
+}
+
+}
+
+namespace output {
+
+Batch::Batch() {
+    ++batch_depth;
+}
+
+Batch::~Batch() {
+    if (--batch_depth) {
+        return;
+    }
+    if (std::exchange(batched_apply, false)) {
+        apply_setpoints();
+    }
+    if (std::exchange(batched_post, false)) {
+        post_setpoints();
+    }
+}
+
+void set_trim(std::size_t channel, float du, float di) {
+    trims[2 * channel + 0] = du;
+    trims[2 * channel + 1] = di;
+    apply_setpoints();
+}
+
+float setpoint(std::size_t idx) {
+    return *(flt_cfgs[idx]);
+}
+
+void set_setpoint(std::size_t idx, float value) {
+    flt_cfgs[idx].set(value);
+}
+
+float reference(std::size_t idx) {
+    return references[idx];
+}
+
+void set_reference(std::size_t idx, float value) {
+    references[idx] = value;
+    apply_setpoints();
+}
+
+void set_slew_limited(std::size_t idx, bool limited) {
+    slew_limited[idx] = limited;
+    if (not limited) {
+        set_reference(idx, *(flt_cfgs[idx]));
+    }
+}
+
+// runs in the sampling path, the slice of the channel is cut right away instead of preparing new sequences or waiting
+// for the commit window; commits that follow keep its levels at zero
+void force_off(std::size_t channel) {
+    cranc::LockGuard lock;
+    forced_off[channel] = true;
+    staged.levels[channel] = {0, 0};
+    if (dither_bits) {
+        dithered_slices[channel].cut();
+    } else {
+        pwm_set_both_levels(dithered_slices[channel].slice, 0, 0);
+    }
+}
+
+void release(std::size_t channel) {
+    cranc::LockGuard lock;
+    forced_off[channel] = false;
+    if (not dither_bits) {
+        commit();
+        return;
     }
+    // the sequence of a cut slice restarts together with the other one, like when the dithering changes
+    auto bits = dither_bits;
+    stop_dithering();
+    commit();
+    start_dithering(bits);
 }
 
 }
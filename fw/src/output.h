@@ -1,6 +1,39 @@
 #pragma once
 
+#include <cstddef>
+
 struct OutputSetpoint {
     float u0, i0;
     float u1, i1;
-};
\ No newline at end of file
+};
+
+namespace output {
+
+// additive corrections of the voltage and current setpoint of a channel, applied on top of the configured setpoints
+void set_trim(std::size_t channel, float du, float di);
+
+// setpoints and references are indexed vout0, iout0, vout1, iout1
+float setpoint(std::size_t idx);
+void set_setpoint(std::size_t idx, float value);
+
+// the reference applied to the pwm, it follows the setpoint immediately unless slew limited
+float reference(std::size_t idx);
+void set_reference(std::size_t idx, float value);
+// while slew limited the reference is only moved by set_reference
+void set_slew_limited(std::size_t idx, bool limited);
+
+// holds the pwm commit of setpoint, reference and trim changes back until the outermost batch ends, so they take
+// effect together (main loop only)
+struct Batch {
+    Batch();
+    ~Batch();
+    Batch(Batch const&) = delete;
+    Batch& operator=(Batch const&) = delete;
+};
+
+// drive the references of a channel to zero regardless of the setpoints (callable from interrupt context)
+void force_off(std::size_t channel);
+// undo force_off
+void release(std::size_t channel);
+
+}
@@ -0,0 +1,400 @@
+#pragma once
+
+#include "util/Crc.h"
+#include "util/Hash.h"
+#include "util/span_helpers.h"
+
+#include "cranc/coro/Generator.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+
+/*
+ * append only log of config values in a flash region split into two banks
+ * a changed value is appended as a record and the latest record of an id wins, nothing is erased until the active bank is full,
+ * then the current values are compacted into the other bank which takes over with a higher sequence number
+ * the old bank stays intact until the next compaction, so a power loss while compacting falls back to it,
+ * and if the log of the current bank is damaged, values missing from it are taken from there
+ * writing is split into steps of one page program or sector erase each, the caller lets everything else run in between,
+ * values are copied when their record is started and the index only points to records once they are complete
+ * records are keyed by the name and format of their config, the boot index hashes them but always compares the whole key
+ *
+ * the flash access is left to the Flash type so the log runs on a simulated flash on host, it has to provide
+ *   page_size, sector_size
+ *   std::span<const std::uint8_t> region() const                   the memory mapped region, two banks of whole sectors
+ *   void erase(std::size_t offset, std::size_t size)                sector aligned, relative to the region
+ *   void program(std::size_t offset, std::span<const std::uint8_t>) one page, page aligned
+ */
+
+namespace config
+{
+
+constexpr std::uint32_t log_bank_magic = 0x474f4c43; // "CLOG"
+constexpr std::uint32_t log_layout_version = 1;
+
+struct LogBankHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t sequence;
+    std::uint32_t crc; // over the fields above
+};
+
+// followed by the key {u8 len, name, u8 len, format} like in the config protocol's describe and the value
+struct LogRecordHeader {
+    std::uint32_t id;   // hash of name and format
+    std::uint32_t size; // of key and value
+    std::uint32_t crc;  // over id, size, key and value
+};
+
+struct LogValue {
+    std::string_view name;
+    std::string_view format;
+    std::span<const std::uint8_t> data;
+};
+
+template<typename Flash, std::size_t max_entries>
+struct ConfigLog {
+    static constexpr std::size_t alignment = 4;
+    static constexpr std::size_t max_value_size = 512;
+    static constexpr std::size_t max_key_size = 2 + 2 * 255;
+    static constexpr std::size_t slots = 2 * max_entries; // keeps the probe sequences short
+
+    using Steps = cranc::coro::Generator<void>;
+
+    struct Entry {
+        std::uint32_t id;
+        std::uint32_t offset; // of the key in the region
+        std::uint16_t key_size;
+        std::uint16_t size;   // of the value
+    };
+
+    Flash flash;
+    std::array<Entry, max_entries> entries{};
+    std::array<std::uint16_t, slots> by_id{}; // entry + 1, 0 for an empty slot
+    std::size_t count{};
+    bool valid{};          // whether the active bank has a header at all
+    std::size_t dropped{}; // values the last save couldn't store, or records the last load had no entry for
+    std::size_t bank{};
+    std::uint32_t sequence{};
+    std::size_t append_at{}; // the end of the bank if it has to be compacted before anything can be appended
+    std::array<std::uint8_t, sizeof(LogRecordHeader) + max_key_size + max_value_size> staged; // the record being written
+    std::array<std::uint8_t, Flash::page_size> page;
+
+    // picks the current bank and indexes the latest record of every id
+    // a single pass over the records, the configs are looked up in the index afterwards
+    void load() {
+        dropped = 0;
+        count = 0;
+        by_id.fill(0);
+        valid = false;
+        bank = 0;
+        std::optional<std::size_t> previous;
+        for (std::size_t b = 0; b < 2; ++b) {
+            auto header = read<LogBankHeader>(b * bank_size());
+            if (header.magic != log_bank_magic or header.version != log_layout_version or header.crc != header_crc(header)) {
+                continue;
+            }
+            if (valid and static_cast<std::int32_t>(header.sequence - sequence) <= 0) {
+                previous = b;
+                continue;
+            }
+            if (valid) {
+                previous = bank;
+            }
+            valid = true;
+            bank = b;
+            sequence = header.sequence;
+        }
+        append_at = bank_end();
+        if (not valid) {
+            return;
+        }
+
+        if (auto end = scan(bank_begin(), bank_end())) {
+            append_at = *end;
+            return;
+        }
+        // the log is damaged, values missing from it are taken from the previous copy until the next save compacts
+        if (previous) {
+            scan(*previous * bank_size(), (*previous + 1) * bank_size(), count);
+        }
+    }
+
+    std::optional<std::span<const std::uint8_t>> find(std::string_view name, std::string_view format) const {
+        auto e = by_id[slot_of(key_id(name, format), name, format)];
+        if (e == 0) {
+            return {};
+        }
+        auto const& entry = entries[e - 1];
+        return bytes(entry.offset + entry.key_size, entry.size);
+    }
+
+    // appends the values source(0), source(1), ... up to the first empty optional, unless they are stored already
+    // if they don't fit, all of them are compacted into the other bank instead
+    // values larger than max_value_size and new keys beyond max_entries are skipped and counted in dropped, the keys of
+    // configs that are gone stay in the index until the next compaction
+    template<typename Source>
+    Steps save(Source source) {
+        dropped = 0;
+        for (std::size_t i = 0; auto v = source(i); ++i) {
+            auto record = stage(*v);
+            if (record.empty()) {
+                ++dropped;
+                continue;
+            }
+            auto stored = find(v->name, v->format);
+            if (stored and std::ranges::equal(*stored, v->data)) {
+                continue;
+            }
+            if (not stored and count == entries.size()) {
+                ++dropped;
+                continue;
+            }
+            if (append_at + record.size() > bank_end()) {
+                auto steps = compact(source);
+                while (steps.advance()) {
+                    co_yield {};
+                }
+                co_return;
+            }
+            auto pos = append_at;
+            auto steps = write(pos, record);
+            while (steps.advance()) {
+                co_yield {};
+            }
+            index(key_id(v->name, v->format), pos + sizeof(LogRecordHeader), record.size() - sizeof(LogRecordHeader));
+            append_at = aligned(pos + record.size());
+        }
+    }
+
+    Steps erase() {
+        dropped = 0;
+        // the sectors with the bank headers go first, so a power loss halfway doesn't bring old values back
+        for (auto offset : {std::size_t{0}, bank_size()}) {
+            flash.erase(offset, Flash::sector_size);
+            co_yield {};
+        }
+        for (std::size_t offset = 0; offset < flash.region().size(); offset += Flash::sector_size) {
+            if (offset % bank_size() == 0) {
+                continue;
+            }
+            flash.erase(offset, Flash::sector_size);
+            co_yield {};
+        }
+        load();
+    }
+
+private:
+    std::size_t bank_size() const {
+        return flash.region().size() / 2;
+    }
+
+    std::size_t bank_begin() const {
+        return bank * bank_size();
+    }
+
+    std::size_t bank_end() const {
+        return bank_begin() + bank_size();
+    }
+
+    static std::size_t aligned(std::size_t offset) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    template<typename T>
+    T read(std::size_t offset) const {
+        T t;
+        std::memcpy(&t, flash.region().data() + offset, sizeof(t));
+        return t;
+    }
+
+    std::span<const std::uint8_t> bytes(std::size_t offset, std::size_t size) const {
+        return flash.region().subspan(offset, size);
+    }
+
+    static std::uint32_t key_id(std::string_view name, std::string_view format) {
+        return hash_str(format, hash_str(name));
+    }
+
+    std::string_view chars(std::size_t offset, std::size_t size) const {
+        return {reinterpret_cast<char const*>(flash.region().data() + offset), size};
+    }
+
+    // the slot of the entry with that key, or the empty one it goes into
+    std::size_t slot_of(std::uint32_t id, std::string_view name, std::string_view format) const {
+        auto slot = id % slots;
+        for (; by_id[slot] != 0; slot = (slot + 1) % slots) {
+            auto const& e = entries[by_id[slot] - 1];
+            if (e.id != id or e.key_size != 2 + name.size() + format.size()) {
+                continue;
+            }
+            if (chars(e.offset + 1, name.size()) == name and chars(e.offset + 2 + name.size(), format.size()) == format) {
+                break;
+            }
+        }
+        return slot;
+    }
+
+    static std::uint32_t header_crc(LogBankHeader const& header) {
+        return crc32({reinterpret_cast<std::uint8_t const*>(&header), offsetof(LogBankHeader, crc)});
+    }
+
+    static std::uint32_t record_crc(std::uint32_t id, std::uint32_t size, std::span<const std::uint8_t> data) {
+        auto crc = crc32(to_span_c(id));
+        crc = crc32(to_span_c(size), crc);
+        return crc32(data, crc);
+    }
+
+    // indexes the intact records of the bank from begin, returns where the log ends if all of it is intact and the rest is erased
+    // the first keep entries stay as they are, only values of other keys are taken
+    std::optional<std::size_t> scan(std::size_t begin, std::size_t end, std::size_t keep = 0) {
+        auto pos = begin + sizeof(LogBankHeader);
+        while (pos + sizeof(LogRecordHeader) <= end) {
+            auto header = read<LogRecordHeader>(pos);
+            auto body_at = pos + sizeof(header);
+            if (header.id == 0xffffffff and header.size == 0xffffffff) {
+                // appending is only safe if nothing of an interrupted write is left behind
+                auto rest = flash.region().subspan(pos, end - pos);
+                if (std::all_of(rest.begin(), rest.end(), [](auto b) { return b == 0xff; })) {
+                    return pos;
+                }
+                return {};
+            }
+            if (header.size > end - body_at or header.crc != record_crc(header.id, header.size, bytes(body_at, header.size))) {
+                return {};
+            }
+            index(header.id, body_at, header.size, keep);
+            pos = aligned(body_at + header.size);
+        }
+        return {};
+    }
+
+    // indexes the record body at offset as the latest value of its key, records with a malformed key are skipped
+    void index(std::uint32_t id, std::size_t offset, std::size_t size, std::size_t keep = 0) {
+        auto name_size = std::size_t{bytes(offset, 1)[0]};
+        if (1 + name_size + 1 > size) {
+            return;
+        }
+        auto format_size = std::size_t{bytes(offset + 1 + name_size, 1)[0]};
+        std::size_t key_size = 2 + name_size + format_size;
+        if (key_size > size) {
+            return;
+        }
+        auto slot = slot_of(id, chars(offset + 1, name_size), chars(offset + 2 + name_size, format_size));
+        if (by_id[slot] == 0) {
+            if (count == entries.size()) {
+                ++dropped;
+                return;
+            }
+            by_id[slot] = ++count;
+        } else if (by_id[slot] <= keep) {
+            return;
+        }
+        entries[by_id[slot] - 1] = {
+            .id       = id,
+            .offset   = static_cast<std::uint32_t>(offset),
+            .key_size = static_cast<std::uint16_t>(key_size),
+            .size     = static_cast<std::uint16_t>(size - key_size),
+        };
+    }
+
+    // copies the record of a value so it can't change while it is written, empty if it is too large
+    std::span<const std::uint8_t> stage(LogValue const& v) {
+        if (v.data.size() > max_value_size or v.name.size() > 255 or v.format.size() > 255) {
+            return {};
+        }
+        auto body = std::span{staged}.subspan(sizeof(LogRecordHeader));
+        std::size_t pos = 0;
+        body[pos++] = v.name.size();
+        std::memcpy(body.data() + pos, v.name.data(), v.name.size());
+        pos += v.name.size();
+        body[pos++] = v.format.size();
+        std::memcpy(body.data() + pos, v.format.data(), v.format.size());
+        pos += v.format.size();
+        if (not v.data.empty()) {
+            std::memcpy(body.data() + pos, v.data.data(), v.data.size());
+        }
+        pos += v.data.size();
+
+        auto id = key_id(v.name, v.format);
+        auto size = static_cast<std::uint32_t>(pos);
+        LogRecordHeader header{id, size, record_crc(id, size, body.first(pos))};
+        std::memcpy(staged.data(), &header, sizeof(header));
+        return {staged.data(), sizeof(header) + pos};
+    }
+
+    // writes the current values into the other bank and switches to it, the header goes last so until then the bank is ignored
+    // if they don't fit, the current bank stays active and every value is counted in dropped from the first that doesn't
+    template<typename Source>
+    Steps compact(Source& source) {
+        auto target = 1 - bank;
+        auto begin = target * bank_size();
+        auto end = begin + bank_size();
+        // values indexed from the previous copy are about to be erased
+        count = 0;
+        by_id.fill(0);
+        if (valid) {
+            scan(bank_begin(), bank_end());
+        }
+        dropped = 0;
+        for (auto offset = begin; offset < end; offset += Flash::sector_size) {
+            flash.erase(offset, Flash::sector_size);
+            co_yield {};
+        }
+
+        auto pos = begin + sizeof(LogBankHeader);
+        std::size_t stored = 0;
+        for (std::size_t i = 0; auto v = source(i); ++i) {
+            auto record = stage(*v);
+            if (record.empty() or stored == entries.size()) {
+                ++dropped;
+                continue;
+            }
+            if (pos + record.size() > end) {
+                for (; source(i); ++i) {
+                    ++dropped;
+                }
+                co_return;
+            }
+            ++stored;
+            auto steps = write(pos, record);
+            while (steps.advance()) {
+                co_yield {};
+            }
+            pos = aligned(pos + record.size());
+        }
+
+        LogBankHeader header{log_bank_magic, log_layout_version, sequence + 1, 0};
+        header.crc = header_crc(header);
+        auto steps = write(begin, to_span_c(header));
+        while (steps.advance()) {
+            co_yield {};
+        }
+        auto skipped = dropped;
+        load();
+        dropped = skipped;
+    }
+
+    // programs the pages data covers from offset one per step, the rest of the pages stays erased
+    Steps write(std::size_t offset, std::span<const std::uint8_t> data) {
+        auto page_at = offset / Flash::page_size * Flash::page_size;
+        while (not data.empty()) {
+            page.fill(0xff);
+            auto n = std::min(data.size(), page_at + page.size() - offset);
+            std::memcpy(page.data() + (offset - page_at), data.data(), n);
+            flash.program(page_at, page);
+            offset += n;
+            page_at += page.size();
+            data = data.subspan(n);
+            co_yield {};
+        }
+    }
+};
+
+}
@@ -1,9 +1,11 @@
 #include "PersistentConfig.h"
 #include "util/Hash.h"
-#include "util/ChunkBuffer.h"
+
+#include "cranc/coro/SwitchToMainLoop.h"
 
 #include "pico.h"
 #include "hardware/flash.h"
+#include "hardware/timer.h"
 
 #include <algorithm>
 
@@ -11,13 +13,14 @@
 namespace
 {
 
+constexpr std::uint32_t flash_config_size = 16*1024;
+
+// the layout before the log, only read to take over the values of devices that were configured with it
 struct ConfigDescriptor {
     std::uint32_t id;
     std::uint32_t start_offset;
 };
 
-constexpr std::uint32_t flash_config_size = 16*1024;
-
 struct FlashConfig {
     std::uint32_t num_configs;
     union {
@@ -33,6 +36,7 @@ struct FlashConfig {
     }
 };
 static_assert(sizeof(FlashConfig) == flash_config_size);
+static_assert(flash_config_size % (2 * FLASH_SECTOR_SIZE) == 0, "the log needs two banks of whole sectors");
 
 }
 
@@ -51,15 +55,22 @@ std::uint32_t hash_config(cranc::ApplicationConfigBase const& config) {
     return hash_str(config.getFormat(), hash_str(config.getName()));
 }
 
+std::size_t flash_offset() {
+    return reinterpret_cast<std::byte const*>(&_flashConfigROM) - &__flash_binary_start;
 }
 
-namespace config 
-{
-
-PersistentConfigManager::PersistentConfigManager() {
+// the i-th persistent config, walking the list each time keeps no iterator in it across the steps of a save
+std::optional<config::LogValue> persistent_value(std::size_t i) {
+    auto& head = cranc::util::GloballyLinkedList<config::PersistentConfig>::getHead();
+    for (auto& applCfg : head) {
+        if (i-- == 0) {
+            return config::LogValue{applCfg->config.getName(), applCfg->config.getFormat(), applCfg->config.getValue()};
+        }
+    }
+    return {};
 }
 
-bool PersistentConfigManager::load(config::PersistentConfig& p_config) {
+bool load_legacy(config::PersistentConfig& p_config) {
     auto hash = hash_config(p_config.config);
     auto flash_cfg = std::launder(&_flashConfigROM);
     for (auto i=0U; i < flash_cfg->count(); ++i) {
@@ -75,68 +86,99 @@ bool PersistentConfigManager::load(config::PersistentConfig& p_config) {
     return false;
 }
 
-void PersistentConfigManager::erase() {
-    std::size_t offset = reinterpret_cast<std::byte const*>(&_flashConfigROM) - &__flash_binary_start;
-    assert(offset % FLASH_SECTOR_SIZE == 0);
-    assert(sizeof(_flashConfigROM) % FLASH_PAGE_SIZE == 0);
+}
+
+namespace config 
+{
+
+std::span<const std::uint8_t> ConfigFlash::region() const {
+    return {reinterpret_cast<std::uint8_t const*>(std::launder(&_flashConfigROM)), flash_config_size};
+}
+
+void ConfigFlash::erase(std::size_t offset, std::size_t size) {
+    assert((flash_offset() + offset) % FLASH_SECTOR_SIZE == 0);
+    assert(size % FLASH_SECTOR_SIZE == 0);
     cranc::LockGuard lock;
-    flash_range_erase(offset, sizeof(_flashConfigROM));
+    auto start = time_us_32();
+    flash_range_erase(flash_offset() + offset, size);
+    max_locked_us = std::max(max_locked_us, time_us_32() - start);
 }
 
-void PersistentConfigManager::save() {
-    auto& head = cranc::util::GloballyLinkedList<config::PersistentConfig>::getHead();
-    std::uint32_t num_configs = 0;
-    int config_size = 0;
-    
-    for (auto& applCfg : head) {
-        ++num_configs;
-        config_size += applCfg->config.getSize();
-    }
+void ConfigFlash::program(std::size_t offset, std::span<const std::uint8_t> page) {
+    assert((flash_offset() + offset) % FLASH_PAGE_SIZE == 0);
+    assert(page.size() == FLASH_PAGE_SIZE);
+    cranc::LockGuard lock;
+    auto start = time_us_32();
+    flash_range_program(flash_offset() + offset, page.data(), page.size());
+    max_locked_us = std::max(max_locked_us, time_us_32() - start);
+}
 
-    erase();
-    std::size_t data_offset = num_configs * sizeof(ConfigDescriptor);
-    std::size_t flash_offset = reinterpret_cast<std::byte const*>(&_flashConfigROM) - &__flash_binary_start;
-    ChunkBuffer<FLASH_PAGE_SIZE> buffer;
-
-    auto write = [&](std::span<std::uint8_t const> s) {
-        while (not s.empty()) {
-            buffer.push(s);
-            if (buffer.full()) {
-                auto chunk = buffer.flush();
-                assert(flash_offset % FLASH_PAGE_SIZE == 0);
-                assert(chunk.size() == FLASH_PAGE_SIZE);
-                cranc::LockGuard lock;
-                flash_range_program(flash_offset, chunk.data(), chunk.size());
-                flash_offset += chunk.size();
-            }
-        }
-    };
+PersistentConfigManager::PersistentConfigManager() {
+    log.load();
+}
 
-    {
-        std::uint32_t c = head.count();
-        write(to_span(c));
+bool PersistentConfigManager::load(config::PersistentConfig& p_config) {
+    if (not log.valid) {
+        return load_legacy(p_config);
     }
-    for (auto& applCfg : head) {
-        ConfigDescriptor descriptor {
-            .id           = hash_config(applCfg->config),
-            .start_offset = data_offset
-        };
-        data_offset += applCfg->config.getSize();
-        write(to_span(descriptor));
+    auto value = log.find(p_config.config.getName(), p_config.config.getFormat());
+    if (not value or value->size() != p_config.config.getSize()) {
+        return false;
     }
-    for (auto& applCfg : head) {
-        auto s = applCfg->config.getValue();
-        write(s);
+    p_config.config.setValue(*value, true);
+    return true;
+}
+
+void PersistentConfigManager::erase() {
+    erase_requested = true;
+    if (worker_task.done()) {
+        worker_task = worker();
     }
+}
 
-    if (not buffer.empty()) {
-        write(buffer.payload);
+void PersistentConfigManager::save() {
+    save_requested = true;
+    if (worker_task.done()) {
+        worker_task = worker();
     }
+}
+
+bool PersistentConfigManager::busy() const {
+    return not worker_task.done();
+}
+
+std::uint32_t PersistentConfigManager::max_locked_us() const {
+    return log.flash.max_locked_us;
+}
 
+std::uint32_t PersistentConfigManager::dropped() const {
+    return log.dropped;
+}
+
+// only changed values are appended, the region is erased only when the log is compacted
+cranc::coro::Task<void> PersistentConfigManager::worker() {
+    cranc::coro::SwitchToMainLoop sw2main;
+    // the requests come from config setters that may hold the lock
+    co_await sw2main;
+    while (erase_requested or save_requested) {
+        auto start = time_us_32();
+        decltype(log)::Steps steps;
+        if (erase_requested) {
+            erase_requested = false;
+            steps = log.erase();
+        } else {
+            save_requested = false;
+            steps = log.save(persistent_value);
+        }
+        while (steps.advance()) {
+            co_await sw2main;
+        }
+        last_duration_us = time_us_32() - start;
+    }
 }
 
 PersistentConfig::PersistentConfig(::cranc::ApplicationConfigBase& i_config) : config{i_config} {
     PersistentConfigManager::get().load(*this);
 }
 
-}
\ No newline at end of file
+}
@@ -1,8 +1,13 @@
 #pragma once
 
+#include "ConfigLog.h"
+
 #include "cranc/config/ApplicationConfig.h"
 #include "cranc/util/LinkedList.h"
 #include "cranc/util/Claimable.h"
+#include "cranc/coro/Task.h"
+
+#include "hardware/flash.h"
 
 namespace config
 {
@@ -12,12 +17,46 @@ struct PersistentConfig : cranc::util::GloballyLinkedList<PersistentConfig> {
     PersistentConfig(cranc::ApplicationConfigBase& i_config);
 };
 
+// the CONFIG region of the flash
+struct ConfigFlash {
+    static constexpr std::size_t page_size = FLASH_PAGE_SIZE;
+    static constexpr std::size_t sector_size = FLASH_SECTOR_SIZE;
+
+    std::span<const std::uint8_t> region() const;
+    void erase(std::size_t offset, std::size_t size);
+    void program(std::size_t offset, std::span<const std::uint8_t> page);
+
+    // the longest an erase or program kept the interrupts disabled
+    std::uint32_t max_locked_us{};
+};
+
 struct PersistentConfigManager : cranc::util::Singleton<PersistentConfigManager> {
+    // the dozen correction configs and room for the keys of configs that were removed, 16 bytes of ram each
+    // keys that don't fit are counted in dropped
+    static constexpr std::size_t max_persistent_configs = 32;
+
     PersistentConfigManager();
     
     bool load(config::PersistentConfig& p_config);
+
+    // both are carried out in steps from the main loop, one page or sector at a time
+    // requested while one is running, they follow once it is done
     void save();
     void erase();
+
+    bool busy() const;
+    std::uint32_t max_locked_us() const;
+    // the values the last save couldn't store
+    std::uint32_t dropped() const;
+    std::uint32_t last_duration_us{};
+
+private:
+    ConfigLog<ConfigFlash, max_persistent_configs> log{};
+    bool save_requested{};
+    bool erase_requested{};
+    cranc::coro::Task<void> worker_task;
+
+    cranc::coro::Task<void> worker();
 };
 
-}
\ No newline at end of file
+}
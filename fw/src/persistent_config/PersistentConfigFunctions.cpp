@@ -8,4 +8,17 @@ namespace {
 cranc::ApplicationConfig<void> save_conf{"config.save", [] { config::PersistentConfigManager::get().save(); }};
 cranc::ApplicationConfig<void> erase_conf{"config.erase",[] { config::PersistentConfigManager::get().erase(); }};
 
+// busy while a save or erase is in progress, the longest the flash access disabled interrupts, how long the last run took
+// and how many values it couldn't store for lack of room
+struct Status {
+    std::uint32_t busy;
+    std::uint32_t max_locked_us;
+    std::uint32_t last_duration_us;
+    std::uint32_t dropped;
+};
+cranc::ApplicationConfig<Status> status_conf{"config.status", "4I", [](bool) {
+    auto& manager = config::PersistentConfigManager::get();
+    *status_conf = {manager.busy(), manager.max_locked_us(), manager.last_duration_us, manager.dropped()};
+}, {}};
+
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "protection.h"
+#include "output.h"
+#include "relais.h"
+
+#include "cranc/module/Module.h"
+#include "cranc/msg/Message.h"
+#include "cranc/platform/system.h"
+
+#include "cranc/config/ApplicationConfig.h"
+
+#include <hardware/gpio.h>
+
+#include <array>
+
+namespace {
+
+constexpr std::size_t num_channels = 2;
+constexpr std::size_t num_adc_channels = 2 * num_channels;
+
+std::array<protection::RawLimit, num_adc_channels> raw_limits;
+std::array<std::uint8_t, num_channels> trips{};
+
+cranc::MessageBufferMemory<EnableCMD, 4> msg_buffer;
+
+// u0, i0, u1, i1; a limit <= 0 disables the check
+cranc::ApplicationConfig<std::array<float, num_adc_channels>> limits_cfg {"prot.limits", "4f", [](bool setter) {
+    if (setter) {
+        cranc::LockGuard lock;
+        for (auto i{0U}; i < num_adc_channels; ++i) {
+            raw_limits[i].set((*limits_cfg)[i]);
+        }
+    }
+}};
+
+// writing zeros releases the latched trips
+cranc::ApplicationConfig<std::array<std::uint8_t, num_channels>> tripped_cfg {"prot.tripped", "2B", [](bool setter) {
+    cranc::LockGuard lock;
+    for (auto i{0U}; i < num_channels; ++i) {
+        if (setter and trips[i] and (*tripped_cfg)[i] == protection::none) {
+            trips[i] = protection::none;
+            output::release(i);
+        }
+        (*tripped_cfg)[i] = trips[i];
+    }
+}};
+
+}
+
+namespace protection {
+
+void check(std::size_t adc_channel, std::int16_t raw, float scale) {
+    if (not raw_limits[adc_channel].exceeded(raw, scale)) {
+        return;
+    }
+    auto channel = adc_channel / 2;
+    cranc::LockGuard lock;
+    if (trips[channel]) {
+        return;
+    }
+    trips[channel] = (adc_channel % 2) ? over_current : over_voltage;
+
+    gpio_put(output_pins[channel].out_en, false);
+    output::force_off(channel);
+
+    // let the relais module run its regular switch off sequence
+    if (auto msg = msg_buffer.getFreeMessage(EnableCMD{static_cast<std::uint8_t>(channel), false})) {
+        msg->post();
+    }
+}
+
+bool tripped(std::size_t channel) {
+    cranc::LockGuard lock;
+    return trips[channel] != none;
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+namespace protection {
+
+enum Trip : std::uint8_t {
+    none = 0,
+    over_voltage = 1 << 0,
+    over_current = 1 << 1,
+};
+
+// a limit in physical units translated to raw adc counts so it can be evaluated with a single integer compare
+struct RawLimit {
+    float limit{};
+    float scale{};
+    std::int32_t raw_threshold{std::numeric_limits<std::int32_t>::max()};
+
+    void set(float l) {
+        limit = l;
+        scale = 0;
+    }
+
+    bool exceeded(std::int16_t raw, float s) {
+        if (s != scale) {
+            scale = s;
+            raw_threshold = (limit > 0 and s > 0) ? static_cast<std::int32_t>(limit / s) : std::numeric_limits<std::int32_t>::max();
+        }
+        return raw > raw_threshold;
+    }
+};
+
+// evaluates a freshly converted adc sample against the limits, called from the sampling path (interrupt context)
+void check(std::size_t adc_channel, std::int16_t raw, float scale);
+
+// whether an output channel is latched off by a trip
+bool tripped(std::size_t channel);
+
+}
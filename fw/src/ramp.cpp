@@ -0,0 +1,120 @@
+#include "output.h"
+#include "relais.h"
+#include "util/Ramp.h"
+
+#include "cranc/module/Module.h"
+#include "cranc/msg/Message.h"
+
+#include "cranc/coro/Task.h"
+#include "cranc/coro/Awaitable.h"
+#include "cranc/coro/SwitchToMainLoop.h"
+#include "cranc/config/ApplicationConfig.h"
+
+#include <array>
+#include <chrono>
+
+namespace {
+
+using namespace std::literals::chrono_literals;
+
+constexpr std::size_t num_quantities = 4;
+constexpr auto update_period = 5ms;
+constexpr float update_dt = std::chrono::duration<float>(update_period).count();
+
+struct RampCMD {
+    std::uint8_t quantity; // vout0, iout0, vout1, iout1
+    Ramp::Shape shape;
+    float from, to;
+    std::uint32_t duration_ms;
+};
+
+std::array<Ramp, num_quantities> ramps;
+
+// units per second for vout0, iout0, vout1, iout1; 0 disables the limit
+cranc::ApplicationConfig<std::array<float, num_quantities>> slew_cfg {"ramp.slew", "4f", [](bool setter) {
+    if (setter) {
+        for (auto i{0U}; i < num_quantities; ++i) {
+            output::set_slew_limited(i, (*slew_cfg)[i] > 0);
+        }
+    }
+}};
+
+cranc::ApplicationConfig<RampCMD> run_cfg {"ramp.run", "BBffI", [](bool setter) {
+    auto const& cmd = *run_cfg;
+    if (not setter or cmd.quantity >= num_quantities) {
+        return;
+    }
+    auto ticks = std::chrono::milliseconds{cmd.duration_ms} / update_period;
+    ramps[cmd.quantity].start(cmd.shape, to_ramp_fixed(cmd.from), to_ramp_fixed(cmd.to), ticks);
+    output::set_setpoint(cmd.quantity, cmd.from);
+}};
+
+cranc::ApplicationConfig<void> stop_cfg {"ramp.stop", [] {
+    for (auto& ramp : ramps) {
+        ramp.stop();
+    }
+}};
+
+cranc::ApplicationConfig<std::array<std::uint8_t, num_quantities>> active_cfg {"ramp.active", "4B", [](bool setter) {
+    if (not setter) {
+        for (auto i{0U}; i < num_quantities; ++i) {
+            (*active_cfg)[i] = not ramps[i].done();
+        }
+    }
+}};
+
+// soft start: slew limited references start from zero when an output gets enabled
+cranc::Listener<EnableCMD> enable_listener{[](EnableCMD const& cmd) {
+    if (not cmd.enable) {
+        return;
+    }
+    for (auto i : {2 * cmd.channel + 0, 2 * cmd.channel + 1}) {
+        if ((*slew_cfg)[i] > 0) {
+            output::set_reference(i, 0);
+        }
+    }
+}};
+
+void step_slew(std::size_t idx) {
+    auto slew = (*slew_cfg)[idx];
+    if (slew <= 0) {
+        return;
+    }
+    auto reference = to_ramp_fixed(output::reference(idx));
+    auto target = to_ramp_fixed(output::setpoint(idx));
+    if (reference == target) {
+        return;
+    }
+    auto next = slew_limit(reference, target, std::max(to_ramp_fixed(slew * update_dt), 1));
+    output::set_reference(idx, next == target ? output::setpoint(idx) : from_ramp_fixed(next));
+}
+
+struct : cranc::Module {
+    using cranc::Module::Module;
+
+    cranc::coro::Task<void> task;
+
+    cranc::coro::Task<void> update_loop() {
+        cranc::coro::SwitchToMainLoop sw2main;
+        cranc::coro::AwaitableDelay ticker{cranc::getSystemTime() + update_period, update_period};
+        while (true) {
+            co_await ticker;
+            co_await sw2main;
+            // all quantities move in the same pwm period
+            output::Batch batch;
+            for (auto i{0U}; i < num_quantities; ++i) {
+                if (not ramps[i].done()) {
+                    output::set_setpoint(i, from_ramp_fixed(ramps[i].step()));
+                }
+                step_slew(i);
+            }
+        }
+    }
+
+    void init() override
+    {
+        task = update_loop();
+    }
+} _{1000};
+
+}
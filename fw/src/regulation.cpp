@@ -0,0 +1,166 @@
+#include "regulator.h"
+#include "analog_readings.h"
+#include "output.h"
+#include "relais.h"
+
+#include "cranc/module/Module.h"
+#include "cranc/msg/Message.h"
+
+#include "cranc/coro/Task.h"
+#include "cranc/coro/Awaitable.h"
+#include "cranc/coro/SwitchToMainLoop.h"
+#include "cranc/config/ApplicationConfig.h"
+
+#include <array>
+#include <chrono>
+
+namespace {
+
+using namespace std::literals::chrono_literals;
+
+constexpr std::size_t num_channels = 2;
+constexpr auto control_period = 10ms;
+// the integrators don't run over longer gaps in the sample stream (e.g. an adc restart)
+constexpr std::uint32_t max_sample_gap_us = 1'000'000;
+
+// the regulator may move the references by at most this much away from the setpoints
+constexpr float max_voltage_correction = 2.f;
+constexpr float max_current_correction = .5f;
+
+struct Gains {
+    float kp_u, ki_u;
+    float kp_i, ki_i;
+};
+
+struct ChannelState {
+    CVCCRegulator regulator;
+    float u{}, i{};
+    std::uint32_t timestamp_us{};
+    // the timestamp of the sample the regulator consumed last, valid if primed
+    std::uint32_t last_timestamp_us{};
+    bool primed{};
+    bool enabled{};
+    bool fresh_sample{};
+};
+
+std::array<ChannelState, num_channels> channels;
+
+void apply_gains(bool setter);
+void reset_channels(bool setter);
+
+cranc::ApplicationConfig<std::array<std::uint8_t, num_channels>> enable_cfg {"reg.enable", "2B", reset_channels, {0, 0}};
+cranc::ApplicationConfig<Gains> gains_cfg {"reg.gains", "4f", apply_gains, {.1f, 20.f, .1f, 20.f}};
+cranc::ApplicationConfig<std::array<std::uint8_t, num_channels>> mode_cfg {"reg.mode", "2B", [](bool setter) {
+    if (not setter) {
+        for (auto i{0U}; i < num_channels; ++i) {
+            (*mode_cfg)[i] = static_cast<std::uint8_t>(channels[i].regulator.mode);
+        }
+    }
+}};
+cranc::ApplicationConfig<std::array<float, 2 * num_channels>> trim_cfg {"reg.trim", "4f"};
+
+void apply_gains(bool setter) {
+    if (not setter) {
+        return;
+    }
+    for (auto& channel : channels) {
+        auto& r = channel.regulator;
+        r.voltage.kp = gains_cfg->kp_u;
+        r.voltage.ki = gains_cfg->ki_u;
+        r.voltage.out_min = -max_voltage_correction;
+        r.voltage.out_max = max_voltage_correction;
+        r.current.kp = gains_cfg->kp_i;
+        r.current.ki = gains_cfg->ki_i;
+        r.current.out_min = -max_current_correction;
+        r.current.out_max = max_current_correction;
+    }
+}
+
+void reset_channel(std::size_t idx) {
+    channels[idx].regulator.reset();
+    channels[idx].primed = false;
+    (*trim_cfg)[2 * idx + 0] = 0;
+    (*trim_cfg)[2 * idx + 1] = 0;
+    output::set_trim(idx, 0, 0);
+}
+
+void reset_channels(bool setter) {
+    if (setter) {
+        for (auto i{0U}; i < num_channels; ++i) {
+            reset_channel(i);
+        }
+    }
+}
+
+cranc::Listener<AnalogSample> sample_listener{[](AnalogSample const& sample) {
+    cranc::LockGuard lock;
+    for (auto i{0U}; i < num_channels; ++i) {
+        channels[i].u = sample.values[2 * i + 0];
+        channels[i].i = sample.values[2 * i + 1];
+        channels[i].timestamp_us = sample.timestamp_us;
+        channels[i].fresh_sample = true;
+    }
+}};
+
+cranc::Listener<EnableCMD> enable_listener{[](EnableCMD const& cmd) {
+    if (cmd.channel >= num_channels) {
+        return;
+    }
+    channels[cmd.channel].enabled = cmd.enable;
+    if (not cmd.enable) {
+        reset_channel(cmd.channel);
+    }
+}};
+
+struct : cranc::Module {
+    using cranc::Module::Module;
+
+    cranc::coro::Task<void> task;
+
+    cranc::coro::Task<void> control_loop() {
+        cranc::coro::SwitchToMainLoop sw2main;
+        cranc::coro::AwaitableDelay ticker{cranc::getSystemTime() + control_period, control_period};
+        while (true) {
+            co_await ticker;
+            co_await sw2main;
+            output::Batch batch;
+            for (auto i{0U}; i < num_channels; ++i) {
+                auto& channel = channels[i];
+                if (not (*enable_cfg)[i] or not channel.enabled) {
+                    continue;
+                }
+                float u, current;
+                std::uint32_t timestamp_us;
+                {
+                    cranc::LockGuard lock;
+                    if (not channel.fresh_sample) {
+                        continue;
+                    }
+                    channel.fresh_sample = false;
+                    u = channel.u;
+                    current = channel.i;
+                    timestamp_us = channel.timestamp_us;
+                }
+                // at low adc rates several control periods pass per sample, integrate over the time between the samples
+                std::uint32_t elapsed_us = timestamp_us - channel.last_timestamp_us;
+                float dt = (channel.primed and elapsed_us <= max_sample_gap_us) ? elapsed_us * 1e-6f : 0.f;
+                channel.last_timestamp_us = timestamp_us;
+                channel.primed = true;
+                // regulate towards the references actually applied, a slew limited reference trails its setpoint
+                // during soft start and slews and the integrator would wind up on the difference
+                auto correction = channel.regulator.update(output::reference(2 * i + 0), output::reference(2 * i + 1), u, current, dt);
+                (*trim_cfg)[2 * i + 0] = correction.du;
+                (*trim_cfg)[2 * i + 1] = correction.di;
+                output::set_trim(i, correction.du, correction.di);
+            }
+        }
+    }
+
+    void init() override
+    {
+        apply_gains(true);
+        task = control_loop();
+    }
+} _{1000};
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// PI controller with output clamping and conditional integration as anti windup
+struct PIController {
+    // the integral gain per update is limited to this: with samples far apart ki * dt grows past what a sampled loop
+    // around a plant with a gain of about one tolerates and the loop would oscillate instead of converging
+    static constexpr float max_step_gain = .5f;
+
+    float kp{};
+    float ki{}; // per second
+    float out_min{};
+    float out_max{};
+    float integral{};
+
+    void reset() {
+        integral = 0;
+    }
+
+    // dt is the time the error was present, i.e. since the previous sample
+    float update(float error, float dt) {
+        auto proposed = integral + std::min(ki * dt, max_step_gain) * error;
+        auto out = kp * error + proposed;
+        // only integrate if that does not drive the output further into saturation
+        if ((out > out_max and error > 0) or (out < out_min and error < 0)) {
+            out = kp * error + integral;
+        } else {
+            integral = proposed;
+        }
+        integral = std::clamp(integral, out_min, out_max);
+        return std::clamp(out, out_min, out_max);
+    }
+
+    // the output while the controller is not active
+    float hold() const {
+        return integral;
+    }
+};
+
+// constant voltage / constant current regulation of one output channel
+// the regulator produces corrections for the voltage and current references of the analog output stage
+struct CVCCRegulator {
+    enum class Mode : std::uint8_t {
+        cv,
+        cc,
+    };
+
+    struct Correction {
+        float du;
+        float di;
+    };
+
+    PIController voltage;
+    PIController current;
+    Mode mode{Mode::cv};
+
+    // relative margin of the setpoint that has to be crossed to switch modes
+    float hysteresis{0.02f};
+    // the current correction of the last time the current loop settled
+    // it is restored when leaving CC mode since the loop winds up while the load is released and the voltage recovers
+    float settled_di{};
+
+    void reset() {
+        voltage.reset();
+        current.reset();
+        settled_di = 0;
+        mode = Mode::cv;
+    }
+
+    Correction update(float u_set, float i_set, float u, float i, float dt) {
+        // the output stage is current limited if the current sits at its limit while the voltage sags
+        // it leaves the current limit once the voltage got back to its setpoint
+        bool voltage_sags = u < u_set * (1 - hysteresis);
+        if (mode == Mode::cv and voltage_sags and i >= i_set * (1 - hysteresis)) {
+            mode = Mode::cc;
+        } else if (mode == Mode::cc and not voltage_sags) {
+            mode = Mode::cv;
+            current.integral = settled_di;
+        }
+
+        if (mode == Mode::cv) {
+            return {voltage.update(u_set - u, dt), current.hold()};
+        }
+        auto di = current.update(i_set - i, dt);
+        if (i >= i_set * (1 - hysteresis) and i <= i_set * (1 + hysteresis)) {
+            settled_di = current.integral;
+        }
+        return {voltage.hold(), di};
+    }
+};
@@ -1,3 +1,6 @@
+#include "relais.h"
+#include "protection.h"
+
 #include "cranc/module/Module.h"
 
 #include "cranc/coro/Task.h"
@@ -13,11 +16,6 @@ using namespace std::literals::chrono_literals;
 
 constexpr auto enable_debounce = 100ms;
 
-struct EnableCMD {
-    std::uint8_t channel;
-    bool enable;
-};
-
 cranc::MessageBufferMemory<EnableCMD, 4> msg_buffer;
 
 cranc::ApplicationConfig<std::uint8_t> output_0_enable { "output0.enable", "B", [](bool setter)
@@ -44,7 +42,9 @@ cranc::ApplicationConfig<std::uint8_t> output_1_enable { "output1.enable", "B",
 struct : cranc::Module {
     using cranc::Module::Module;
 
-    cranc::coro::FAFTask work(std::uint8_t channel, std::uint8_t gnd_en, std::uint8_t out_en) {
+    cranc::coro::FAFTask work(std::uint8_t channel, cranc::ApplicationConfig<std::uint8_t>& enable_cfg) {
+        auto gnd_en = output_pins[channel].gnd_en;
+        auto out_en = output_pins[channel].out_en;
 
         gpio_init(gnd_en);
         gpio_init(out_en);
@@ -61,10 +61,27 @@ struct : cranc::Module {
 
         while (true) {
             auto msg = co_await event;
+            if (msg.enable and protection::tripped(channel)) {
+                msg.enable = false;
+            }
+            // the command might not originate from the config (e.g. from a protection trip)
+            *enable_cfg = msg.enable;
             if (msg.enable) {
                 gpio_put(gnd_en, true);
                 co_await cranc::coro::AwaitableDelay{enable_debounce};
-                gpio_put(out_en, true);
+                // a trip during the debounce already dropped out_en and must not be undone
+                bool refused;
+                {
+                    cranc::LockGuard lock;
+                    refused = protection::tripped(channel);
+                    if (not refused) {
+                        gpio_put(out_en, true);
+                    }
+                }
+                if (refused) {
+                    *enable_cfg = false;
+                    gpio_put(gnd_en, false);
+                }
             } else {
                 gpio_put(out_en, false);
                 co_await cranc::coro::AwaitableDelay{enable_debounce};
@@ -79,8 +96,8 @@ struct : cranc::Module {
     {
         output_0_enable.set(0);
         output_1_enable.set(0);
-        work(0, 4, 5);
-        work(1, 2, 3);
+        work(0, output_0_enable);
+        work(1, output_1_enable);
     }
 } _{1000};
 
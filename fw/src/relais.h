@@ -0,0 +1,19 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+struct EnableCMD {
+    std::uint8_t channel;
+    bool enable;
+};
+
+struct OutputPins {
+    std::uint8_t gnd_en;
+    std::uint8_t out_en;
+};
+
+constexpr std::array<OutputPins, 2> output_pins {{
+    {4, 5},
+    {2, 3},
+}};
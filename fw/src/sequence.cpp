@@ -0,0 +1,241 @@
+#include "output.h"
+#include "relais.h"
+#include "buttons.h"
+#include "util/Sequence.h"
+
+#include "cranc/module/Module.h"
+#include "cranc/msg/Message.h"
+#include "cranc/platform/system.h"
+#include "cranc/timer/swTimer.h"
+#include "cranc/timer/systemTime.h"
+
+#include "cranc/config/ApplicationConfig.h"
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <utility>
+
+namespace {
+
+constexpr std::size_t num_channels = 2;
+constexpr std::size_t max_steps = 256;
+
+enum class State : std::uint8_t {
+    idle,
+    waiting_for_trigger,
+    running,
+};
+
+enum class TriggerSource : std::uint8_t {
+    immediate,
+    button0,
+    button1,
+};
+
+struct StepUpload {
+    std::uint8_t channel;
+    std::uint16_t index;
+    SequenceStep step;
+};
+
+struct RunCMD {
+    std::uint8_t channel;
+    TriggerSource trigger;
+    std::uint16_t loops; // 0 repeats forever
+};
+
+struct Status {
+    std::array<State, num_channels> state;
+    std::array<std::uint16_t, num_channels> step;
+    std::array<std::uint16_t, num_channels> loop;
+};
+
+// a step the timer moved to, its channel applies it from the main loop
+struct StepDue {
+    std::uint8_t channel;
+};
+
+cranc::MessageBufferMemory<EnableCMD, 4> msg_buffer;
+cranc::MessageBufferMemory<StepDue, num_channels> due_buffer;
+
+std::uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(cranc::getSystemTime()).count();
+}
+
+struct Channel {
+    std::uint8_t idx;
+    std::array<SequenceStep, max_steps> table{};
+    std::uint16_t length{};
+    SequencePlayer player;
+    State state{State::idle};
+    TriggerSource trigger{};
+    std::uint16_t loops{};
+    bool output_enabled{};
+    // the latest step the timer moved to and not applied yet, at most one StepDue is in flight per channel
+    std::optional<SequenceStep> due;
+
+    // runs in timer interrupt context, only keeps the time base; the output path is left to the main loop
+    cranc::Timer timer{[this](int) {
+        cranc::LockGuard lock;
+        if (state != State::running) {
+            return;
+        }
+        if (not player.advance(now_us())) {
+            state = State::idle;
+            return;
+        }
+        bool post = not due;
+        due = player.current();
+        schedule();
+        if (post) {
+            if (auto msg = due_buffer.getFreeMessage(StepDue{idx})) {
+                msg->post();
+            }
+        }
+    }};
+
+    void schedule() {
+        timer.start(std::chrono::microseconds{player.deadline_us()});
+    }
+
+    // main loop only
+    void apply(SequenceStep const& step) {
+        output::Batch batch;
+        output::set_setpoint(2 * idx + 0, step.u_mV * 1e-3f);
+        output::set_setpoint(2 * idx + 1, step.i_mA * 1e-3f);
+        if (step.enabled() != output_enabled) {
+            output_enabled = step.enabled();
+            // the relais switching sequence adds its debounce delay on top
+            if (auto msg = msg_buffer.getFreeMessage(EnableCMD{idx, output_enabled})) {
+                msg->post();
+            }
+        }
+    }
+
+    void apply_due() {
+        std::optional<SequenceStep> step;
+        {
+            cranc::LockGuard lock;
+            step = std::exchange(due, std::nullopt);
+        }
+        if (step) {
+            apply(*step);
+        }
+    }
+
+    void begin() {
+        SequenceStep first;
+        {
+            cranc::LockGuard lock;
+            timer.stop();
+            due.reset();
+            if (not player.start({table.data(), length}, loops, now_us())) {
+                state = State::idle;
+                return;
+            }
+            state = State::running;
+            first = player.current();
+            schedule();
+        }
+        apply(first);
+    }
+
+    void arm(TriggerSource source, std::uint16_t loop_count) {
+        {
+            cranc::LockGuard lock;
+            stop();
+            trigger = source;
+            loops = loop_count;
+            state = State::waiting_for_trigger;
+        }
+        if (trigger == TriggerSource::immediate) {
+            begin();
+        }
+    }
+
+    void stop() {
+        cranc::LockGuard lock;
+        timer.stop();
+        player.stop();
+        due.reset();
+        state = State::idle;
+    }
+};
+
+std::array<Channel, num_channels> channels {{ {0}, {1} }};
+
+cranc::ApplicationConfig<StepUpload> step_cfg {"seq.step", "BHIHH", [](bool setter) {
+    auto const& upload = *step_cfg;
+    if (not setter or upload.channel >= num_channels or upload.index >= max_steps) {
+        return;
+    }
+    auto& channel = channels[upload.channel];
+    cranc::LockGuard lock;
+    // the table is not touched while it is played back
+    if (channel.state == State::idle) {
+        channel.table[upload.index] = upload.step;
+    }
+}};
+
+cranc::ApplicationConfig<std::array<std::uint16_t, num_channels>> length_cfg {"seq.length", "2H", [](bool setter) {
+    cranc::LockGuard lock;
+    for (auto i{0U}; i < num_channels; ++i) {
+        auto& channel = channels[i];
+        if (setter and channel.state == State::idle) {
+            channel.length = std::min<std::size_t>((*length_cfg)[i], max_steps);
+        }
+        (*length_cfg)[i] = channel.length;
+    }
+}};
+
+cranc::ApplicationConfig<RunCMD> run_cfg {"seq.run", "BBH", [](bool setter) {
+    auto const& cmd = *run_cfg;
+    if (setter and cmd.channel < num_channels) {
+        channels[cmd.channel].arm(cmd.trigger, cmd.loops);
+    }
+}};
+
+cranc::ApplicationConfig<void> stop_cfg {"seq.stop", [] {
+    for (auto& channel : channels) {
+        channel.stop();
+    }
+}};
+
+cranc::ApplicationConfig<Status> status_cfg {"seq.status", "2B2H2H", [](bool setter) {
+    if (setter) {
+        return;
+    }
+    cranc::LockGuard lock;
+    for (auto i{0U}; i < num_channels; ++i) {
+        auto const& channel = channels[i];
+        status_cfg->state[i] = channel.state;
+        status_cfg->step[i] = channel.player.index;
+        status_cfg->loop[i] = channel.player.loop;
+    }
+}};
+
+cranc::Listener<buttons::Event> button_listener{[](buttons::Event const& event) {
+    if (event.st != buttons::state::pressed) {
+        return;
+    }
+    auto source = event.btn == buttons::button::btn0 ? TriggerSource::button0 : TriggerSource::button1;
+    for (auto& channel : channels) {
+        if (channel.state == State::waiting_for_trigger and channel.trigger == source) {
+            channel.begin();
+        }
+    }
+}};
+
+cranc::Listener<StepDue> due_listener{[](StepDue const& msg) {
+    channels[msg.channel].apply_due();
+}};
+
+// keep track of enables coming from elsewhere so a sequence only posts actual changes
+cranc::Listener<EnableCMD> enable_listener{[](EnableCMD const& cmd) {
+    if (cmd.channel < num_channels) {
+        channels[cmd.channel].output_enabled = cmd.enable;
+    }
+}};
+
+}
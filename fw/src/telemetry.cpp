@@ -0,0 +1,151 @@
+#include "analog_readings.h"
+#include "output.h"
+#include "protection.h"
+#include "relais.h"
+
+#include "cranc/module/Module.h"
+#include "cranc/msg/Message.h"
+#include "cranc/coro/Awaitable.h"
+#include "cranc/coro/Task.h"
+#include "cranc/coro/SwitchToMainLoop.h"
+#include "cranc/platform/system.h"
+#include "cranc/timer/systemTime.h"
+
+#include "cranc/config/ApplicationConfig.h"
+
+#include "usb/usb_dev.h"
+#include "util/Telemetry.h"
+
+#include <array>
+#include <chrono>
+
+namespace {
+
+using namespace usb::literals;
+using namespace std::literals::chrono_literals;
+
+// a batch has to fit into one transfer the host reads at once
+constexpr std::size_t frames_per_batch = 512 / sizeof(TelemetryFrame);
+constexpr auto flush_period = 5ms;
+
+auto interface_name = "telemetry interface"_usb_str;
+
+TelemetryBatcher<frames_per_batch> batcher;
+std::array<bool, 2> enabled{};
+std::uint16_t sample_count{};
+
+// every decimation-th round through the adc schedule is streamed, 0 stops the stream
+cranc::ApplicationConfig<std::uint16_t> decimation_cfg {"telem.decimation", "H", 0};
+
+struct Stats {
+    std::uint32_t frames;
+    std::uint32_t dropped;
+};
+cranc::ApplicationConfig<Stats> stats_cfg {"telem.stats", "2I", [](bool setter) {
+    cranc::LockGuard lock;
+    if (setter) {
+        batcher.dropped = stats_cfg->dropped;
+        return;
+    }
+    *stats_cfg = {batcher.next_seq, batcher.dropped};
+}};
+
+cranc::coro::Task<void> sender_task;
+cranc::coro::Awaitable<void, cranc::LockGuard> usb_tx_done;
+
+std::array<usb::endpoint, 1> eps = {
+    usb::endpoint{
+        .descriptor = {
+            .bEndpointAddress = USB_DIR_IN | 3,
+            .bmAttributes = USB_TRANSFER_TYPE_BULK,
+            .wMaxPacketSize = 64,
+            .bInterval = 1,
+        },
+        .double_buffered = true,
+        .cb = [](std::span<std::uint8_t>) {
+            usb_tx_done();
+        },
+    },
+};
+auto& ep_in = eps[0];
+
+std::array<usb::usb_iface_setting, 1> iface_settings {
+    usb::usb_iface_setting{
+        .descriptor = {
+            .bInterfaceClass = 0xff,
+            .bInterfaceSubClass = 0x00,
+            .bInterfaceProtocol = 0x00,
+            .iInterface = interface_name,
+        },
+        .endpoints = eps,
+    },
+};
+
+usb::Interface iface {
+    default_usb_dev::config,
+    iface_settings
+};
+
+cranc::coro::Task<void> sender() {
+    cranc::coro::SwitchToMainLoop sw2main;
+    cranc::coro::AwaitableDelay ticker{cranc::getSystemTime() + flush_period, flush_period};
+    while (true) {
+        co_await ticker;
+        co_await sw2main;
+        std::span<std::uint8_t const> batch;
+        {
+            cranc::LockGuard lock;
+            batch = batcher.take();
+        }
+        // the sampling path fills the other batch meanwhile
+        if (not batch.empty()) {
+            usb_tx_done.clear();
+            ep_in.send_all(batch);
+            co_await usb_tx_done;
+        }
+    }
+}
+
+cranc::Listener<EnableCMD> enable_listener{[](EnableCMD const& cmd) {
+    if (cmd.channel < enabled.size()) {
+        enabled[cmd.channel] = cmd.enable;
+    }
+}};
+
+cranc::Listener<AnalogSample> sample_listener{[](AnalogSample const& sample) {
+    if (*decimation_cfg == 0 or ++sample_count < *decimation_cfg) {
+        return;
+    }
+    sample_count = 0;
+
+    TelemetryFrame frame{};
+    frame.timestamp_us = sample.timestamp_us;
+    frame.status = (enabled[0] ? enabled0 : 0)
+                 | (enabled[1] ? enabled1 : 0)
+                 | (protection::tripped(0) ? tripped0 : 0)
+                 | (protection::tripped(1) ? tripped1 : 0);
+    for (auto i{0U}; i < frame.measured.size(); ++i) {
+        frame.measured[i] = sample.milli[i].val;
+        frame.setpoints[i] = ScaledNumber<std::int32_t, std::milli>::from_float(output::setpoint(i)).val;
+    }
+    cranc::LockGuard lock;
+    batcher.push(frame);
+}};
+
+struct : cranc::Module {
+    using cranc::Module::Module;
+
+    void init() override {
+        iface.on_altsetting_changed = []() {
+            cranc::LockGuard lock;
+            sender_task.terminate();
+            if (not iface.cur_active_altsetting.has_value()) {
+                return;
+            }
+            batcher.take(); // don't replay what piled up while nobody listened
+            sender_task = sender();
+        };
+    }
+} _{1000};
+
+}
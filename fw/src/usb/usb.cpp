@@ -1,5 +1,6 @@
 #include "usb.h"
 #include "usb_dev.h"
+#include "usb_endpoint.h"
 
 #include "cranc/module/Module.h"
 #include "cranc/timer/swTimer.h"
@@ -36,6 +37,19 @@
 #define usb_hw_clear hw_clear_alias(usb_hw)
 
 namespace usb{
+
+void usb_12_cycle_delay() {
+	__asm volatile (
+			"b 1f\n"
+			"1: b 1f\n"
+			"1: b 1f\n"
+			"1: b 1f\n"
+			"1: b 1f\n"
+			"1: b 1f\n"
+			"1:\n"
+			: : : "memory");
+}
+
 namespace
 {
 
@@ -102,23 +116,6 @@ cranc::coro::Generator<std::span<const std::uint8_t>> chunkify(std::span<const s
 	}
 }
 
-struct usb_endpoint_configuration {
-    endpoint const *descriptor;
-
-    // Pointers to endpoint + buffer control registers
-    // in the USB controller DPSRAM
-    volatile std::uint32_t *endpoint_control;
-    volatile std::uint32_t *buffer_control;
-    std::span<uint8_t> data_buffer;
-    std::span<uint8_t> data_buffer0;
-    std::span<uint8_t> data_buffer1;
-
-    // Toggle after each packet (unless replying to a SETUP)
-    std::uint8_t next_pid;
-
-	std::uint32_t db_iso_offset;
-};
-
 std::array<usb_endpoint_configuration, 16> out_ep_configurations{};
 std::array<usb_endpoint_configuration, 16> in_ep_configurations{};
 
@@ -166,71 +163,6 @@ Interface* interface_by_index(std::uint8_t idx) {
 	return {};
 }
 
-static void usb_12_cycle_delay() {
-	__asm volatile (
-			"b 1f\n"
-			"1: b 1f\n"
-			"1: b 1f\n"
-			"1: b 1f\n"
-			"1: b 1f\n"
-			"1: b 1f\n"
-			"1:\n"
-			: : : "memory");
-}
-
-std::span<std::uint8_t> get_buffer(usb_endpoint_configuration& ep) {
-	assert(ep.descriptor);
-	assert(USB_DIR_IN == (ep.descriptor->descriptor.bEndpointAddress & USB_DIR_IN));
-	if (0 == (*ep.buffer_control & USB_BUF_CTRL_AVAIL)) {
-		return ep.data_buffer0;
-	}
-	if (ep.descriptor->double_buffered) {
-		if (0 == (*ep.buffer_control & (USB_BUF_CTRL_AVAIL << 16))) {
-			return ep.data_buffer1;
-		}
-	}
-	return {};
-}
-
-void flush_prefilled_buffer(usb_endpoint_configuration& ep, std::size_t size, bool buf1=false) {
-	assert(ep.descriptor);
-	assert(USB_DIR_IN == (ep.descriptor->descriptor.bEndpointAddress & USB_DIR_IN));
-
-	std::uint32_t shift = buf1?16:0;
-	std::uint32_t buf_ctl_other_buf = (*ep.buffer_control) & (0xffff << (16-shift));
-
-    std::uint32_t buf_ctl = size | USB_BUF_CTRL_FULL | USB_BUF_CTRL_LAST;
-    buf_ctl |= ep.next_pid ? USB_BUF_CTRL_DATA1_PID : USB_BUF_CTRL_DATA0_PID;
-    
-	ep.next_pid ^= 1u;
-
-	*ep.buffer_control = buf_ctl_other_buf | ((buf_ctl) << shift); 
-	usb_12_cycle_delay();
-	*ep.buffer_control = buf_ctl_other_buf | ((buf_ctl | USB_BUF_CTRL_AVAIL) << shift); 
-}
-
-
-std::size_t tx_data(usb_endpoint_configuration& ep, std::span<const std::uint8_t> data) {
-	assert(ep.descriptor);
-	assert(USB_DIR_IN == (ep.descriptor->descriptor.bEndpointAddress & USB_DIR_IN));
-
-	if (data.data() == ep.data_buffer0.data()) {
-		assert(data.size() <= ep.data_buffer0.size());
-		flush_prefilled_buffer(ep, data.size(), false);
-		return data.size();
-	}
-	if (ep.data_buffer1.data() and (data.data() == ep.data_buffer1.data())) {
-		assert(data.size() <= ep.data_buffer1.size());
-		flush_prefilled_buffer(ep, data.size(), true);
-		return data.size();
-	}
-	auto buffer = get_buffer(ep);
-	data = trim_span(data, buffer.size());
-	memcpy((void *)buffer.data(), data.data(), data.size());
-	flush_prefilled_buffer(ep, data.size(), buffer.data() == ep.data_buffer1.data());
-	return data.size();
-}
-
 void start_rx(usb_endpoint_configuration& ep) {
 	assert(ep.descriptor);
 	assert(USB_DIR_OUT == (ep.descriptor->descriptor.bEndpointAddress & USB_DIR_OUT));
@@ -318,6 +250,7 @@ bool disable_altsetting(usb::Interface& iface) {
 	for (auto& ep : setting.endpoints) {
 		auto& config = config_for_ep(ep.descriptor.bEndpointAddress);
 		*config.endpoint_control = 0;
+		reset_transfer(config);
 	}
 	iface->cur_active_altsetting.reset();
 	iface->on_altsetting_changed();
@@ -352,6 +285,7 @@ bool enable_altsetting(usb::Interface& iface, std::uint8_t alt_setting_no) {
 			config.descriptor = &ep;
 			*config.buffer_control = 0;
 			config.next_pid = 0;
+			reset_transfer(config);
 			config.data_buffer0 = config.data_buffer;
 			config.data_buffer1 = {};
 			uint32_t reg = EP_CTRL_ENABLE_BITS
@@ -637,6 +571,7 @@ cranc::coro::Task<void> set_device_configuration(control_data pkt) {
 		*config.endpoint_control = 0;
 		*config.buffer_control   = 0;
 		config.next_pid = 0;
+		reset_transfer(config);
 	}
 
 
@@ -1033,11 +968,7 @@ void usb_handle_buff_status() {
 			if (not ep_cfg.descriptor) {
 				continue;
 			}
-			if ((usb_hw->buf_cpu_should_handle & in_bit) == 0) {
-				ep_cfg.descriptor->cb(ep_cfg.data_buffer0);
-			} else {
-				ep_cfg.descriptor->cb(ep_cfg.data_buffer1);
-			}
+			in_buffer_done(ep_cfg, usb_hw->buf_cpu_should_handle & in_bit);
         }
         if (done_eps & out_bit) {
             // clear this in advance
@@ -1224,4 +1155,9 @@ std::size_t endpoint::send(std::span<const std::uint8_t> buffer) {
 	return tx_data(config, buffer);
 }
 
+bool endpoint::send_all(std::span<const std::uint8_t> buffer) {
+	auto& config = config_for_ep(descriptor.bEndpointAddress);
+	return start_transfer(config, buffer);
+}
+
 }
@@ -111,6 +111,9 @@ struct endpoint {
 
     std::span<std::uint8_t> getNextTxBuffer();
     std::size_t send(std::span<const std::uint8_t> buffer);
+    // queues the whole buffer as one transfer (terminated by a short or zero length packet), cb is called once when it is done
+    // the buffer has to stay untouched until then, returns false if a transfer is still in progress
+    bool send_all(std::span<const std::uint8_t> buffer);
 };
 
 struct usb_iface_setting {
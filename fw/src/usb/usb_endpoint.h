@@ -0,0 +1,176 @@
+#pragma once
+
+#include "usb.h"
+
+#include "cranc/platform/system.h"
+
+#include "util/span_helpers.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+/*
+ * the in side of an endpoint's buffer control in the usb dpram: handing packets to the controller one by one or as a
+ * whole transfer refilled from the buffer status interrupt, double buffered or not
+ * only touches the endpoint's buffer control register and its buffers, the host tests run it against a model of them
+ */
+
+namespace usb {
+
+struct usb_endpoint_configuration {
+    endpoint const *descriptor;
+
+    // Pointers to endpoint + buffer control registers
+    // in the USB controller DPSRAM
+    volatile std::uint32_t *endpoint_control;
+    volatile std::uint32_t *buffer_control;
+    std::span<uint8_t> data_buffer;
+    std::span<uint8_t> data_buffer0;
+    std::span<uint8_t> data_buffer1;
+
+    // Toggle after each packet (unless replying to a SETUP)
+    std::uint8_t next_pid;
+
+	std::uint32_t db_iso_offset;
+
+	// multi packet transfer queued by send_all, refilled from the buffer status interrupt
+	std::span<const std::uint8_t> pending_tx;
+	bool pending_zlp;
+	bool transfer_active;
+};
+
+// the controller may only see the available bit set 12 cycles after the rest of the buffer control was written
+void usb_12_cycle_delay();
+
+// the controller alternates between the buffers of a double buffered endpoint starting with buffer 0,
+// as every packet toggles the pid the next buffer is the one matching next_pid
+inline bool next_is_buf1(usb_endpoint_configuration const& ep) {
+	return ep.descriptor->double_buffered and ep.next_pid;
+}
+
+inline std::span<std::uint8_t> get_buffer(usb_endpoint_configuration& ep) {
+	assert(ep.descriptor);
+	assert(USB_DIR_IN == (ep.descriptor->descriptor.bEndpointAddress & USB_DIR_IN));
+	auto buf1 = next_is_buf1(ep);
+	if (0 != (*ep.buffer_control & (USB_BUF_CTRL_AVAIL << (buf1 ? 16 : 0)))) {
+		return {};
+	}
+	return buf1 ? ep.data_buffer1 : ep.data_buffer0;
+}
+
+inline void flush_prefilled_buffer(usb_endpoint_configuration& ep, std::size_t size, bool buf1=false) {
+	assert(ep.descriptor);
+	assert(USB_DIR_IN == (ep.descriptor->descriptor.bEndpointAddress & USB_DIR_IN));
+
+    std::uint32_t buf_ctl = size | USB_BUF_CTRL_FULL | USB_BUF_CTRL_LAST;
+    buf_ctl |= ep.next_pid ? USB_BUF_CTRL_DATA1_PID : USB_BUF_CTRL_DATA0_PID;
+    
+	ep.next_pid ^= 1u;
+
+	if (ep.descriptor->double_buffered) {
+		// the controller may be completing the other buffer right now, so leave its half alone
+		auto half = reinterpret_cast<volatile std::uint16_t*>(ep.buffer_control) + (buf1 ? 1 : 0);
+		*half = buf_ctl;
+		usb_12_cycle_delay();
+		*half = buf_ctl | USB_BUF_CTRL_AVAIL;
+		return;
+	}
+
+	std::uint32_t shift = buf1?16:0;
+	std::uint32_t buf_ctl_other_buf = (*ep.buffer_control) & (0xffff << (16-shift));
+
+	*ep.buffer_control = buf_ctl_other_buf | ((buf_ctl) << shift); 
+	usb_12_cycle_delay();
+	*ep.buffer_control = buf_ctl_other_buf | ((buf_ctl | USB_BUF_CTRL_AVAIL) << shift); 
+}
+
+
+inline std::size_t tx_data(usb_endpoint_configuration& ep, std::span<const std::uint8_t> data) {
+	assert(ep.descriptor);
+	assert(USB_DIR_IN == (ep.descriptor->descriptor.bEndpointAddress & USB_DIR_IN));
+
+	if (data.data() == ep.data_buffer0.data()) {
+		assert(data.size() <= ep.data_buffer0.size());
+		flush_prefilled_buffer(ep, data.size(), false);
+		return data.size();
+	}
+	if (ep.data_buffer1.data() and (data.data() == ep.data_buffer1.data())) {
+		assert(data.size() <= ep.data_buffer1.size());
+		flush_prefilled_buffer(ep, data.size(), true);
+		return data.size();
+	}
+	auto buffer = get_buffer(ep);
+	if (not buffer.data()) {
+		return 0;
+	}
+	data = trim_span(data, buffer.size());
+	if (not data.empty()) { // a zero length packet may come without a buffer
+		memcpy((void *)buffer.data(), data.data(), data.size());
+	}
+	flush_prefilled_buffer(ep, data.size(), buffer.data() == ep.data_buffer1.data());
+	return data.size();
+}
+
+// hands out packets of the pending transfer for as long as there are free buffers
+inline void fill_transfer(usb_endpoint_configuration& ep) {
+	while (not ep.pending_tx.empty() or ep.pending_zlp) {
+		auto buffer = get_buffer(ep);
+		if (not buffer.data()) {
+			return;
+		}
+		auto chunk = trim_span(ep.pending_tx, ep.descriptor->descriptor.wMaxPacketSize);
+		if (chunk.empty()) {
+			ep.pending_zlp = false;
+		} else {
+			std::memcpy(buffer.data(), chunk.data(), chunk.size());
+			ep.pending_tx = ep.pending_tx.subspan(chunk.size());
+		}
+		flush_prefilled_buffer(ep, chunk.size(), buffer.data() == ep.data_buffer1.data());
+	}
+}
+
+inline bool tx_idle(usb_endpoint_configuration const& ep) {
+	std::uint32_t avail = USB_BUF_CTRL_AVAIL;
+	if (ep.descriptor->double_buffered) {
+		avail |= USB_BUF_CTRL_AVAIL << 16;
+	}
+	return 0 == (*ep.buffer_control & avail);
+}
+
+inline bool start_transfer(usb_endpoint_configuration& ep, std::span<const std::uint8_t> data) {
+	assert(ep.descriptor);
+	assert(USB_DIR_IN == (ep.descriptor->descriptor.bEndpointAddress & USB_DIR_IN));
+	cranc::LockGuard lock;
+	if (ep.transfer_active) {
+		return false;
+	}
+	// a transfer that ends on a full packet needs a zero length packet to tell the host it is complete
+	ep.pending_tx = data;
+	ep.pending_zlp = data.size() % ep.descriptor->descriptor.wMaxPacketSize == 0;
+	ep.transfer_active = true;
+	fill_transfer(ep);
+	return true;
+}
+
+inline void reset_transfer(usb_endpoint_configuration& ep) {
+	ep.pending_tx = {};
+	ep.pending_zlp = false;
+	ep.transfer_active = false;
+}
+
+// the in endpoint part of the buffer status interrupt, buf1 tells which buffer the controller completed
+inline void in_buffer_done(usb_endpoint_configuration& ep, bool buf1) {
+	if (ep.transfer_active) {
+		fill_transfer(ep);
+		if (ep.pending_tx.empty() and not ep.pending_zlp and tx_idle(ep)) {
+			ep.transfer_active = false;
+			ep.descriptor->cb({});
+		}
+		return;
+	}
+	ep.descriptor->cb(buf1 ? ep.data_buffer1 : ep.data_buffer0);
+}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "cranc/timer/systemTime.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * the settings of the ADS1115 behind analog_readings.cpp: the config register of a single shot conversion, the physical
+ * units per count of a channel at a PGA setting and the order the channels are sampled in
+ * PGA and data rate codes only have three bits, higher bits are ignored like the adc does
+ */
+
+namespace adc
+{
+
+constexpr std::size_t num_channels = 4;
+constexpr std::size_t max_schedule_len = 16;
+constexpr std::uint8_t schedule_end = 0xff;
+
+using Schedule = std::array<std::uint8_t, max_schedule_len>;
+
+struct ChannelInfo {
+    std::uint8_t mux;
+    float gain; // physical unit per volt at the adc input
+};
+
+constexpr std::array<ChannelInfo, num_channels> channels {{
+    {0b110, (91.+13)/13},     // OUT_SENSE_0 2
+    {0b111, 1. / (100*5e-3)}, // CUR_SENSE_0 3
+    {0b101, (91.+13)/13},     // OUT_SENSE_1 1
+    {0b100, 1. / (100*5e-3)}, // CUR_SENSE_1 0
+}};
+
+// full scale ranges of the PGA settings (in volts), the codes 0b110 and 0b111 alias 0b101
+constexpr std::array<float, 8> pga_full_scale {
+    6.144, 4.096, 2.048, 1.024, 0.512, 0.256, 0.256, 0.256
+};
+
+// samples per second of the data rate settings
+constexpr std::array<std::uint16_t, 8> data_rates {
+    8, 16, 32, 64, 128, 250, 475, 860
+};
+
+constexpr std::uint8_t default_pga  = 0b000;
+constexpr std::uint8_t default_rate = 0b111;
+
+constexpr float reading_to_value_scale(std::size_t channel, std::uint8_t pga) {
+    return pga_full_scale[pga & 0b111] / ((1 << 15) - 1) * channels[channel].gain;
+}
+
+constexpr std::array<std::uint8_t, 2> conversion_config(std::size_t channel, std::uint8_t pga, std::uint8_t rate) {
+    return {
+        static_cast<std::uint8_t>(0b1'000'000'1 | (channels[channel].mux << 4) | ((pga & 0b111) << 1)),
+        static_cast<std::uint8_t>(0b000'0'1'1'00 | ((rate & 0b111) << 5)),
+    };
+}
+
+constexpr cranc::Duration conversion_timeout(std::uint8_t rate) {
+    using namespace std::literals::chrono_literals;
+    cranc::Duration conversion_time = std::chrono::microseconds{1'000'000 / data_rates[rate & 0b111]};
+    return std::max<cranc::Duration>(50ms, 2 * conversion_time);
+}
+
+// the channels a round samples up to the first entry that is not a channel, all of them if the first one isn't
+constexpr Schedule sampled_schedule(Schedule const& schedule) {
+    if (schedule[0] >= num_channels) {
+        return {0, 1, 2, 3, schedule_end};
+    }
+    return schedule;
+}
+
+}
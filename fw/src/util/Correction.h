@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+/*
+ * fixed point correction curves for the output path (the rp2040 has no fpu)
+ * inputs and outputs carry correction_frac_bits fractional bits, polynomial coefficients carry coefficient_frac_bits
+ */
+
+constexpr int correction_frac_bits = 16;
+constexpr int coefficient_frac_bits = 24;
+
+constexpr std::int32_t to_correction_fixed(float v) {
+    return static_cast<std::int32_t>(v * (1 << correction_frac_bits));
+}
+
+constexpr float from_correction_fixed(std::int32_t v) {
+    return static_cast<float>(v) / (1 << correction_frac_bits);
+}
+
+constexpr std::int32_t saturate_i32(std::int64_t v) {
+    return static_cast<std::int32_t>(std::clamp<std::int64_t>(v, std::numeric_limits<std::int32_t>::min(), std::numeric_limits<std::int32_t>::max()));
+}
+
+// c[0] + c[1] x + ... + c[N-1] x^(N-1) evaluated with horner's scheme
+template<std::size_t N>
+struct FixedPolynomial {
+    static_assert(N >= 1);
+
+    std::array<std::int32_t, N> coefficients{};
+
+    // missing coefficients are zero, the others are rounded (a truncated cubic term alone is off by a millivolt at 30 V)
+    void set(std::span<float const> c) {
+        coefficients = {};
+        for (auto i{0U}; i < std::min(N, c.size()); ++i) {
+            coefficients[i] = saturate_i32(std::llround(static_cast<double>(c[i]) * (1 << coefficient_frac_bits)));
+        }
+    }
+
+    // inputs are limited to +-max_input and the accumulator to the 32 bit output range so acc * x fits into 64 bits
+    static constexpr std::int32_t max_input = std::int32_t{128} << correction_frac_bits;
+
+    constexpr std::int32_t operator()(std::int32_t x) const {
+        x = std::clamp(x, -max_input, max_input);
+        std::int64_t acc = coefficients[N - 1];
+        for (auto i{N - 1}; i > 0; --i) {
+            acc = ((acc * x) >> correction_frac_bits) + coefficients[i - 1];
+            acc = std::clamp<std::int64_t>(acc, std::numeric_limits<std::int32_t>::min() * std::int64_t{256}, std::numeric_limits<std::int32_t>::max() * std::int64_t{256});
+        }
+        return saturate_i32(acc >> (coefficient_frac_bits - correction_frac_bits));
+    }
+};
+
+// linear interpolation between up to N points, extrapolates with the first and last segment
+// with less than two points it is the identity
+// segments steeper than +-128 saturate
+template<std::size_t N>
+struct PiecewiseLinear {
+    static_assert(N >= 2);
+
+    std::array<std::int32_t, N> xs{};
+    std::array<std::int32_t, N> ys{};
+    // dy/dx of the segment starting at each point with slope_frac_bits, precomputed to keep divisions out of the
+    // evaluation; with correction_frac_bits a segment ten units long would miss its end point by several lsb
+    static constexpr int slope_frac_bits = 24;
+    std::array<std::int32_t, N> slopes{};
+    std::size_t count{};
+
+    // points have to be sorted by x, evaluation stops at the first point that is not
+    void set(std::span<float const> x, std::span<float const> y, std::size_t num_points) {
+        count = std::min({num_points, N, x.size(), y.size()});
+        for (auto i{0U}; i < count; ++i) {
+            xs[i] = to_correction_fixed(x[i]);
+            ys[i] = to_correction_fixed(y[i]);
+            if (i > 0 and xs[i] <= xs[i - 1]) {
+                count = i;
+                break;
+            }
+        }
+        for (auto i{0U}; i + 1 < count; ++i) {
+            std::int64_t dy = static_cast<std::int64_t>(ys[i + 1]) - ys[i];
+            std::int64_t dx = static_cast<std::int64_t>(xs[i + 1]) - xs[i];
+            std::int64_t scaled = dy << slope_frac_bits;
+            slopes[i] = saturate_i32((scaled + (scaled < 0 ? -dx : dx) / 2) / dx);
+        }
+        if (count < 2) {
+            count = 0;
+        }
+    }
+
+    constexpr std::int32_t operator()(std::int32_t x) const {
+        if (count == 0) {
+            return x;
+        }
+        std::size_t seg = 0;
+        while (seg + 2 < count and x >= xs[seg + 1]) {
+            ++seg;
+        }
+        // limited so the product with the slope fits into 64 bits
+        std::int64_t dx = std::clamp<std::int64_t>(static_cast<std::int64_t>(x) - xs[seg], std::numeric_limits<std::int32_t>::min(), std::numeric_limits<std::int32_t>::max());
+        return saturate_i32(ys[seg] + ((dx * slopes[seg] + (std::int64_t{1} << (slope_frac_bits - 1))) >> slope_frac_bits));
+    }
+};
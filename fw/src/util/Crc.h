@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <cstdint>
+
+namespace detail {
+
+// one lookup per byte, slice-by-8 would be faster still but needs 8 KiB of tables
+constexpr std::array<std::uint32_t, 256> crc32_table = [] {
+    std::array<std::uint32_t, 256> table{};
+    for (auto i = 0U; i < table.size(); ++i) {
+        std::uint32_t crc = i;
+        for (auto b = 0; b < 8; ++b) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+}
+
+// crc-32 (ieee 802.3), pass the previous result as crc to continue over several spans
+constexpr std::uint32_t crc32(std::span<const std::uint8_t> data, std::uint32_t crc = 0) {
+    crc = ~crc;
+    for (auto b : data) {
+        crc = (crc >> 8) ^ detail::crc32_table[(crc ^ b) & 0xff];
+    }
+    return ~crc;
+}
+
+static_assert(crc32(std::array<std::uint8_t, 9>{'1', '2', '3', '4', '5', '6', '7', '8', '9'}) == 0xcbf43926);
+static_assert(crc32(std::array<std::uint8_t, 5>{'5', '6', '7', '8', '9'}, crc32(std::array<std::uint8_t, 4>{'1', '2', '3', '4'})) == 0xcbf43926);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <algorithm>
+
+/*
+ * first order sigma delta modulation of a pwm compare level
+ * a level with `bits` fractional bits is spread over 2^bits consecutive pwm periods, the integer levels of the
+ * sequence average to exactly the requested level and the +1 periods are distributed as evenly as possible
+ */
+constexpr void sigma_delta_sequence(std::uint32_t level, std::uint8_t bits, std::span<std::uint16_t> out) {
+    std::uint32_t const one = std::uint32_t{1} << bits;
+    std::uint32_t const base = level >> bits;
+    std::uint32_t const frac = level & (one - 1);
+    std::uint32_t error = 0;
+    for (auto& v : out) {
+        error += frac;
+        std::uint32_t carry = 0;
+        if (error >= one) {
+            error -= one;
+            carry = 1;
+        }
+        v = static_cast<std::uint16_t>(std::min<std::uint32_t>(base + carry, 0xffff));
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <algorithm>
+
+/*
+ * fixed point filter kernels for raw (16 bit) sensor samples
+ * all filters produce values with filter_frac_bits fractional bits, i.e. a result of (x << filter_frac_bits) means x
+ */
+
+constexpr int filter_frac_bits = 8;
+
+template<std::size_t max_len>
+struct MovingAverageFilter {
+    static_assert(max_len <= 256, "the sum of the window has to fit into 32 bits after scaling");
+
+    std::array<std::int16_t, max_len> history{};
+    std::int32_t sum{};
+    std::size_t len{1};
+    std::size_t idx{};
+    std::size_t filled{};
+
+    void reset(std::size_t length) {
+        len = std::clamp<std::size_t>(length, 1, max_len);
+        sum = 0;
+        idx = 0;
+        filled = 0;
+    }
+
+    std::optional<std::int32_t> push(std::int16_t sample) {
+        if (filled == len) {
+            sum -= history[idx];
+        } else {
+            ++filled;
+        }
+        history[idx] = sample;
+        sum += sample;
+        idx = (idx + 1) % len;
+        return (sum * (1 << filter_frac_bits)) / static_cast<std::int32_t>(filled);
+    }
+};
+
+// exponential moving average with a smoothing factor of 2^-shift
+// the state keeps max_shift more fractional bits than the output and the increment is rounded, so it settles on the
+// input exactly instead of stopping up to 2^(shift - filter_frac_bits) counts below it
+struct EmaFilter {
+    static constexpr std::uint8_t max_shift = 15;
+    static constexpr int state_frac_bits = filter_frac_bits + max_shift;
+
+    std::int64_t state{};
+    std::uint8_t shift{};
+    bool primed{};
+
+    void reset(std::uint8_t s) {
+        shift = std::min(s, max_shift);
+        primed = false;
+    }
+
+    std::optional<std::int32_t> push(std::int16_t sample) {
+        std::int64_t x = std::int64_t{sample} * (std::int64_t{1} << state_frac_bits);
+        if (not primed) {
+            state = x;
+            primed = true;
+        }
+        state += rounded_shift(x - state, shift);
+        return static_cast<std::int32_t>(rounded_shift(state, max_shift));
+    }
+
+private:
+    // v / 2^s rounded half away from zero, so a state below and above the input settle equally close to it
+    static constexpr std::int64_t rounded_shift(std::int64_t v, std::uint8_t s) {
+        std::int64_t half = s ? std::int64_t{1} << (s - 1) : 0;
+        return v >= 0 ? (v + half) >> s : -((half - v) >> s);
+    }
+};
+
+// cascaded integrator comb decimator, emits a value every `decimation` samples
+// the integrators rely on wrapping arithmetic, the result is exact as long as the gain of decimation^order fits into 32 bits
+template<std::size_t order>
+struct CicDecimator {
+    static_assert(order >= 1 and order <= 3);
+
+    std::array<std::uint32_t, order> integrators{};
+    std::array<std::uint32_t, order> combs{};
+    std::uint32_t decimation{1};
+    std::uint32_t gain{1};
+    std::uint32_t count{};
+
+    static constexpr std::uint32_t max_decimation = 32;
+
+    void reset(std::uint32_t dec) {
+        decimation = std::clamp<std::uint32_t>(dec, 1, max_decimation);
+        gain = 1;
+        for (auto i{0U}; i < order; ++i) {
+            gain *= decimation;
+        }
+        integrators = {};
+        combs = {};
+        count = 0;
+    }
+
+    std::optional<std::int32_t> push(std::int16_t sample) {
+        std::uint32_t v = static_cast<std::uint32_t>(static_cast<std::int32_t>(sample));
+        for (auto& integrator : integrators) {
+            integrator += v;
+            v = integrator;
+        }
+        if (++count < decimation) {
+            return {};
+        }
+        count = 0;
+        for (auto& comb : combs) {
+            auto delayed = comb;
+            comb = v;
+            v -= delayed;
+        }
+        std::int64_t scaled = static_cast<std::int64_t>(static_cast<std::int32_t>(v)) * (1 << filter_frac_bits);
+        return static_cast<std::int32_t>(scaled / static_cast<std::int64_t>(gain));
+    }
+};
+
+// runtime selectable filter for one sensor channel
+template<std::size_t max_len>
+struct SampleFilter {
+    enum class Type : std::uint8_t {
+        none,
+        moving_average,
+        ema,
+        cic,
+    };
+
+    Type type{Type::none};
+    MovingAverageFilter<max_len> moving_average;
+    EmaFilter ema;
+    CicDecimator<3> cic;
+
+    void reset(Type t, std::uint8_t param) {
+        type = t;
+        switch (type) {
+        case Type::moving_average: moving_average.reset(param); break;
+        case Type::ema:            ema.reset(param); break;
+        case Type::cic:            cic.reset(param); break;
+        default:                   type = Type::none; break;
+        }
+    }
+
+    std::optional<std::int32_t> push(std::int16_t sample) {
+        switch (type) {
+        case Type::moving_average: return moving_average.push(sample);
+        case Type::ema:            return ema.push(sample);
+        case Type::cic:            return cic.push(sample);
+        default:                   return sample * (1 << filter_frac_bits);
+        }
+    }
+};
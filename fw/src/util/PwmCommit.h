@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * the compare (cc) and wrap (top) registers of the rp2040 pwm slices are double buffered and latched when the counter
+ * wraps. slices that were started together wrap together, writes to several slices that all land within the same
+ * period therefore take effect in the same cycle.
+ *
+ * Hw has to provide counter(slice) and top(slice), top may read back a value written in the running period.
+ */
+
+// performs staged writes so they land within one period, without waiting for a safe point in it:
+// commit() writes right away if the counter of the reference slice is at least `guard` counts past the last wrap and
+// `guard` counts before the next one, otherwise the writes are left to on_wrap(), to be called from the wrap interrupt
+// of the reference slice. Both run with interrupts disabled for no longer than the writes, which have to take less
+// than `guard` counts. Periods shorter than 2 * guard are not synchronized.
+template<typename Hw>
+struct PeriodCommit {
+    Hw& hw;
+    std::uint8_t ref_slice;
+    std::uint16_t guard;
+    bool pending{};
+    // a top written in this period only takes effect with the next wrap, until then the window is unknown
+    bool top_changing{};
+
+    // write() returns whether it changed top
+    // returns whether the writes are left for the wrap interrupt, which the caller has to enable then
+    template<typename F>
+    bool commit(F&& write) {
+        pending = true;
+        if (not top_changing and in_window(guard)) {
+            flush(write);
+        }
+        return pending;
+    }
+
+    // returns whether the writes are still pending, i.e. the interrupt came too late in the period for them
+    // the interrupt runs after the wrap, the reloads done at it are over, so only the end of the period counts here
+    template<typename F>
+    bool on_wrap(F&& write) {
+        top_changing = false;
+        if (pending and in_window(0)) {
+            flush(write);
+        }
+        return pending;
+    }
+
+private:
+    bool in_window(std::uint32_t since_wrap) const {
+        std::uint32_t top = hw.top(ref_slice);
+        if (top <= 2u * guard) {
+            return true;
+        }
+        std::uint32_t ctr = hw.counter(ref_slice);
+        return ctr >= since_wrap and ctr + guard <= top;
+    }
+
+    template<typename F>
+    void flush(F&& write) {
+        pending = false;
+        top_changing = write();
+    }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+/*
+ * fixed point setpoint ramps
+ * values carry ramp_frac_bits fractional bits, time is counted in update ticks
+ */
+
+constexpr int ramp_frac_bits = 16;
+
+constexpr std::int32_t to_ramp_fixed(float v) {
+    return static_cast<std::int32_t>(v * (1 << ramp_frac_bits));
+}
+
+constexpr float from_ramp_fixed(std::int32_t v) {
+    return static_cast<float>(v) / (1 << ramp_frac_bits);
+}
+
+// move current towards target by at most max_step
+constexpr std::int32_t slew_limit(std::int32_t current, std::int32_t target, std::int32_t max_step) {
+    if (max_step <= 0) {
+        return target;
+    }
+    std::int64_t delta = static_cast<std::int64_t>(target) - current;
+    return current + static_cast<std::int32_t>(std::clamp<std::int64_t>(delta, -max_step, max_step));
+}
+
+struct Ramp {
+    enum class Shape : std::uint8_t {
+        linear,
+        // first order approach, the duration spans exp_time_constants time constants and the last tick snaps to the end value
+        exponential,
+    };
+
+    static constexpr int decay_frac_bits = 30;
+    static constexpr float exp_time_constants = 5;
+
+    Shape shape{};
+    std::int32_t from{}, to{}, value{};
+    std::uint32_t ticks{}, tick{};
+    // exponential: fraction of the distance kept per tick and the fraction of the whole span still remaining
+    std::int64_t decay{};
+    std::int64_t remaining{};
+
+    void start(Shape s, std::int32_t from_, std::int32_t to_, std::uint32_t num_ticks) {
+        shape = s;
+        from = from_;
+        to = to_;
+        value = from;
+        ticks = std::max<std::uint32_t>(num_ticks, 1);
+        tick = 0;
+        decay = static_cast<std::int64_t>(std::exp(-static_cast<double>(exp_time_constants) / ticks) * (std::int64_t{1} << decay_frac_bits));
+        remaining = std::int64_t{1} << decay_frac_bits;
+    }
+
+    void stop() {
+        tick = ticks;
+    }
+
+    bool done() const {
+        return tick >= ticks;
+    }
+
+    std::int32_t step() {
+        if (done()) {
+            return value;
+        }
+        ++tick;
+        if (tick == ticks) {
+            value = to;
+        } else if (shape == Shape::linear) {
+            std::int64_t span = static_cast<std::int64_t>(to) - from;
+            value = from + static_cast<std::int32_t>(span * tick / ticks);
+        } else {
+            // track the remaining fraction instead of the remaining distance so slow ramps don't stall on rounding
+            remaining = (remaining * decay) >> decay_frac_bits;
+            std::int64_t span = static_cast<std::int64_t>(to) - from;
+            value = to - static_cast<std::int32_t>((span * remaining) >> decay_frac_bits);
+        }
+        return value;
+    }
+};
@@ -3,7 +3,14 @@
 #include <ratio>
 #include <type_traits>
 #include <cstdint>
+#include <limits>
+#include <numeric>
+#include <algorithm>
 
+/*
+ * fixed point numbers: an integer val that represents val * ratio
+ * products and quotients combine the ratios at compile time, sums use the finest common ratio (like std::chrono)
+ */
 
 namespace detail {
 
@@ -19,39 +26,167 @@ inline constexpr bool is_ratio_v = is_ratio<T>::value;
 }
 
 template<typename T, typename ratioT=std::ratio<1, 1>> requires (std::is_integral_v<T> and detail::is_ratio_v<ratioT>)
+struct ScaledNumber;
+
+namespace detail {
+
+template<typename T>
+struct is_scaled_number : std::false_type {};
+template<typename T, typename ratioT>
+struct is_scaled_number<ScaledNumber<T, ratioT>> : std::true_type {};
+
+template<typename T>
+inline constexpr bool is_scaled_number_v = is_scaled_number<T>::value;
+
+// products are computed in 64 bit so the intermediate of two 32 bit values can't overflow
+template<typename A, typename B>
+using wide_t = std::conditional_t<std::is_signed_v<A> or std::is_signed_v<B>, std::int64_t, std::uint64_t>;
+
+template<typename R1, typename R2>
+using common_ratio = std::ratio<std::gcd(R1::num, R2::num), std::lcm(R1::den, R2::den)>;
+
+}
+
+template<typename To, typename T_from, typename ratio_from> requires (detail::is_scaled_number_v<To>)
+constexpr To scaled_number_cast(ScaledNumber<T_from, ratio_from> const& v) {
+    using conv = std::ratio_divide<ratio_from, typename To::ratio>;
+    using wide = detail::wide_t<T_from, typename To::value_type>;
+    return To{static_cast<typename To::value_type>(static_cast<wide>(v.val) * conv::num / conv::den)};
+}
+
+// like scaled_number_cast but clamps to the range of the target instead of wrapping
+template<typename To, typename T_from, typename ratio_from> requires (detail::is_scaled_number_v<To>)
+constexpr To saturate_cast(ScaledNumber<T_from, ratio_from> const& v) {
+    using conv = std::ratio_divide<ratio_from, typename To::ratio>;
+    using wide = detail::wide_t<T_from, typename To::value_type>;
+    using limits = std::numeric_limits<typename To::value_type>;
+    wide scaled = static_cast<wide>(v.val) * conv::num / conv::den;
+    wide lo = static_cast<wide>(limits::min());
+    wide hi = static_cast<wide>(limits::max());
+    return To{static_cast<typename To::value_type>(std::clamp(scaled, lo, hi))};
+}
+
+// like scaled_number_cast but rounds to the nearest value (half away from zero) instead of truncating, for
+// measurements that are integrated or averaged later
+template<typename To, typename T_from, typename ratio_from> requires (detail::is_scaled_number_v<To>)
+constexpr To rounded_cast(ScaledNumber<T_from, ratio_from> const& v) {
+    using conv = std::ratio_divide<ratio_from, typename To::ratio>;
+    using wide = detail::wide_t<T_from, typename To::value_type>;
+    wide scaled = static_cast<wide>(v.val) * conv::num;
+    wide half = conv::den / 2;
+    if constexpr (std::is_signed_v<wide>) {
+        if (scaled < 0) {
+            return To{static_cast<typename To::value_type>((scaled - half) / conv::den)};
+        }
+    }
+    return To{static_cast<typename To::value_type>((scaled + half) / conv::den)};
+}
+
+template<typename T, typename ratioT> requires (std::is_integral_v<T> and detail::is_ratio_v<ratioT>)
 struct ScaledNumber {
     using ratio = ratioT;
     using value_type = T;
     value_type val {};
 
-    ScaledNumber() = default;
-    ScaledNumber(value_type v) : val{v} {}
-    ScaledNumber(ScaledNumber&) = default;
-    ScaledNumber(ScaledNumber&&) = default;
-    ScaledNumber& operator=(ScaledNumber&) = default;
-    ScaledNumber& operator=(ScaledNumber&&) = default;
+    constexpr ScaledNumber() = default;
+    constexpr ScaledNumber(value_type v) : val{v} {}
+    constexpr ScaledNumber(ScaledNumber const&) = default;
+    constexpr ScaledNumber& operator=(ScaledNumber const&) = default;
 
     template<typename T_from, typename ratio_from>
-    ScaledNumber(ScaledNumber<T_from, ratio_from> const& v) : val{scaled_number_cast<ScaledNumber>(v).val} {}
+    constexpr ScaledNumber(ScaledNumber<T_from, ratio_from> const& v) : val{scaled_number_cast<ScaledNumber>(v).val} {}
+
+    // conversion from a physical value, meant for constants and configuration (soft float on the rp2040)
+    static constexpr ScaledNumber from_float(float v) {
+        return ScaledNumber{static_cast<value_type>(v * ratio::den / ratio::num)};
+    }
+
+    constexpr float to_float() const {
+        return static_cast<float>(val) * (static_cast<float>(ratio::num) / ratio::den);
+    }
+
+    constexpr ScaledNumber operator-() const {
+        return ScaledNumber{static_cast<value_type>(-val)};
+    }
+
+    constexpr ScaledNumber& operator+=(ScaledNumber const& rhs) {
+        val += rhs.val;
+        return *this;
+    }
+
+    constexpr ScaledNumber& operator-=(ScaledNumber const& rhs) {
+        val -= rhs.val;
+        return *this;
+    }
 
-    auto operator<=>(ScaledNumber const&) const = default;
+    constexpr auto operator<=>(ScaledNumber const&) const = default;
 };
 
+template<typename T1, typename R1, typename T2, typename R2>
+constexpr auto operator+(ScaledNumber<T1, R1> const& lhs, ScaledNumber<T2, R2> const& rhs) {
+    using Result = ScaledNumber<std::common_type_t<T1, T2>, detail::common_ratio<R1, R2>>;
+    return Result{static_cast<typename Result::value_type>(Result{lhs}.val + Result{rhs}.val)};
+}
 
-namespace detail {
+template<typename T1, typename R1, typename T2, typename R2>
+constexpr auto operator-(ScaledNumber<T1, R1> const& lhs, ScaledNumber<T2, R2> const& rhs) {
+    using Result = ScaledNumber<std::common_type_t<T1, T2>, detail::common_ratio<R1, R2>>;
+    return Result{static_cast<typename Result::value_type>(Result{lhs}.val - Result{rhs}.val)};
+}
 
-template<typename T>
-struct is_scaled_number : std::false_type {};
-template<typename T, typename ratioT> //requires (is_ratio_v<ratioT>)
-struct is_scaled_number<ScaledNumber<T, ratioT>> : std::true_type {};
+template<typename T1, typename R1, typename T2, typename R2>
+constexpr auto operator*(ScaledNumber<T1, R1> const& lhs, ScaledNumber<T2, R2> const& rhs) {
+    using wide = detail::wide_t<T1, T2>;
+    return ScaledNumber<wide, std::ratio_multiply<R1, R2>>{static_cast<wide>(lhs.val) * rhs.val};
+}
 
-template<typename T>
-inline constexpr bool is_scaled_number_v = is_scaled_number<T>::value;
+// the quotient keeps the resolution of the ratio of the operands, scale the dividend up first if more is needed
+template<typename T1, typename R1, typename T2, typename R2>
+constexpr auto operator/(ScaledNumber<T1, R1> const& lhs, ScaledNumber<T2, R2> const& rhs) {
+    using wide = detail::wide_t<T1, T2>;
+    return ScaledNumber<wide, std::ratio_divide<R1, R2>>{static_cast<wide>(lhs.val) / rhs.val};
+}
 
+template<typename T1, typename R1, typename T2, typename R2>
+constexpr bool operator==(ScaledNumber<T1, R1> const& lhs, ScaledNumber<T2, R2> const& rhs) {
+    using Common = ScaledNumber<detail::wide_t<T1, T2>, detail::common_ratio<R1, R2>>;
+    return Common{lhs}.val == Common{rhs}.val;
 }
 
-template<typename To, typename T_from, typename ratio_from> requires (detail::is_scaled_number<To>::value)
-To scaled_number_cast(ScaledNumber<T_from,  ratio_from> const& v) {
-    using conv = std::ratio_divide<ratio_from, typename To::ratio>;
-    return To{static_cast<typename To::value_type>(v.val * conv::num / conv::den)};
+template<typename T1, typename R1, typename T2, typename R2>
+constexpr auto operator<=>(ScaledNumber<T1, R1> const& lhs, ScaledNumber<T2, R2> const& rhs) {
+    using Common = ScaledNumber<detail::wide_t<T1, T2>, detail::common_ratio<R1, R2>>;
+    return Common{lhs}.val <=> Common{rhs}.val;
 }
+
+// binary fixed point with frac_bits fractional bits
+template<typename T, int frac_bits>
+using FixedPoint = ScaledNumber<T, std::ratio<1, std::intmax_t{1} << frac_bits>>;
+
+using millivolts  = ScaledNumber<std::int32_t, std::milli>;
+using milliamps   = ScaledNumber<std::int32_t, std::milli>;
+using milliwatts  = ScaledNumber<std::int32_t, std::milli>;
+
+// rounded to the nearest milliwatt, truncating would bias integrated energy by half a milliwatt
+constexpr milliwatts power(millivolts u, milliamps i) {
+    auto microwatts = u * i;
+    microwatts.val += microwatts.val < 0 ? -500 : 500;
+    return saturate_cast<milliwatts>(microwatts);
+}
+
+static_assert(scaled_number_cast<millivolts>(ScaledNumber<std::int32_t>{3}).val == 3000);
+static_assert(scaled_number_cast<ScaledNumber<std::int32_t>>(millivolts{3999}).val == 3);
+static_assert((millivolts{1500} + ScaledNumber<std::int32_t, std::micro>{250}).val == 1'500'250);
+static_assert(power(millivolts{12'000}, milliamps{1'500}).val == 18'000);
+static_assert(power(millivolts{-2'000}, milliamps{1'500}).val == -3'000);
+static_assert(power(millivolts{1}, milliamps{500}).val == 1);
+static_assert(power(millivolts{-1}, milliamps{499}).val == 0);
+static_assert(rounded_cast<ScaledNumber<std::int32_t>>(millivolts{1500}).val == 2);
+static_assert(rounded_cast<ScaledNumber<std::int32_t>>(millivolts{-1499}).val == -1);
+static_assert(rounded_cast<millivolts>(FixedPoint<std::int32_t, 16>{-(1 << 6)}).val == -1);
+static_assert(saturate_cast<ScaledNumber<std::uint16_t>>(ScaledNumber<std::int32_t>{-5}).val == 0);
+static_assert(saturate_cast<ScaledNumber<std::uint16_t>>(ScaledNumber<std::int32_t>{70'000}).val == 65'535);
+static_assert(scaled_number_cast<millivolts>(FixedPoint<std::int32_t, 16>{3 << 15}).val == 1500);
+static_assert((millivolts{1000} / ScaledNumber<std::int32_t>{4}).val == 250);
+static_assert(millivolts{1000} == ScaledNumber<std::int32_t>{1});
+static_assert(millivolts{999} < ScaledNumber<std::int32_t>{1});
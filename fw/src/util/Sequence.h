@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+/*
+ * playback of a table of output steps against an absolute time base
+ * step deadlines are accumulated from the start of the sequence, a late timer callback therefore shortens the
+ * following step instead of shifting the rest of the sequence
+ */
+
+struct SequenceStep {
+    static constexpr std::uint32_t enable_flag = std::uint32_t{1} << 31;
+
+    // the msb carries the output enable
+    std::uint32_t duration_us;
+    std::uint16_t u_mV;
+    std::uint16_t i_mA;
+
+    constexpr std::uint32_t duration() const {
+        return duration_us & ~enable_flag;
+    }
+
+    constexpr bool enabled() const {
+        return duration_us & enable_flag;
+    }
+};
+static_assert(sizeof(SequenceStep) == 8);
+
+struct SequencePlayer {
+    std::span<SequenceStep const> steps;
+    // 0 repeats forever
+    std::uint32_t loops{};
+    std::uint32_t loop{};
+    std::size_t index{};
+    std::uint64_t step_start_us{};
+    bool running{};
+
+    bool start(std::span<SequenceStep const> s, std::uint32_t loop_count, std::uint64_t now_us) {
+        steps = s;
+        loops = loop_count;
+        loop = 0;
+        index = 0;
+        step_start_us = now_us;
+
+        std::uint64_t total{};
+        for (auto const& step : steps) {
+            total += step.duration();
+        }
+        running = total > 0;
+        return running;
+    }
+
+    void stop() {
+        running = false;
+    }
+
+    SequenceStep const& current() const {
+        return steps[index];
+    }
+
+    std::uint64_t deadline_us() const {
+        return step_start_us + current().duration();
+    }
+
+    // moves on to the step that is active at now_us, steps that were missed entirely are skipped
+    // returns false once all loops are played
+    bool advance(std::uint64_t now_us) {
+        while (running and now_us >= deadline_us()) {
+            step_start_us = deadline_us();
+            if (++index == steps.size()) {
+                index = 0;
+                ++loop;
+                if (loops and loop >= loops) {
+                    running = false;
+                }
+            }
+        }
+        return running;
+    }
+};
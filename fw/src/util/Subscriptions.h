@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+
+/*
+ * change notifications for configs
+ * each subscription remembers the value it reported last and is only looked at again once its interval elapsed,
+ * fetching and emitting are left to the caller so the table doesn't depend on the configs or the usb endpoint
+ */
+template<std::size_t max_subscriptions, std::size_t max_value_size>
+struct SubscriptionTable {
+    static constexpr std::uint16_t no_index = 0xffff;
+
+    struct Entry {
+        std::uint16_t index{no_index};
+        std::uint16_t size{};
+        std::uint32_t interval_us{};
+        std::uint32_t last_check_us{};
+        bool reported{};
+        std::array<std::uint8_t, max_value_size> last{};
+    };
+
+    std::array<Entry, max_subscriptions> entries{};
+
+    // subscribing again to the same index updates the interval and forces a report
+    // configs without a value (size 0) have nothing to report
+    bool subscribe(std::uint16_t index, std::uint16_t size, std::uint32_t interval_us) {
+        if (index == no_index or size == 0 or size > max_value_size) {
+            return false;
+        }
+        Entry* free = nullptr;
+        for (auto& e : entries) {
+            if (e.index == index) {
+                free = &e;
+                break;
+            }
+            if (not free and e.index == no_index) {
+                free = &e;
+            }
+        }
+        if (not free) {
+            return false;
+        }
+        *free = Entry{.index = index, .size = size, .interval_us = interval_us};
+        return true;
+    }
+
+    // no_index drops all subscriptions
+    void unsubscribe(std::uint16_t index) {
+        for (auto& e : entries) {
+            if (index == no_index or e.index == index) {
+                e = Entry{};
+            }
+        }
+    }
+
+    bool empty() const {
+        for (auto const& e : entries) {
+            if (e.index != no_index) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // fetch(index) returns the current value as a span of `size` bytes
+    // emit(index, now_us, value) reports a change, returning false (e.g. out of buffer space) keeps it pending
+    // returns the number of reported changes
+    template<typename Fetch, typename Emit>
+    std::size_t poll(std::uint32_t now_us, Fetch&& fetch, Emit&& emit) {
+        std::size_t reported = 0;
+        for (auto& e : entries) {
+            if (e.index == no_index) {
+                continue;
+            }
+            if (e.reported and (now_us - e.last_check_us) < e.interval_us) {
+                continue;
+            }
+            std::span<std::uint8_t const> value = fetch(e.index);
+            if (value.size() != e.size) {
+                continue;
+            }
+            if (e.reported and std::memcmp(value.data(), e.last.data(), e.size) == 0) {
+                e.last_check_us = now_us;
+                continue;
+            }
+            if (not emit(e.index, now_us, value)) {
+                continue;
+            }
+            e.last_check_us = now_us;
+            std::memcpy(e.last.data(), value.data(), e.size);
+            e.reported = true;
+            ++reported;
+        }
+        return reported;
+    }
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * fixed layout frames of the telemetry stream, little endian as on the wire
+ * frames are never split across batches, a gap in seq means frames were dropped on the device
+ */
+
+constexpr std::uint16_t telemetry_sync = 0x5aa5;
+
+enum TelemetryStatus : std::uint16_t {
+    enabled0 = 1 << 0,
+    enabled1 = 1 << 1,
+    tripped0 = 1 << 2,
+    tripped1 = 1 << 3,
+};
+
+struct TelemetryFrame {
+    std::uint16_t sync;
+    std::uint16_t status;                  // TelemetryStatus bits
+    std::uint32_t seq;
+    std::uint32_t timestamp_us;
+    std::array<std::int32_t, 4> measured;  // u0, i0, u1, i1 in mV and mA
+    std::array<std::int32_t, 4> setpoints; // same order and units
+};
+static_assert(sizeof(TelemetryFrame) == 44, "the host decodes frames with a fixed layout");
+
+// ping pong buffer of frames: one batch is filled while the other one is in flight
+template<std::size_t frames_per_batch>
+struct TelemetryBatcher {
+    std::array<std::array<TelemetryFrame, frames_per_batch>, 2> batches;
+    std::size_t filling{};
+    std::size_t fill{};
+    std::uint32_t next_seq{};
+    std::uint32_t dropped{};
+
+    // numbers the frame, it is dropped if the current batch is full
+    void push(TelemetryFrame frame) {
+        frame.sync = telemetry_sync;
+        frame.seq = next_seq++;
+        if (fill == frames_per_batch) {
+            ++dropped;
+            return;
+        }
+        batches[filling][fill++] = frame;
+    }
+
+    // hands out the frames collected so far and continues with the other batch
+    // the returned bytes stay untouched until the next call
+    std::span<std::uint8_t const> take() {
+        auto const& batch = batches[filling];
+        std::size_t count = fill;
+        filling ^= 1;
+        fill = 0;
+        return {reinterpret_cast<std::uint8_t const*>(batch.data()), count * sizeof(TelemetryFrame)};
+    }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+/*
+ * a ring buffer that keeps recording until a trigger happened and then stops after it filled the post trigger part
+ * once done the buffer holds pre_depth samples before the trigger and N - pre_depth samples starting at the trigger
+ */
+template<typename Sample, std::size_t N>
+struct TriggeredCapture {
+    enum class State : std::uint8_t {
+        idle,
+        armed,
+        triggered,
+        done,
+    };
+
+    void arm(std::size_t pre_depth) {
+        pre = std::min(pre_depth, N - 1);
+        head = 0;
+        count = 0;
+        post_remaining = 0;
+        trigger_pending = false;
+        state = State::armed;
+    }
+
+    void stop() {
+        state = State::idle;
+        count = 0;
+    }
+
+    // request a trigger, it is taken as soon as the pre trigger history is filled
+    void trigger() {
+        if (state == State::armed) {
+            trigger_pending = true;
+        }
+    }
+
+    void push(Sample const& sample) {
+        if (state != State::armed and state != State::triggered) {
+            return;
+        }
+        if (state == State::armed and trigger_pending and count >= pre) {
+            state = State::triggered;
+            post_remaining = N - pre;
+        }
+        ring[head] = sample;
+        head = (head + 1) % N;
+        count = std::min(count + 1, N);
+        if (state == State::triggered and --post_remaining == 0) {
+            state = State::done;
+        }
+    }
+
+    // whether the pre trigger history is filled and a trigger would be taken right away
+    bool ready() const {
+        return state == State::armed and count >= pre;
+    }
+
+    State getState() const {
+        return state;
+    }
+
+    // the number of samples available in chronological order
+    std::size_t size() const {
+        return state == State::done ? N : 0;
+    }
+
+    // the index of the first sample after the trigger
+    std::size_t trigger_index() const {
+        return pre;
+    }
+
+    Sample const& operator[](std::size_t idx) const {
+        return ring[(head + idx) % N];
+    }
+
+    static constexpr std::size_t capacity() {
+        return N;
+    }
+
+private:
+    std::array<Sample, N> ring{};
+    std::size_t head{};
+    std::size_t count{};
+    std::size_t pre{};
+    std::size_t post_remaining{};
+    bool trigger_pending{};
+    State state{State::idle};
+};